@@ -0,0 +1,202 @@
+#include "BinaryMesh.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+const char BinaryMesh::MAGIC[4] = { 'B', 'M', 'S', 'H' };
+const uint32_t BinaryMesh::VERSION = 2;
+const uint64_t BinaryMesh::BLOB_ALIGNMENT = 64;
+const std::string BinaryMesh::EXTENSION = ".bmesh";
+
+static_assert(sizeof(BinaryMeshHeader) == 64, "The binary mesh header must stay 64 bytes");
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+MappedFile::MappedFile(const std::string& filePath)
+{
+#ifdef _WIN32
+	fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		throw std::runtime_error(std::format("Could not open the file {}", filePath).data());
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(fileHandle, &fileSize);
+	size = static_cast<size_t>(fileSize.QuadPart);
+	if (size == 0)
+		return;
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+	{
+		CloseHandle(fileHandle);
+		throw std::runtime_error(std::format("Could not create a mapping for the file {}", filePath).data());
+	}
+
+	data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr)
+	{
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		throw std::runtime_error(std::format("Could not map the file {}", filePath).data());
+	}
+#else
+	fileDescriptor = open(filePath.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		throw std::runtime_error(std::format("Could not open the file {}", filePath).data());
+
+	struct stat fileStat;
+	fstat(fileDescriptor, &fileStat);
+	size = static_cast<size_t>(fileStat.st_size);
+	if (size == 0)
+		return;
+
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+	{
+		close(fileDescriptor);
+		throw std::runtime_error(std::format("Could not map the file {}", filePath).data());
+	}
+
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	data = static_cast<const uint8_t*>(mapping);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+#else
+	if (data != nullptr)
+		munmap(const_cast<uint8_t*>(data), size);
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+#endif
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
+
+BinaryMesh::BinaryMesh(const std::string& filePath)
+	: file(filePath)
+{
+	if (file.GetSize() < sizeof(BinaryMeshHeader))
+		throw std::runtime_error(std::format("The binary mesh file {} is too small to hold a header", filePath).data());
+
+	header = reinterpret_cast<const BinaryMeshHeader*>(file.GetData());
+
+	if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0)
+		throw std::runtime_error(std::format("The file {} is not a binary mesh", filePath).data());
+	if (header->version != VERSION)
+		throw std::runtime_error(std::format("Unsupported binary mesh version in file {}: {}", filePath, header->version).data());
+	if (header->vertexStride != sizeof(Vertex) || header->indexSize != sizeof(unsigned int))
+		throw std::runtime_error(std::format("The vertex or index layout of binary mesh file {} does not match this build", filePath).data());
+	if (header->indexCount % 3 != 0)
+		throw std::runtime_error(std::format("The number of indices is not divisible by 3 in model file {}: {}", filePath, header->indexCount).data());
+
+	uint64_t vertexEnd = header->vertexOffset + header->vertexCount * header->vertexStride;
+	uint64_t indexEnd = header->indexOffset + header->indexCount * header->indexSize;
+	uint64_t lodEnd = header->lodOffset + header->lodCount * sizeof(BinaryMeshLod);
+	if (vertexEnd > file.GetSize() || indexEnd > file.GetSize() || lodEnd > file.GetSize())
+		throw std::runtime_error(std::format("The binary mesh file {} is truncated", filePath).data());
+}
+
+const Vertex* BinaryMesh::GetVertices() const
+{
+	return reinterpret_cast<const Vertex*>(file.GetData() + header->vertexOffset);
+}
+
+size_t BinaryMesh::GetVertexCount() const
+{
+	return static_cast<size_t>(header->vertexCount);
+}
+
+const unsigned int* BinaryMesh::GetIndices() const
+{
+	return reinterpret_cast<const unsigned int*>(file.GetData() + header->indexOffset);
+}
+
+size_t BinaryMesh::GetIndexCount() const
+{
+	return static_cast<size_t>(header->indexCount);
+}
+
+const BinaryMeshLod* BinaryMesh::GetLods() const
+{
+	return reinterpret_cast<const BinaryMeshLod*>(file.GetData() + header->lodOffset);
+}
+
+size_t BinaryMesh::GetLodCount() const
+{
+	return header->lodCount;
+}
+
+void BinaryMesh::Write(const std::string& filePath, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+	const BinaryMeshLod* lods, size_t lodCount)
+{
+	BinaryMeshHeader header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.headerSize = sizeof(BinaryMeshHeader);
+	header.vertexStride = sizeof(Vertex);
+	header.indexSize = sizeof(unsigned int);
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.vertexOffset = AlignUp(sizeof(BinaryMeshHeader), BLOB_ALIGNMENT);
+	header.indexOffset = AlignUp(header.vertexOffset + vertexCount * sizeof(Vertex), BLOB_ALIGNMENT);
+	header.lodCount = static_cast<uint32_t>(lodCount);
+	header.lodOffset = lodCount > 0 ? AlignUp(header.indexOffset + indexCount * sizeof(unsigned int), BLOB_ALIGNMENT) : 0;
+
+	std::ofstream fout(filePath, std::ios::binary | std::ios::trunc);
+	if (!fout)
+		throw std::runtime_error(std::format("Could not create the binary mesh file {}", filePath).data());
+
+	const char zeros[BLOB_ALIGNMENT] = {};
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fout.write(zeros, header.vertexOffset - sizeof(header));
+	fout.write(reinterpret_cast<const char*>(vertices), vertexCount * sizeof(Vertex));
+	fout.write(zeros, header.indexOffset - (header.vertexOffset + vertexCount * sizeof(Vertex)));
+	fout.write(reinterpret_cast<const char*>(indices), indexCount * sizeof(unsigned int));
+	if (lodCount > 0)
+	{
+		fout.write(zeros, header.lodOffset - (header.indexOffset + indexCount * sizeof(unsigned int)));
+		fout.write(reinterpret_cast<const char*>(lods), lodCount * sizeof(BinaryMeshLod));
+	}
+
+	if (!fout)
+		throw std::runtime_error(std::format("Could not write the binary mesh file {}", filePath).data());
+}
+
+bool BinaryMesh::HasBinaryExtension(const std::string& filePath)
+{
+	return std::filesystem::path(filePath).extension() == EXTENSION;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "utils.h"
+#include "Vertex.h"
+
+#include <cstdint>
+
+// On-disk layout of a .bmesh file: this header, followed by the vertex, index and level of detail
+// blobs at the given offsets. The blobs are stored exactly as they are uploaded to the GPU.
+struct BinaryMeshHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t vertexStride;
+	uint32_t indexSize;
+	uint32_t lodCount;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t lodOffset;
+};
+
+// one level of detail in a .bmesh file, see MeshData::lods
+struct BinaryMeshLod
+{
+	uint64_t firstIndex;
+	uint64_t indexCount;
+	float error;
+	uint32_t reserved;
+};
+
+class MappedFile
+{
+public:
+	MappedFile(const std::string& filePath);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	const uint8_t* GetData() const;
+	size_t GetSize() const;
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
+
+class BinaryMesh
+{
+public:
+	BinaryMesh(const std::string& filePath);
+
+	const Vertex* GetVertices() const;
+	size_t GetVertexCount() const;
+	const unsigned int* GetIndices() const;
+	size_t GetIndexCount() const;
+	const BinaryMeshLod* GetLods() const;
+	size_t GetLodCount() const;
+
+	static void Write(const std::string& filePath, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+		const BinaryMeshLod* lods = nullptr, size_t lodCount = 0);
+	static bool HasBinaryExtension(const std::string& filePath);
+
+private:
+	MappedFile file;
+	const BinaryMeshHeader* header;
+
+public:
+	static const char MAGIC[4];
+	static const uint32_t VERSION;
+	static const uint64_t BLOB_ALIGNMENT;
+	static const std::string EXTENSION;
+};
\ No newline at end of file
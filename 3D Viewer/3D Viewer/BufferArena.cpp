@@ -0,0 +1,199 @@
+#include "BufferArena.h"
+
+#include "GLState.h"
+
+#include <algorithm>
+
+const size_t BufferArena::DEFAULT_PAGE_VERTEX_COUNT = 2 * 1024 * 1024;
+const size_t BufferArena::DEFAULT_PAGE_INDEX_BYTES = 32 * 1024 * 1024;
+const size_t BufferArena::INDEX_ALIGNMENT = sizeof(unsigned int);
+const size_t BufferArena::NO_PAGE = static_cast<size_t>(-1);
+
+BufferArena::BufferArena(size_t pageVertexCount, size_t pageIndexBytes)
+	: boundPage(NO_PAGE), pageVertexCount(pageVertexCount), pageIndexBytes(pageIndexBytes)
+{
+	GLCall(glGenVertexArrays(1, &VAO));
+}
+
+BufferArena::~BufferArena()
+{
+	for (Page& page : pages)
+	{
+		GLState::DeleteBuffer(page.VBO);
+		GLState::DeleteBuffer(page.EBO);
+	}
+	GLState::DeleteVertexArray(VAO);
+}
+
+BufferArena::Allocation BufferArena::Allocate(const MeshData& mesh)
+{
+	Allocation allocation;
+	allocation.vertexCount = mesh.GetVertexCount();
+	allocation.indexSize = mesh.GetPackedIndexSize();
+	for (size_t level = 0; level < mesh.GetLodCount(); level++)
+		allocation.lodRanges.push_back(mesh.GetIndexRanges(level));
+	// every slice starts aligned for 32-bit indices
+	const size_t slotBytes = (mesh.GetPackedIndexBytes() + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+	allocation.indexBytes = mesh.GetPackedIndexBytes();
+
+	bool allocated = false;
+	for (size_t page = 0; page < pages.size() && !allocated; page++)
+	{
+		size_t baseVertex, indexByteOffset;
+		if (!AllocateRange(pages[page].freeVertices, allocation.vertexCount, baseVertex))
+			continue;
+		if (!AllocateRange(pages[page].freeIndexBytes, slotBytes, indexByteOffset))
+		{
+			ReleaseRange(pages[page].freeVertices, baseVertex, allocation.vertexCount);
+			continue;
+		}
+
+		allocation.page = page;
+		allocation.baseVertex = baseVertex;
+		allocation.indexByteOffset = indexByteOffset;
+		allocated = true;
+	}
+
+	if (!allocated)
+	{
+		CreatePage(std::max(pageVertexCount, allocation.vertexCount), std::max(pageIndexBytes, slotBytes));
+
+		allocation.page = pages.size() - 1;
+		AllocateRange(pages.back().freeVertices, allocation.vertexCount, allocation.baseVertex);
+		AllocateRange(pages.back().freeIndexBytes, slotBytes, allocation.indexByteOffset);
+	}
+
+	return allocation;
+}
+
+void BufferArena::Free(const Allocation& allocation)
+{
+	Page& page = pages[allocation.page];
+	ReleaseRange(page.freeVertices, allocation.baseVertex, allocation.vertexCount);
+	const size_t slotBytes = (allocation.indexBytes + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+	ReleaseRange(page.freeIndexBytes, allocation.indexByteOffset, slotBytes);
+}
+
+// the VAO keeps pointing at the page it was last drawn from, even across frames
+void BufferArena::BeginDraw()
+{
+	GLState::BindVertexArray(VAO);
+}
+
+void BufferArena::Draw(const Allocation& allocation, size_t lod)
+{
+	if (allocation.page != boundPage)
+		BindPage(allocation.page);
+
+	const GLenum indexType = GetIndexType(allocation.indexSize);
+	for (const IndexRange& range : allocation.lodRanges[lod])
+	{
+		GLCall(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)range.indexCount, indexType,
+			(void*)(allocation.indexByteOffset + range.byteOffset), (GLint)(allocation.baseVertex + range.baseVertex)));
+	}
+}
+
+void BufferArena::EndDraw()
+{
+	// empty
+}
+
+GLuint BufferArena::GetVertexBuffer(size_t page) const
+{
+	return pages[page].VBO;
+}
+
+GLuint BufferArena::GetIndexBuffer(size_t page) const
+{
+	return pages[page].EBO;
+}
+
+size_t BufferArena::GetPageCount() const
+{
+	return pages.size();
+}
+
+void BufferArena::CreatePage(size_t vertexCapacity, size_t indexByteCapacity)
+{
+	Page page;
+	page.vertexCapacity = vertexCapacity;
+	page.indexByteCapacity = indexByteCapacity;
+	page.freeVertices.push_back({ 0, vertexCapacity });
+	page.freeIndexBytes.push_back({ 0, indexByteCapacity });
+
+	GLCall(glGenBuffers(1, &page.VBO));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, page.VBO));
+	GLCall(glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * sizeof(Vertex), nullptr, GL_STATIC_DRAW));
+
+	GLCall(glGenBuffers(1, &page.EBO));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, page.EBO));
+	GLCall(glBufferData(GL_COPY_WRITE_BUFFER, indexByteCapacity, nullptr, GL_STATIC_DRAW));
+
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+
+	pages.push_back(std::move(page));
+}
+
+// the shared VAO must be bound; repoints its attributes and element buffer at another page
+void BufferArena::BindPage(size_t page)
+{
+	GLState::BindBuffer(GL_ARRAY_BUFFER, pages[page].VBO);
+
+	// vertex Positions
+	GLCall(glEnableVertexAttribArray(0));
+	GLCall(glVertexAttribPointer(0, dimof(Vertex::position), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position)));
+
+	// vertex normals
+	GLCall(glEnableVertexAttribArray(1));
+	GLCall(glVertexAttribPointer(1, dimof(Vertex::normal), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal)));
+
+	// vertex color coords
+	GLCall(glEnableVertexAttribArray(2));
+	GLCall(glVertexAttribPointer(2, dimof(Vertex::color), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color)));
+
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, pages[page].EBO);
+
+	boundPage = page;
+}
+
+bool BufferArena::AllocateRange(std::vector<Range>& freeRanges, size_t size, size_t& offset)
+{
+	if (size == 0)
+	{
+		offset = 0;
+		return true;
+	}
+
+	auto range = std::find_if(freeRanges.begin(), freeRanges.end(), [size](const Range& range) { return range.size >= size; });
+	if (range == freeRanges.end())
+		return false;
+
+	offset = range->offset;
+	range->offset += size;
+	range->size -= size;
+	if (range->size == 0)
+		freeRanges.erase(range);
+
+	return true;
+}
+
+void BufferArena::ReleaseRange(std::vector<Range>& freeRanges, size_t offset, size_t size)
+{
+	if (size == 0)
+		return;
+
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const Range& range, size_t offset) { return range.offset < offset; });
+	next = freeRanges.insert(next, { offset, size });
+
+	if (next + 1 != freeRanges.end() && next->offset + next->size == (next + 1)->offset)
+	{
+		next->size += (next + 1)->size;
+		freeRanges.erase(next + 1);
+	}
+
+	if (next != freeRanges.begin() && (next - 1)->offset + (next - 1)->size == next->offset)
+	{
+		(next - 1)->size += next->size;
+		freeRanges.erase(next);
+	}
+}
\ No newline at end of file
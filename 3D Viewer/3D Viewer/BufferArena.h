@@ -0,0 +1,78 @@
+#pragma once
+
+#include "utils.h"
+#include "MeshData.h"
+
+// Sub-allocates many meshes from a few large vertex / index buffer pages that all share one VAO.
+// A mesh is drawn with glDrawElementsBaseVertex from its slice of a page, so a scene costs
+// two buffers per page instead of three GL objects per mesh, and switching between meshes on
+// the same page costs no binds at all. Freed slices go back to a first-fit free list.
+class BufferArena
+{
+public:
+	struct Allocation
+	{
+		size_t page;
+		size_t baseVertex;
+		size_t vertexCount;
+		// index slices are byte ranges, so 16-bit and 32-bit meshes share the pages
+		size_t indexByteOffset;
+		size_t indexBytes;
+		size_t indexSize;
+		// the index runs of every level of detail
+		std::vector<std::vector<IndexRange>> lodRanges;
+	};
+
+	BufferArena(size_t pageVertexCount = DEFAULT_PAGE_VERTEX_COUNT, size_t pageIndexBytes = DEFAULT_PAGE_INDEX_BYTES);
+	BufferArena(const BufferArena&) = delete;
+	BufferArena& operator=(const BufferArena&) = delete;
+	~BufferArena();
+
+	// reserves the slices for the mesh, meshes bigger than a page get a page of their own;
+	// the caller fills them, ModelLoader does so in slices spread over frames
+	Allocation Allocate(const MeshData& mesh);
+	void Free(const Allocation& allocation);
+
+	GLuint GetVertexBuffer(size_t page) const;
+	GLuint GetIndexBuffer(size_t page) const;
+
+	// Draw() calls must be placed between BeginDraw() and EndDraw(); sorting them by page saves binds
+	void BeginDraw();
+	void Draw(const Allocation& allocation, size_t lod = 0);
+	void EndDraw();
+
+	size_t GetPageCount() const;
+
+private:
+	struct Range
+	{
+		size_t offset;
+		size_t size;
+	};
+
+	struct Page
+	{
+		GLuint VBO, EBO;
+		size_t vertexCapacity, indexByteCapacity;
+		// sorted by offset, neighbours are always merged
+		std::vector<Range> freeVertices, freeIndexBytes;
+	};
+
+	void CreatePage(size_t vertexCapacity, size_t indexByteCapacity);
+	void BindPage(size_t page);
+
+	static bool AllocateRange(std::vector<Range>& freeRanges, size_t size, size_t& offset);
+	static void ReleaseRange(std::vector<Range>& freeRanges, size_t offset, size_t size);
+
+private:
+	GLuint VAO;
+	std::vector<Page> pages;
+	size_t boundPage;
+	size_t pageVertexCount, pageIndexBytes;
+
+public:
+	static const size_t DEFAULT_PAGE_VERTEX_COUNT;
+	static const size_t DEFAULT_PAGE_INDEX_BYTES;
+	static const size_t INDEX_ALIGNMENT;
+	static const size_t NO_PAGE;
+};
\ No newline at end of file
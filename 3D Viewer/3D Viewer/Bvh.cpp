@@ -0,0 +1,488 @@
+#include "Bvh.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+static_assert(sizeof(Bvh::Node) == 32, "BVH nodes are meant to be 32 bytes");
+
+const uint32_t Bvh::MAX_LEAF_TRIANGLES = 8;
+const float Bvh::TRAVERSAL_COST = 1.0f;
+const uint32_t Bvh::EMPTY_LANE = std::numeric_limits<uint32_t>::max();
+
+static const size_t BIN_COUNT = 16;
+// ranges at least this big are binned on every thread
+static const size_t PARALLEL_GRAIN_SIZE = 1 << 16;
+static const size_t SUBTREES_PER_WORKER = 8;
+
+struct Bin
+{
+	glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+	uint32_t count = 0;
+};
+
+static float HalfArea(const glm::vec3& min, const glm::vec3& max)
+{
+	const glm::vec3 extent = glm::max(max - min, glm::vec3(0.0f));
+	return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+static glm::vec3 GetPosition(const MeshData& mesh, const Vertex* vertices, unsigned int vertex)
+{
+	return vertices != nullptr ? vertices[vertex].position : mesh.streams.GetPosition(vertex);
+}
+
+bool Bvh::Node::IsLeaf() const
+{
+	return count > 0;
+}
+
+Bvh::Bvh()
+	: firstIndex(0)
+{
+	// empty
+}
+
+Bvh::Bvh(const MeshData& mesh, size_t level)
+{
+	const MeshLod lod = mesh.GetLod(level);
+	firstIndex = lod.firstIndex;
+
+	const uint32_t triangleCount = static_cast<uint32_t>(lod.indexCount / 3);
+	if (triangleCount == 0)
+		return;
+
+	const Vertex* vertices = mesh.GetVertexData();
+	const unsigned int* indices = mesh.GetIndexData() + firstIndex;
+
+	BuildData data;
+	data.centroids.resize(triangleCount);
+	data.mins.resize(triangleCount);
+	data.maxes.resize(triangleCount);
+	triangles.resize(triangleCount);
+
+	ParallelForRange(triangleCount, PARALLEL_GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t triangle = begin; triangle < end; triangle++)
+		{
+			const glm::vec3 a = GetPosition(mesh, vertices, indices[3 * triangle]);
+			const glm::vec3 b = GetPosition(mesh, vertices, indices[3 * triangle + 1]);
+			const glm::vec3 c = GetPosition(mesh, vertices, indices[3 * triangle + 2]);
+			data.mins[triangle] = glm::min(a, glm::min(b, c));
+			data.maxes[triangle] = glm::max(a, glm::max(b, c));
+			data.centroids[triangle] = (data.mins[triangle] + data.maxes[triangle]) * 0.5f;
+			triangles[triangle] = static_cast<uint32_t>(triangle);
+		}
+	});
+
+	struct Task
+	{
+		uint32_t node;
+		uint32_t begin, end;
+	};
+
+	// the top levels are split one node at a time until there is enough independent work for every thread
+	const size_t subtreeTriangles = std::max<size_t>(triangleCount / (GetWorkerCount() * SUBTREES_PER_WORKER), PARALLEL_GRAIN_SIZE / 16);
+	std::vector<Task> pending = { { 0, 0, triangleCount } };
+	std::vector<Task> subtreeTasks;
+	nodes.push_back(Node());
+
+	while (!pending.empty())
+	{
+		const Task task = pending.back();
+		pending.pop_back();
+
+		if (task.end - task.begin <= subtreeTriangles)
+		{
+			subtreeTasks.push_back(task);
+			continue;
+		}
+
+		Node node;
+		const uint32_t middle = Split(data, task.begin, task.end, true, node);
+		if (middle != task.end)
+		{
+			node.first = static_cast<uint32_t>(nodes.size());
+			node.count = 0;
+			nodes.push_back(Node());
+			nodes.push_back(Node());
+			pending.push_back({ node.first + 1, middle, task.end });
+			pending.push_back({ node.first, task.begin, middle });
+		}
+		nodes[task.node] = node;
+	}
+
+	std::vector<std::vector<Node>> subtrees(subtreeTasks.size());
+	ParallelFor(subtreeTasks.size(), [&](size_t i)
+	{
+		BuildSubtree(data, subtreeTasks[i].begin, subtreeTasks[i].end, subtrees[i]);
+	});
+
+	// a subtree's root takes the place of its task's node, the rest is appended with its child links moved along
+	for (size_t i = 0; i < subtrees.size(); i++)
+	{
+		const uint32_t offset = static_cast<uint32_t>(nodes.size()) - 1;
+		for (Node& node : subtrees[i])
+		{
+			if (!node.IsLeaf())
+				node.first += offset;
+		}
+
+		nodes[subtreeTasks[i].node] = subtrees[i][0];
+		nodes.insert(nodes.end(), subtrees[i].begin() + 1, subtrees[i].end());
+	}
+}
+
+void Bvh::Refit(const MeshData& mesh)
+{
+	const Vertex* vertices = mesh.GetVertexData();
+	const unsigned int* indices = mesh.GetIndexData() + firstIndex;
+
+	ParallelForRange(nodes.size(), PARALLEL_GRAIN_SIZE / 16, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			Node& node = nodes[i];
+			if (!node.IsLeaf())
+				continue;
+
+			node.min = glm::vec3(std::numeric_limits<float>::max());
+			node.max = glm::vec3(std::numeric_limits<float>::lowest());
+			for (uint32_t leafTriangle = node.first; leafTriangle < node.first + node.count; leafTriangle++)
+			{
+				for (size_t corner = 0; corner < 3; corner++)
+				{
+					const glm::vec3 position = GetPosition(mesh, vertices, indices[3 * triangles[leafTriangle] + corner]);
+					node.min = glm::min(node.min, position);
+					node.max = glm::max(node.max, position);
+				}
+			}
+		}
+	});
+
+	// children always come after their parent
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		Node& node = nodes[i];
+		if (node.IsLeaf())
+			continue;
+
+		node.min = glm::min(nodes[node.first].min, nodes[node.first + 1].min);
+		node.max = glm::max(nodes[node.first].max, nodes[node.first + 1].max);
+	}
+
+	if (!wideNodes.empty())
+		BuildWideNodes();
+}
+
+void Bvh::BuildWideNodes()
+{
+	wideNodes.clear();
+	if (nodes.empty())
+		return;
+
+	struct Task
+	{
+		uint32_t wideNode;
+		uint32_t node;
+	};
+
+	std::vector<Task> pending = { { 0, 0 } };
+	wideNodes.push_back(WideNode());
+
+	while (!pending.empty())
+	{
+		const Task task = pending.back();
+		pending.pop_back();
+
+		// the children of the binary node, opening the biggest inner one until all four lanes are used
+		uint32_t lanes[4];
+		size_t laneCount = 0;
+		const Node& node = nodes[task.node];
+		if (node.IsLeaf())
+		{
+			lanes[laneCount++] = task.node;
+		}
+		else
+		{
+			lanes[laneCount++] = node.first;
+			lanes[laneCount++] = node.first + 1;
+		}
+
+		while (laneCount < 4)
+		{
+			size_t opened = laneCount;
+			float openedArea = -1.0f;
+			for (size_t lane = 0; lane < laneCount; lane++)
+			{
+				const Node& candidate = nodes[lanes[lane]];
+				const float area = HalfArea(candidate.min, candidate.max);
+				if (!candidate.IsLeaf() && area > openedArea)
+				{
+					opened = lane;
+					openedArea = area;
+				}
+			}
+			if (opened == laneCount)
+				break;
+
+			const uint32_t firstChild = nodes[lanes[opened]].first;
+			lanes[opened] = firstChild;
+			lanes[laneCount++] = firstChild + 1;
+		}
+
+		WideNode wideNode;
+		for (size_t lane = 0; lane < 4; lane++)
+		{
+			wideNode.minX[lane] = wideNode.minY[lane] = wideNode.minZ[lane] = std::numeric_limits<float>::max();
+			wideNode.maxX[lane] = wideNode.maxY[lane] = wideNode.maxZ[lane] = std::numeric_limits<float>::lowest();
+			wideNode.children[lane] = EMPTY_LANE;
+			wideNode.counts[lane] = 0;
+
+			if (lane >= laneCount)
+				continue;
+
+			const Node& child = nodes[lanes[lane]];
+			wideNode.minX[lane] = child.min.x;
+			wideNode.minY[lane] = child.min.y;
+			wideNode.minZ[lane] = child.min.z;
+			wideNode.maxX[lane] = child.max.x;
+			wideNode.maxY[lane] = child.max.y;
+			wideNode.maxZ[lane] = child.max.z;
+
+			if (child.IsLeaf())
+			{
+				wideNode.children[lane] = child.first;
+				wideNode.counts[lane] = child.count;
+			}
+			else
+			{
+				wideNode.children[lane] = static_cast<uint32_t>(wideNodes.size());
+				wideNodes.push_back(WideNode());
+				pending.push_back({ wideNode.children[lane], lanes[lane] });
+			}
+		}
+		wideNodes[task.wideNode] = wideNode;
+	}
+}
+
+const std::vector<Bvh::Node>& Bvh::GetNodes() const
+{
+	return nodes;
+}
+
+const std::vector<Bvh::WideNode>& Bvh::GetWideNodes() const
+{
+	return wideNodes;
+}
+
+const std::vector<uint32_t>& Bvh::GetTriangles() const
+{
+	return triangles;
+}
+
+size_t Bvh::GetFirstIndex() const
+{
+	return firstIndex;
+}
+
+float Bvh::GetSahCost() const
+{
+	if (nodes.empty())
+		return 0.0f;
+
+	double cost = 0.0;
+	for (const Node& node : nodes)
+		cost += HalfArea(node.min, node.max) * (node.IsLeaf() ? node.count : TRAVERSAL_COST);
+	return static_cast<float>(cost / HalfArea(nodes[0].min, nodes[0].max));
+}
+
+uint32_t Bvh::Split(const BuildData& data, uint32_t begin, uint32_t end, bool parallel, Node& node)
+{
+	const size_t count = end - begin;
+
+	// the node bounds and the bounds of the centroids, which place the bins
+	Bin bounds, centroids;
+	auto measure = [&](size_t rangeBegin, size_t rangeEnd, Bin& rangeBounds, Bin& rangeCentroids)
+	{
+		for (size_t i = rangeBegin; i < rangeEnd; i++)
+		{
+			const uint32_t triangle = triangles[i];
+			rangeBounds.min = glm::min(rangeBounds.min, data.mins[triangle]);
+			rangeBounds.max = glm::max(rangeBounds.max, data.maxes[triangle]);
+			rangeCentroids.min = glm::min(rangeCentroids.min, data.centroids[triangle]);
+			rangeCentroids.max = glm::max(rangeCentroids.max, data.centroids[triangle]);
+		}
+	};
+
+	const size_t blockCount = (count + PARALLEL_GRAIN_SIZE - 1) / PARALLEL_GRAIN_SIZE;
+	if (parallel && blockCount > 1)
+	{
+		std::vector<Bin> blockBounds(blockCount), blockCentroids(blockCount);
+		ParallelForRange(count, PARALLEL_GRAIN_SIZE, [&](size_t blockBegin, size_t blockEnd)
+		{
+			const size_t block = blockBegin / PARALLEL_GRAIN_SIZE;
+			measure(begin + blockBegin, begin + blockEnd, blockBounds[block], blockCentroids[block]);
+		});
+
+		for (size_t block = 0; block < blockCount; block++)
+		{
+			bounds.min = glm::min(bounds.min, blockBounds[block].min);
+			bounds.max = glm::max(bounds.max, blockBounds[block].max);
+			centroids.min = glm::min(centroids.min, blockCentroids[block].min);
+			centroids.max = glm::max(centroids.max, blockCentroids[block].max);
+		}
+	}
+	else
+	{
+		measure(begin, end, bounds, centroids);
+	}
+
+	node.min = bounds.min;
+	node.max = bounds.max;
+	node.first = begin;
+	node.count = static_cast<uint32_t>(count);
+	if (count == 1)
+		return end;
+
+	const glm::vec3 extent = centroids.max - centroids.min;
+	glm::vec3 binScale;
+	for (int axis = 0; axis < 3; axis++)
+		binScale[axis] = extent[axis] > 0.0f ? BIN_COUNT * 0.9999f / extent[axis] : 0.0f;
+	auto getBin = [&](uint32_t triangle, int axis)
+	{
+		return std::min(BIN_COUNT - 1, static_cast<size_t>((data.centroids[triangle][axis] - centroids.min[axis]) * binScale[axis]));
+	};
+
+	using Bins = std::array<Bin, 3 * BIN_COUNT>;
+	auto fill = [&](size_t rangeBegin, size_t rangeEnd, Bins& rangeBins)
+	{
+		for (size_t i = rangeBegin; i < rangeEnd; i++)
+		{
+			const uint32_t triangle = triangles[i];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				Bin& bin = rangeBins[axis * BIN_COUNT + getBin(triangle, axis)];
+				bin.min = glm::min(bin.min, data.mins[triangle]);
+				bin.max = glm::max(bin.max, data.maxes[triangle]);
+				bin.count++;
+			}
+		}
+	};
+
+	Bins bins;
+	if (parallel && blockCount > 1)
+	{
+		std::vector<Bins> blockBins(blockCount);
+		ParallelForRange(count, PARALLEL_GRAIN_SIZE, [&](size_t blockBegin, size_t blockEnd)
+		{
+			fill(begin + blockBegin, begin + blockEnd, blockBins[blockBegin / PARALLEL_GRAIN_SIZE]);
+		});
+
+		for (const Bins& block : blockBins)
+		{
+			for (size_t i = 0; i < bins.size(); i++)
+			{
+				bins[i].min = glm::min(bins[i].min, block[i].min);
+				bins[i].max = glm::max(bins[i].max, block[i].max);
+				bins[i].count += block[i].count;
+			}
+		}
+	}
+	else
+	{
+		fill(begin, end, bins);
+	}
+
+	// sweeps every axis from both sides; a split after bin b keeps bins [0, b] on the left
+	float bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	size_t bestBin = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (extent[axis] <= 0.0f)
+			continue;
+
+		float rightCosts[BIN_COUNT];
+		Bin right;
+		for (size_t bin = BIN_COUNT - 1; bin > 0; bin--)
+		{
+			const Bin& current = bins[axis * BIN_COUNT + bin];
+			right.min = glm::min(right.min, current.min);
+			right.max = glm::max(right.max, current.max);
+			right.count += current.count;
+			rightCosts[bin] = right.count > 0 ? HalfArea(right.min, right.max) * right.count : 0.0f;
+		}
+
+		Bin left;
+		for (size_t bin = 0; bin + 1 < BIN_COUNT; bin++)
+		{
+			const Bin& current = bins[axis * BIN_COUNT + bin];
+			left.min = glm::min(left.min, current.min);
+			left.max = glm::max(left.max, current.max);
+			left.count += current.count;
+			if (left.count == 0 || left.count == count)
+				continue;
+
+			const float cost = HalfArea(left.min, left.max) * left.count + rightCosts[bin + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bin;
+			}
+		}
+	}
+
+	// a split costs a traversal step plus the triangles of both children weighted by how likely they are hit
+	const float area = HalfArea(node.min, node.max);
+	const bool worthSplitting = bestAxis >= 0 && (area <= 0.0f || TRAVERSAL_COST + bestCost / area < count);
+	if (!worthSplitting && count <= MAX_LEAF_TRIANGLES)
+		return end;
+
+	uint32_t middle = begin + static_cast<uint32_t>(count / 2);
+	if (bestAxis >= 0)
+	{
+		middle = static_cast<uint32_t>(std::partition(triangles.begin() + begin, triangles.begin() + end,
+			[&](uint32_t triangle) { return getBin(triangle, bestAxis) <= bestBin; }) - triangles.begin());
+	}
+	// all centroids in one place: any halves will do
+	if (middle == begin || middle == end)
+		middle = begin + static_cast<uint32_t>(count / 2);
+
+	return middle;
+}
+
+void Bvh::BuildSubtree(const BuildData& data, uint32_t begin, uint32_t end, std::vector<Node>& subtree)
+{
+	struct Task
+	{
+		uint32_t node;
+		uint32_t begin, end;
+	};
+
+	std::vector<Task> pending = { { 0, begin, end } };
+	subtree.push_back(Node());
+
+	while (!pending.empty())
+	{
+		const Task task = pending.back();
+		pending.pop_back();
+
+		Node node;
+		const uint32_t middle = Split(data, task.begin, task.end, false, node);
+		if (middle != task.end)
+		{
+			node.first = static_cast<uint32_t>(subtree.size());
+			node.count = 0;
+			subtree.push_back(Node());
+			subtree.push_back(Node());
+			pending.push_back({ node.first + 1, middle, task.end });
+			pending.push_back({ node.first, task.begin, middle });
+		}
+		subtree[task.node] = node;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "utils.h"
+#include "MeshData.h"
+
+// A bounding volume hierarchy over the triangles of one level of detail of a mesh.
+// Built top-down with a binned surface area heuristic: the top levels are split one node at a
+// time with the binning spread over all threads, then the subtrees below are built in parallel.
+// Nodes are 32 bytes and the two children of a node are neighbours. The binary tree can be
+// collapsed into 4-wide nodes, whose four boxes are tested at once with SIMD.
+class Bvh
+{
+public:
+	struct Node
+	{
+		glm::vec3 min;
+		// leaves: the first of their triangles in GetTriangles(); inner nodes: the first child
+		uint32_t first;
+		glm::vec3 max;
+		// 0 for inner nodes
+		uint32_t count;
+
+		bool IsLeaf() const;
+	};
+
+	// the boxes of the four lanes stored component by component
+	struct alignas(16) WideNode
+	{
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		// leaf lanes: the first of their triangles in GetTriangles() and how many there are;
+		// inner lanes: a wide node and a count of 0; empty lanes have an inverted box and EMPTY_LANE
+		uint32_t children[4];
+		uint32_t counts[4];
+	};
+
+	Bvh();
+	Bvh(const MeshData& mesh, size_t level = 0);
+
+	// recomputes every box bottom-up after the vertices moved, keeping the tree as it is
+	void Refit(const MeshData& mesh);
+	// rebuilt by Refit() once built
+	void BuildWideNodes();
+
+	const std::vector<Node>& GetNodes() const;
+	const std::vector<WideNode>& GetWideNodes() const;
+	// triangle numbers, counted from the first index of the level, in leaf order
+	const std::vector<uint32_t>& GetTriangles() const;
+	size_t GetFirstIndex() const;
+	// the expected cost of a ray through the tree, in triangle intersections
+	float GetSahCost() const;
+
+private:
+	// the per triangle data only needed while building
+	struct BuildData
+	{
+		std::vector<glm::vec3> centroids;
+		std::vector<glm::vec3> mins;
+		std::vector<glm::vec3> maxes;
+	};
+
+	// fills node with the bounds of triangles [begin, end) and reorders them around the best split;
+	// returns the split position, or end when the node stays a leaf
+	uint32_t Split(const BuildData& data, uint32_t begin, uint32_t end, bool parallel, Node& node);
+	void BuildSubtree(const BuildData& data, uint32_t begin, uint32_t end, std::vector<Node>& subtree);
+
+private:
+	std::vector<Node> nodes;
+	std::vector<WideNode> wideNodes;
+	std::vector<uint32_t> triangles;
+	size_t firstIndex;
+
+public:
+	// bigger nodes are always split, smaller ones when the heuristic says it pays off
+	static const uint32_t MAX_LEAF_TRIANGLES;
+	// the cost of visiting a node, relative to intersecting a triangle
+	static const float TRAVERSAL_COST;
+	static const uint32_t EMPTY_LANE;
+};
\ No newline at end of file
@@ -62,6 +62,16 @@ glm::vec3 Camera::GetPosition() const
 	return position;
 }
 
+int Camera::GetWidth() const
+{
+	return width;
+}
+
+int Camera::GetHeight() const
+{
+	return height;
+}
+
 void Camera::MoveCamera(float xOffset, float yOffset, float zOffset)
 {
 	position += xOffset * right * Camera::SPEED_FACTOR;
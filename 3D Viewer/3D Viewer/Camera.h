@@ -11,6 +11,8 @@ public:
 	glm::mat4 GetViewMatrix() const;
 	glm::mat4 GetProjectionMatrix() const;
 	glm::vec3 GetPosition() const;
+	int GetWidth() const;
+	int GetHeight() const;
 
 	void MoveCamera(float xOffset, float yOffset, float zOffset);
 
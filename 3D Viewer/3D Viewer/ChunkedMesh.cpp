@@ -0,0 +1,256 @@
+#include "ChunkedMesh.h"
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+#include "Morton.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+const char ChunkedMesh::MAGIC[4] = { 'C', 'M', 'S', 'H' };
+const uint32_t ChunkedMesh::VERSION = 1;
+const size_t ChunkedMesh::DEFAULT_TRIANGLES_PER_CHUNK = 64 * 1024;
+const std::string ChunkedMesh::EXTENSION = ".cmesh";
+
+struct BuiltChunk
+{
+	ChunkInfo info;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+};
+
+static BuiltChunk BuildChunk(const Vertex* vertices, const unsigned int* indices, const uint64_t* keys, size_t triangleCount)
+{
+	BuiltChunk chunk;
+
+	std::vector<unsigned int> globalIndices(triangleCount * 3);
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		size_t triangle = static_cast<uint32_t>(keys[i]);
+		for (size_t corner = 0; corner < 3; corner++)
+			globalIndices[i * 3 + corner] = indices[triangle * 3 + corner];
+	}
+
+	std::vector<unsigned int> usedVertices = globalIndices;
+	std::sort(usedVertices.begin(), usedVertices.end());
+	usedVertices.erase(std::unique(usedVertices.begin(), usedVertices.end()), usedVertices.end());
+
+	chunk.vertices.reserve(usedVertices.size());
+	chunk.info.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	chunk.info.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+	for (unsigned int index : usedVertices)
+	{
+		chunk.vertices.push_back(vertices[index]);
+		chunk.info.boundsMin = glm::min(chunk.info.boundsMin, vertices[index].position);
+		chunk.info.boundsMax = glm::max(chunk.info.boundsMax, vertices[index].position);
+	}
+
+	chunk.indices.resize(globalIndices.size());
+	for (size_t i = 0; i < globalIndices.size(); i++)
+		chunk.indices[i] = static_cast<unsigned int>(std::lower_bound(usedVertices.begin(), usedVertices.end(), globalIndices[i]) - usedVertices.begin());
+
+	// the triangles arrive in Morton order, so every chunk is optimized on its own like a block of MeshData::OptimizeOrder
+	std::vector<size_t> clusterStarts;
+	MeshOptimizer::OptimizeVertexCache(chunk.indices.data(), chunk.indices.size(), chunk.vertices.size(), MeshOptimizer::DEFAULT_CACHE_SIZE, clusterStarts);
+	MeshOptimizer::OptimizeOverdraw(chunk.indices.data(), chunk.indices.size(), chunk.vertices.data(), clusterStarts);
+
+	const std::vector<unsigned int> remap = MeshOptimizer::OptimizeVertexFetch(chunk.indices.data(), chunk.indices.size(), chunk.vertices.size());
+	std::vector<Vertex> reordered(chunk.vertices.size());
+	for (size_t vertex = 0; vertex < chunk.vertices.size(); vertex++)
+		reordered[remap[vertex]] = chunk.vertices[vertex];
+	chunk.vertices = std::move(reordered);
+
+	chunk.info.vertexCount = chunk.vertices.size();
+	chunk.info.indexCount = chunk.indices.size();
+	return chunk;
+}
+
+uint64_t ChunkInfo::GetByteSize() const
+{
+	return vertexCount * sizeof(Vertex) + indexCount * sizeof(unsigned int);
+}
+
+float ChunkInfo::GetDistance(const glm::vec3& point) const
+{
+	return glm::length(glm::max(glm::max(boundsMin - point, point - boundsMax), glm::vec3(0.0f)));
+}
+
+ChunkedMesh::ChunkedMesh(const std::string& filePath)
+	: filePath(filePath), file(filePath, std::ios::binary)
+{
+	if (!file.is_open())
+		throw std::runtime_error(std::format("Could not open chunked mesh file {}", filePath).data());
+
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		throw std::runtime_error(std::format("Chunked mesh file {} is too small", filePath).data());
+
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+		throw std::runtime_error(std::format("File {} is not a chunked mesh", filePath).data());
+
+	if (header.version != VERSION || header.headerSize != sizeof(ChunkedMeshHeader) || header.vertexStride != sizeof(Vertex))
+		throw std::runtime_error(std::format("Chunked mesh file {} has an unsupported layout (version {})", filePath, header.version).data());
+
+	chunks.resize(static_cast<size_t>(header.chunkCount));
+	file.seekg(header.chunkTableOffset);
+	if (!file.read(reinterpret_cast<char*>(chunks.data()), chunks.size() * sizeof(ChunkInfo)))
+		throw std::runtime_error(std::format("Chunked mesh file {} is truncated", filePath).data());
+}
+
+size_t ChunkedMesh::GetChunkCount() const
+{
+	return chunks.size();
+}
+
+const ChunkInfo& ChunkedMesh::GetChunk(size_t chunk) const
+{
+	return chunks[chunk];
+}
+
+glm::vec3 ChunkedMesh::GetBoundsMin() const
+{
+	return glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+}
+
+glm::vec3 ChunkedMesh::GetBoundsMax() const
+{
+	return glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+}
+
+void ChunkedMesh::ReadChunk(size_t chunk, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	const ChunkInfo& info = chunks[chunk];
+	vertices.resize(static_cast<size_t>(info.vertexCount));
+	indices.resize(static_cast<size_t>(info.indexCount));
+
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	file.seekg(info.vertexOffset);
+	file.read(reinterpret_cast<char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+	file.seekg(info.indexOffset);
+	file.read(reinterpret_cast<char*>(indices.data()), indices.size() * sizeof(unsigned int));
+
+	if (!file)
+	{
+		file.clear();
+		throw std::runtime_error(std::format("Could not read chunk {} from chunked mesh file {}", chunk, filePath).data());
+	}
+}
+
+void ChunkedMesh::Build(const std::string& sourcePath, const std::string& destinationPath, size_t trianglesPerChunk)
+{
+	// only the full mesh is chunked, a .bmesh source may still bring its levels of detail along;
+	// the order is optimized per chunk instead, the Morton sort below would undo it anyway
+	LoadOptions options;
+	options.lodCount = 0;
+	options.optimizeOrder = false;
+	MeshData mesh = MeshData::Load(sourcePath, options);
+	const Vertex* vertices = mesh.GetVertexData();
+	const unsigned int* indices = mesh.GetIndexData();
+	const size_t vertexCount = mesh.GetVertexCount();
+	const size_t triangleCount = mesh.GetLod(0).indexCount / 3;
+
+	// the triangle number is packed in the low half of the sort key
+	if (triangleCount > std::numeric_limits<uint32_t>::max())
+		throw std::runtime_error(std::format("Model file {} has too many triangles to be chunked: {}", sourcePath, triangleCount).data());
+
+	const size_t grainSize = 1 << 16;
+	const size_t blockCount = (vertexCount + grainSize - 1) / grainSize;
+	std::vector<glm::vec3> blockMin(blockCount, glm::vec3(std::numeric_limits<float>::max()));
+	std::vector<glm::vec3> blockMax(blockCount, glm::vec3(std::numeric_limits<float>::lowest()));
+
+	ParallelForRange(vertexCount, grainSize, [&](size_t begin, size_t end)
+	{
+		size_t block = begin / grainSize;
+		for (size_t i = begin; i < end; i++)
+		{
+			blockMin[block] = glm::min(blockMin[block], vertices[i].position);
+			blockMax[block] = glm::max(blockMax[block], vertices[i].position);
+		}
+	});
+
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+	for (size_t block = 0; block < blockCount; block++)
+	{
+		boundsMin = glm::min(boundsMin, blockMin[block]);
+		boundsMax = glm::max(boundsMax, blockMax[block]);
+	}
+	const glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(std::numeric_limits<float>::min()));
+
+	std::vector<uint64_t> keys(triangleCount);
+	ParallelForRange(triangleCount, grainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			glm::vec3 centroid = (vertices[indices[i * 3]].position + vertices[indices[i * 3 + 1]].position + vertices[indices[i * 3 + 2]].position) / 3.0f;
+			keys[i] = (static_cast<uint64_t>(MortonCode((centroid - boundsMin) / extent)) << 32) | i;
+		}
+	});
+
+	ParallelSort(keys.begin(), keys.end());
+
+	trianglesPerChunk = std::max<size_t>(trianglesPerChunk, 1);
+	const size_t chunkCount = (triangleCount + trianglesPerChunk - 1) / trianglesPerChunk;
+
+	ChunkedMeshHeader header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.headerSize = sizeof(ChunkedMeshHeader);
+	header.vertexStride = sizeof(Vertex);
+	header.chunkCount = chunkCount;
+	header.chunkTableOffset = sizeof(ChunkedMeshHeader);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.boundsMin[axis] = boundsMin[axis];
+		header.boundsMax[axis] = boundsMax[axis];
+	}
+
+	std::ofstream file(destinationPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error(std::format("Could not create chunked mesh file {}", destinationPath).data());
+
+	// the chunk table is rewritten once all the blob offsets are known
+	std::vector<ChunkInfo> table(chunkCount);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(ChunkInfo));
+
+	uint64_t offset = header.chunkTableOffset + table.size() * sizeof(ChunkInfo);
+	const size_t batchSize = GetWorkerCount() * 4;
+	std::vector<BuiltChunk> batch;
+
+	for (size_t firstChunk = 0; firstChunk < chunkCount; firstChunk += batchSize)
+	{
+		batch.resize(std::min(batchSize, chunkCount - firstChunk));
+		ParallelFor(batch.size(), [&](size_t i)
+		{
+			size_t firstTriangle = (firstChunk + i) * trianglesPerChunk;
+			batch[i] = BuildChunk(vertices, indices, keys.data() + firstTriangle, std::min(trianglesPerChunk, triangleCount - firstTriangle));
+		});
+
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			ChunkInfo& info = table[firstChunk + i];
+			info = batch[i].info;
+
+			info.vertexOffset = offset;
+			file.write(reinterpret_cast<const char*>(batch[i].vertices.data()), batch[i].vertices.size() * sizeof(Vertex));
+			offset += batch[i].vertices.size() * sizeof(Vertex);
+
+			info.indexOffset = offset;
+			file.write(reinterpret_cast<const char*>(batch[i].indices.data()), batch[i].indices.size() * sizeof(unsigned int));
+			offset += batch[i].indices.size() * sizeof(unsigned int);
+		}
+	}
+
+	file.seekp(header.chunkTableOffset);
+	file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(ChunkInfo));
+
+	if (!file)
+		throw std::runtime_error(std::format("Could not write chunked mesh file {}", destinationPath).data());
+}
+
+bool ChunkedMesh::HasChunkedExtension(const std::string& filePath)
+{
+	return std::filesystem::path(filePath).extension() == EXTENSION;
+}
\ No newline at end of file
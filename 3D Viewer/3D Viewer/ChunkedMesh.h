@@ -0,0 +1,72 @@
+#pragma once
+
+#include "utils.h"
+#include "Vertex.h"
+
+#include <cstdint>
+#include <mutex>
+
+// On-disk layout of a .cmesh file: this header, the chunk table, then every chunk's
+// vertex and index blobs. Chunk indices are local to the chunk's own vertices.
+struct ChunkedMeshHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t vertexStride;
+	uint64_t chunkCount;
+	uint64_t chunkTableOffset;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+struct ChunkInfo
+{
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+
+	uint64_t GetByteSize() const;
+	// 0 when the point is inside the bounds
+	float GetDistance(const glm::vec3& point) const;
+};
+
+// A mesh split into spatially coherent chunks that can be read independently,
+// so models larger than the available memory only need their visible part loaded.
+// Triangles are ordered along a Morton curve of their centroids and cut into runs
+// of at most trianglesPerChunk, which keeps every chunk compact in space.
+class ChunkedMesh
+{
+public:
+	ChunkedMesh(const std::string& filePath);
+
+	size_t GetChunkCount() const;
+	const ChunkInfo& GetChunk(size_t chunk) const;
+	glm::vec3 GetBoundsMin() const;
+	glm::vec3 GetBoundsMax() const;
+
+	// safe to call from any thread
+	void ReadChunk(size_t chunk, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	// The source is loaded through MeshData, so a .bmesh source stays mapped instead of being read into memory.
+	// Text sources are parsed into memory whole; convert ones larger than the available memory to .bmesh first.
+	static void Build(const std::string& sourcePath, const std::string& destinationPath, size_t trianglesPerChunk = DEFAULT_TRIANGLES_PER_CHUNK);
+	static bool HasChunkedExtension(const std::string& filePath);
+
+private:
+	std::string filePath;
+	std::ifstream file;
+	std::mutex fileMutex;
+
+	ChunkedMeshHeader header;
+	std::vector<ChunkInfo> chunks;
+
+public:
+	static const char MAGIC[4];
+	static const uint32_t VERSION;
+	static const size_t DEFAULT_TRIANGLES_PER_CHUNK;
+	static const std::string EXTENSION;
+};
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "GLDiagnostics.h"
+
+#include "utils.h"
+
+#include <atomic>
+
+const uint64_t GLDiagnostics::FRAME_SAMPLE_INTERVAL = 60;
+
+struct DiagnosticsState
+{
+	GLDiagnostics::Mode mode = GLDiagnostics::Mode::FrameSampled;
+	bool initialized = false;
+	bool hasDebugOutput = false;
+	uint64_t frame = 0;
+	uint64_t lastCheckedFrame = 0;
+
+	// read by the debug output callback, which may run on a driver thread
+	std::atomic<const char*> callFunction = "none";
+	std::atomic<const char*> callFile = "none";
+	std::atomic<int> callLine = 0;
+};
+
+static DiagnosticsState state;
+
+static const char* const MODE_NAMES[] = { "off", "frame", "debug-output", "synchronous", "per-call" };
+
+static const char* GetSourceName(GLenum source)
+{
+	switch (source)
+	{
+	case GL_DEBUG_SOURCE_API: return "API";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+	case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+	case GL_DEBUG_SOURCE_APPLICATION: return "application";
+	default: return "other";
+	}
+}
+
+static const char* GetTypeName(GLenum type)
+{
+	switch (type)
+	{
+	case GL_DEBUG_TYPE_ERROR: return "Error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "Deprecated behavior";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "Undefined behavior";
+	case GL_DEBUG_TYPE_PORTABILITY: return "Portability";
+	case GL_DEBUG_TYPE_PERFORMANCE: return "Performance";
+	default: return "Message";
+	}
+}
+
+static const char* GetSeverityName(GLenum severity)
+{
+	switch (severity)
+	{
+	case GL_DEBUG_SEVERITY_HIGH: return "high";
+	case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+	case GL_DEBUG_SEVERITY_LOW: return "low";
+	default: return "notification";
+	}
+}
+
+// the call site is exact in Synchronous mode and the last GLCall before the message otherwise
+static void GLAPIENTRY DebugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
+{
+	const bool exact = state.mode == GLDiagnostics::Mode::Synchronous;
+	std::cout << std::format("[OpenGL {}]:\n\t id ( 0x{:x} ), {} severity, from the {}\n\t {}\n\t {} ( {} )\n\t at ( {} )\n\t during ( {} )\n",
+		GetTypeName(type), id, GetSeverityName(severity), GetSourceName(source), std::string(message, length),
+		exact ? "in" : "after", state.callFile.load(std::memory_order_relaxed), state.callLine.load(std::memory_order_relaxed),
+		state.callFunction.load(std::memory_order_relaxed));
+}
+
+// turns debug output on or off to match the mode
+static void ApplyMode()
+{
+	const bool debugOutput = state.mode == GLDiagnostics::Mode::DebugOutput || state.mode == GLDiagnostics::Mode::Synchronous;
+
+	if (GLEW_KHR_debug)
+	{
+		if (debugOutput)
+		{
+			glEnable(GL_DEBUG_OUTPUT);
+			glDebugMessageCallback(DebugMessageCallback, nullptr);
+			// notifications are mostly buffer placement hints
+			glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+		}
+		else
+		{
+			glDisable(GL_DEBUG_OUTPUT);
+		}
+	}
+	else if (GLEW_ARB_debug_output)
+	{
+		glDebugMessageCallbackARB(debugOutput ? DebugMessageCallback : nullptr, nullptr);
+	}
+
+	if (state.mode == GLDiagnostics::Mode::Synchronous)
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else if (state.hasDebugOutput)
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+	// whatever happened before the switch isn't blamed on the next call
+	GLClearError();
+}
+
+void GLDiagnostics::SetMode(Mode mode)
+{
+	state.mode = mode;
+	if (!state.initialized)
+		return;
+
+	if (!state.hasDebugOutput && (mode == Mode::DebugOutput || mode == Mode::Synchronous))
+	{
+		std::cout << "GL debug output isn't supported, checking for errors every " << FRAME_SAMPLE_INTERVAL << " frames instead" << std::endl;
+		state.mode = Mode::FrameSampled;
+	}
+	ApplyMode();
+}
+
+GLDiagnostics::Mode GLDiagnostics::GetMode()
+{
+	return state.mode;
+}
+
+bool GLDiagnostics::NeedsDebugContext()
+{
+#ifdef _DEBUG
+	// debug builds can switch to debug output at runtime, which is only reliable on a debug context
+	return true;
+#else
+	return state.mode == Mode::DebugOutput || state.mode == Mode::Synchronous;
+#endif
+}
+
+void GLDiagnostics::Init()
+{
+	state.initialized = true;
+	state.hasDebugOutput = GLEW_KHR_debug || GLEW_ARB_debug_output;
+	SetMode(state.mode);
+}
+
+bool GLDiagnostics::ParseMode(const std::string& name, Mode& mode)
+{
+	for (size_t index = 0; index < dimof(MODE_NAMES); index++)
+	{
+		if (name == MODE_NAMES[index])
+		{
+			mode = static_cast<Mode>(index);
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* GLDiagnostics::GetModeName(Mode mode)
+{
+	return MODE_NAMES[static_cast<size_t>(mode)];
+}
+
+void GLDiagnostics::BeginCall(const char* function, const char* file, int line)
+{
+	state.callFunction.store(function, std::memory_order_relaxed);
+	state.callFile.store(file, std::memory_order_relaxed);
+	state.callLine.store(line, std::memory_order_relaxed);
+
+	if (state.mode == Mode::PerCall)
+		GLClearError();
+}
+
+bool GLDiagnostics::EndCall()
+{
+	if (state.mode != Mode::PerCall)
+		return true;
+
+	return GLLogCall(state.callFunction.load(std::memory_order_relaxed), state.callFile.load(std::memory_order_relaxed), state.callLine.load(std::memory_order_relaxed));
+}
+
+void GLDiagnostics::EndFrame()
+{
+	state.frame++;
+	if (state.mode != Mode::FrameSampled || state.frame - state.lastCheckedFrame < FRAME_SAMPLE_INTERVAL)
+		return;
+
+	GLenum error;
+	while ((error = glGetError()) != GL_NO_ERROR)
+	{
+		std::cout << std::format("[OpenGL Error]:\n\t code ( 0x{:x} )\n\t between frames {} and {}\n\t last call at ( {} : {} )\n\t during ( {} )\n",
+			error, state.lastCheckedFrame, state.frame, state.callFile.load(std::memory_order_relaxed), state.callLine.load(std::memory_order_relaxed),
+			state.callFunction.load(std::memory_order_relaxed));
+	}
+	state.lastCheckedFrame = state.frame;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Reports GL errors without checking glGetError() after every call. GLCall only records its call
+// site, which costs a few stores; how errors are found depends on the mode, which can be changed
+// at any time:
+//	Off				nothing is checked
+//	FrameSampled	glGetError() once every FRAME_SAMPLE_INTERVAL frames, in EndFrame()
+//	DebugOutput		KHR_debug / ARB_debug_output messages, delivered whenever the driver gets to them
+//	Synchronous		debug output delivered inside the call that caused it, so the call site is exact
+//	PerCall			glGetError() around every call, breaking into the debugger like GLCall always did
+// FrameSampled is the default. The debug output modes fall back to it on drivers without either
+// extension, and only they ask for a debug context, except in debug builds.
+class GLDiagnostics
+{
+public:
+	enum class Mode
+	{
+		Off,
+		FrameSampled,
+		DebugOutput,
+		Synchronous,
+		PerCall
+	};
+
+	// before the window is created, so it can ask for a debug context
+	static void SetMode(Mode mode);
+	static Mode GetMode();
+	static bool NeedsDebugContext();
+	// once the context is current and GLEW is initialized
+	static void Init();
+
+	// off, frame, debug-output, synchronous or per-call; returns false for anything else
+	static bool ParseMode(const std::string& name, Mode& mode);
+	static const char* GetModeName(Mode mode);
+
+	// called by GLCall around every call; EndCall() returns false when the call failed
+	static void BeginCall(const char* function, const char* file, int line);
+	static bool EndCall();
+
+	// called once per frame, after the frame was submitted
+	static void EndFrame();
+
+public:
+	static const uint64_t FRAME_SAMPLE_INTERVAL;
+};
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "GLState.h"
+
+#include <limits>
+#include <unordered_map>
+
+const GLuint GLState::TRACKED_UNIFORM_BINDINGS = 16;
+
+// never a valid name, so the first change after Invalidate() is always issued
+static const GLuint UNKNOWN = std::numeric_limits<GLuint>::max();
+
+struct RangeBinding
+{
+	GLuint buffer = UNKNOWN;
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+};
+
+// what a new context starts with
+struct TrackedState
+{
+	GLuint program = 0;
+	GLuint vertexArray = 0;
+	GLuint arrayBuffer = 0;
+	GLuint uniformBuffer = 0;
+	// by vertex array
+	std::unordered_map<GLuint, GLuint> elementBuffers;
+	std::vector<RangeBinding> uniformBindings = std::vector<RangeBinding>(GLState::TRACKED_UNIFORM_BINDINGS);
+	std::unordered_map<GLenum, bool> capabilities;
+
+	GLState::Counters frame;
+	GLState::Counters lastFrame;
+};
+
+static TrackedState state;
+
+// counts the change; returns whether it has to be issued
+static bool Change(GLuint& current, GLuint value)
+{
+	if (current == value)
+	{
+		state.frame.elided++;
+		return false;
+	}
+
+	current = value;
+	state.frame.issued++;
+	return true;
+}
+
+void GLState::UseProgram(GLuint program)
+{
+	if (Change(state.program, program))
+	{
+		GLCall(glUseProgram(program));
+	}
+}
+
+void GLState::BindVertexArray(GLuint vertexArray)
+{
+	if (Change(state.vertexArray, vertexArray))
+	{
+		GLCall(glBindVertexArray(vertexArray));
+	}
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint* current = nullptr;
+	if (target == GL_ARRAY_BUFFER)
+		current = &state.arrayBuffer;
+	else if (target == GL_UNIFORM_BUFFER)
+		current = &state.uniformBuffer;
+	else if (target == GL_ELEMENT_ARRAY_BUFFER && state.vertexArray != UNKNOWN)
+		current = &state.elementBuffers.try_emplace(state.vertexArray, UNKNOWN).first->second;
+
+	if (current == nullptr)
+		state.frame.issued++;
+	else if (!Change(*current, buffer))
+		return;
+
+	GLCall(glBindBuffer(target, buffer));
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (target == GL_UNIFORM_BUFFER && index < TRACKED_UNIFORM_BINDINGS)
+	{
+		RangeBinding& binding = state.uniformBindings[index];
+		if (binding.buffer == buffer && binding.offset == offset && binding.size == size)
+		{
+			state.frame.elided++;
+			return;
+		}
+
+		binding = { buffer, offset, size };
+		// also binds the generic binding point
+		state.uniformBuffer = buffer;
+	}
+
+	state.frame.issued++;
+	GLCall(glBindBufferRange(target, index, buffer, offset, size));
+}
+
+void GLState::Enable(GLenum capability)
+{
+	auto [entry, inserted] = state.capabilities.try_emplace(capability, false);
+	if (!inserted && entry->second)
+	{
+		state.frame.elided++;
+		return;
+	}
+
+	entry->second = true;
+	state.frame.issued++;
+	GLCall(glEnable(capability));
+}
+
+void GLState::Disable(GLenum capability)
+{
+	auto [entry, inserted] = state.capabilities.try_emplace(capability, true);
+	if (!inserted && !entry->second)
+	{
+		state.frame.elided++;
+		return;
+	}
+
+	entry->second = false;
+	state.frame.issued++;
+	GLCall(glDisable(capability));
+}
+
+void GLState::DeleteProgram(GLuint program)
+{
+	// a program in use is only deleted once it isn't anymore, so the binding stays as it is
+	GLCall(glDeleteProgram(program));
+	if (state.program == program)
+		state.program = UNKNOWN;
+}
+
+void GLState::DeleteVertexArray(GLuint vertexArray)
+{
+	GLCall(glDeleteVertexArrays(1, &vertexArray));
+	if (state.vertexArray == vertexArray)
+		state.vertexArray = 0;
+	state.elementBuffers.erase(vertexArray);
+}
+
+void GLState::DeleteBuffer(GLuint buffer)
+{
+	GLCall(glDeleteBuffers(1, &buffer));
+	if (state.arrayBuffer == buffer)
+		state.arrayBuffer = 0;
+	if (state.uniformBuffer == buffer)
+		state.uniformBuffer = 0;
+
+	// vertex arrays that aren't bound keep referencing the deleted buffer, and its name can come back
+	for (auto& [vertexArray, elementBuffer] : state.elementBuffers)
+	{
+		if (elementBuffer == buffer)
+			elementBuffer = vertexArray == state.vertexArray ? 0 : UNKNOWN;
+	}
+	for (RangeBinding& binding : state.uniformBindings)
+	{
+		if (binding.buffer == buffer)
+			binding.buffer = UNKNOWN;
+	}
+}
+
+void GLState::Invalidate()
+{
+	const Counters frame = state.frame;
+	const Counters lastFrame = state.lastFrame;
+
+	state = TrackedState();
+	state.program = UNKNOWN;
+	state.vertexArray = UNKNOWN;
+	state.arrayBuffer = UNKNOWN;
+	state.uniformBuffer = UNKNOWN;
+
+	state.frame = frame;
+	state.lastFrame = lastFrame;
+}
+
+void GLState::EndFrame()
+{
+	state.lastFrame = state.frame;
+	state.frame = Counters();
+}
+
+GLState::Counters GLState::GetFrameCounters()
+{
+	return state.lastFrame;
+}
\ No newline at end of file
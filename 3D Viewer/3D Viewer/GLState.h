@@ -0,0 +1,42 @@
+#pragma once
+
+#include "utils.h"
+
+// A cache of the bindings and capabilities the viewer changes, so calls that wouldn't change
+// anything are never issued. Every change to the tracked state has to go through here.
+// The element buffer binding is kept per vertex array, since GL stores it there.
+// There is a single GL context, so the state is global.
+class GLState
+{
+public:
+	struct Counters
+	{
+		uint64_t issued = 0;
+		uint64_t elided = 0;
+	};
+
+	static void UseProgram(GLuint program);
+	static void BindVertexArray(GLuint vertexArray);
+	// GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_UNIFORM_BUFFER are tracked, other targets always bind
+	static void BindBuffer(GLenum target, GLuint buffer);
+	static void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	static void Enable(GLenum capability);
+	static void Disable(GLenum capability);
+
+	// GL unbinds deleted objects and reuses their names, so they are forgotten here too
+	static void DeleteProgram(GLuint program);
+	static void DeleteVertexArray(GLuint vertexArray);
+	static void DeleteBuffer(GLuint buffer);
+
+	// for after GL calls that went around the cache; the next change of anything is issued
+	static void Invalidate();
+
+	// starts counting a new frame
+	static void EndFrame();
+	// the calls of the frame before the last EndFrame()
+	static Counters GetFrameCounters();
+
+public:
+	// indexed GL_UNIFORM_BUFFER bindings below this are tracked
+	static const GLuint TRACKED_UNIFORM_BINDINGS;
+};
\ No newline at end of file
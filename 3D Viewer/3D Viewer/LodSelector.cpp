@@ -0,0 +1,62 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+
+const float LodSelector::DEFAULT_PIXEL_ERROR = 1.0f;
+const float LodSelector::HYSTERESIS = 0.25f;
+
+LodSelector::LodSelector()
+	: center(0.0f), radius(0.0f), errors(1, 0.0f), level(0)
+{
+	// empty
+}
+
+LodSelector::LodSelector(const MeshData& mesh)
+	: level(0)
+{
+	glm::vec3 min, max;
+	mesh.GetBounds(min, max);
+	center = (min + max) * 0.5f;
+	radius = glm::length(max - min) * 0.5f;
+
+	for (size_t lod = 0; lod < mesh.GetLodCount(); lod++)
+		errors.push_back(mesh.GetLod(lod).error);
+}
+
+size_t LodSelector::Select(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight, float pixelError)
+{
+	const glm::vec3 viewCenter = glm::vec3(modelView * glm::vec4(center, 1.0f));
+	const float scale = std::max({ glm::length(glm::vec3(modelView[0])), glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2])) });
+
+	// the clip w of the sphere's point nearest to the camera: its distance for a perspective
+	// projection, 1 for an orthographic one; the camera is inside the sphere or past it when not positive
+	const float w = projection[2][3] * (viewCenter.z + radius * scale) + projection[3][3];
+	if (w <= 0.0f)
+	{
+		level = 0;
+		return level;
+	}
+
+	const float pixelsPerUnit = scale * projection[1][1] * viewportHeight * 0.5f / w;
+
+	size_t target = 0;
+	for (size_t lod = errors.size(); lod-- > 1;)
+	{
+		if (errors[lod] * pixelsPerUnit <= pixelError)
+		{
+			target = lod;
+			break;
+		}
+	}
+
+	while (target > level && errors[target] * pixelsPerUnit > pixelError * (1.0f - HYSTERESIS))
+		target--;
+
+	level = target;
+	return level;
+}
+
+size_t LodSelector::GetLevel() const
+{
+	return level;
+}
\ No newline at end of file
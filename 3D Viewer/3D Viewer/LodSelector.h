@@ -0,0 +1,29 @@
+#pragma once
+
+#include "utils.h"
+#include "MeshData.h"
+
+// Picks the level of detail of one mesh every frame: the coarsest level whose error, projected at the
+// nearest point of the mesh's bounding sphere, stays within a pixel budget. Going coarser needs a
+// margin below the budget, so a mesh sitting right at a threshold doesn't pop back and forth.
+class LodSelector
+{
+public:
+	LodSelector();
+	LodSelector(const MeshData& mesh);
+
+	// modelView and projection as the shaders get them, viewportHeight in pixels; returns the level to draw
+	size_t Select(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight, float pixelError = DEFAULT_PIXEL_ERROR);
+	size_t GetLevel() const;
+
+private:
+	glm::vec3 center;
+	float radius;
+	std::vector<float> errors;
+	size_t level;
+
+public:
+	static const float DEFAULT_PIXEL_ERROR;
+	// a coarser level is only taken once its error is this fraction below the budget
+	static const float HYSTERESIS;
+};
\ No newline at end of file
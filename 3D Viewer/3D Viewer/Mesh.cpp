@@ -0,0 +1,301 @@
+#include "Mesh.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+const unsigned int Mesh::NO_HALF_EDGE = std::numeric_limits<unsigned int>::max();
+const size_t Mesh::DEFAULT_BUILD_BUDGET = 1024ull * 1024 * 1024;
+
+// an undirected edge with the half-edge it came from; sorted, the half-edges of one edge are neighbours
+struct EdgeRecord
+{
+	unsigned int low, high;
+	unsigned int halfEdge;
+
+	bool operator<(const EdgeRecord& other) const
+	{
+		if (low != other.low)
+			return low < other.low;
+		if (high != other.high)
+			return high < other.high;
+		return halfEdge < other.halfEdge;
+	}
+};
+
+// vertices are split into passes in blocks of this many
+static const size_t VERTEX_BLOCK_SIZE = 1 << 16;
+static const size_t GRAIN_SIZE = 1 << 20;
+
+Mesh::Mesh(const MeshData& mesh, size_t buildBudget)
+	: Mesh(mesh.GetIndexData(), mesh.GetIndexCount(), mesh.GetVertexCount(), buildBudget)
+{
+	// empty
+}
+
+Mesh::Mesh(const unsigned int* indices, size_t indexCount, size_t vertexCount, size_t buildBudget)
+	: indices(indices, indices + indexCount / 3 * 3), outgoing(vertexCount, NO_HALF_EDGE), boundaryHalfEdgeCount(0), nonManifoldEdgeCount(0)
+{
+	// the outgoing half-edges are picked by packing a boundary flag into the top bit
+	if (this->indices.size() >= (1ull << 31))
+		throw std::runtime_error(std::format("Too many triangles for the connectivity structure: {}", indexCount / 3).data());
+
+	ParallelForRange(this->indices.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			if (this->indices[i] >= vertexCount)
+				throw std::runtime_error(std::format("Index {} is out of range for {} vertices", this->indices[i], vertexCount).data());
+		}
+	});
+
+	BuildTwins(buildBudget);
+	BuildOutgoing();
+}
+
+size_t Mesh::GetVertexCount() const
+{
+	return outgoing.size();
+}
+
+size_t Mesh::GetFaceCount() const
+{
+	return indices.size() / 3;
+}
+
+size_t Mesh::GetHalfEdgeCount() const
+{
+	return indices.size();
+}
+
+size_t Mesh::GetBoundaryHalfEdgeCount() const
+{
+	return boundaryHalfEdgeCount;
+}
+
+size_t Mesh::GetNonManifoldEdgeCount() const
+{
+	return nonManifoldEdgeCount;
+}
+
+unsigned int Mesh::GetOrigin(unsigned int halfEdge) const
+{
+	return indices[halfEdge];
+}
+
+unsigned int Mesh::GetTarget(unsigned int halfEdge) const
+{
+	return indices[GetNext(halfEdge)];
+}
+
+unsigned int Mesh::GetFace(unsigned int halfEdge) const
+{
+	return halfEdge / 3;
+}
+
+unsigned int Mesh::GetNext(unsigned int halfEdge) const
+{
+	return halfEdge % 3 == 2 ? halfEdge - 2 : halfEdge + 1;
+}
+
+unsigned int Mesh::GetPrevious(unsigned int halfEdge) const
+{
+	return halfEdge % 3 == 0 ? halfEdge + 2 : halfEdge - 1;
+}
+
+unsigned int Mesh::GetTwin(unsigned int halfEdge) const
+{
+	return twins[halfEdge];
+}
+
+bool Mesh::IsBoundary(unsigned int halfEdge) const
+{
+	return twins[halfEdge] == NO_HALF_EDGE;
+}
+
+unsigned int Mesh::GetOutgoing(unsigned int vertex) const
+{
+	return outgoing[vertex];
+}
+
+unsigned int Mesh::GetNextAroundVertex(unsigned int halfEdge) const
+{
+	return twins[GetPrevious(halfEdge)];
+}
+
+bool Mesh::IsBoundaryVertex(unsigned int vertex) const
+{
+	return outgoing[vertex] != NO_HALF_EDGE && IsBoundary(outgoing[vertex]);
+}
+
+size_t Mesh::GetValence(unsigned int vertex) const
+{
+	size_t valence = 0;
+	ForEachNeighbour(vertex, [&valence](unsigned int) { valence++; });
+	return valence;
+}
+
+void Mesh::BuildTwins(size_t buildBudget)
+{
+	const size_t halfEdgeCount = indices.size();
+	twins.assign(halfEdgeCount, NO_HALF_EDGE);
+
+	// every edge is sorted in the pass that owns its lower vertex;
+	// a histogram over vertex blocks tells how many records each pass will hold
+	const size_t vertexBlockCount = outgoing.size() / VERTEX_BLOCK_SIZE + 1;
+	const size_t rangeCount = (halfEdgeCount + GRAIN_SIZE - 1) / GRAIN_SIZE;
+
+	auto lowVertex = [this](size_t halfEdge) { return std::min(indices[halfEdge], indices[GetNext(static_cast<unsigned int>(halfEdge))]); };
+	auto isDegenerate = [this](size_t halfEdge) { return indices[halfEdge] == indices[GetNext(static_cast<unsigned int>(halfEdge))]; };
+
+	std::vector<size_t> blockCounts(vertexBlockCount, 0);
+	{
+		std::vector<std::vector<size_t>> rangeCounts(rangeCount);
+		ParallelForRange(halfEdgeCount, GRAIN_SIZE, [&](size_t begin, size_t end)
+		{
+			std::vector<size_t>& counts = rangeCounts[begin / GRAIN_SIZE];
+			counts.assign(vertexBlockCount, 0);
+			for (size_t halfEdge = begin; halfEdge < end; halfEdge++)
+			{
+				if (!isDegenerate(halfEdge))
+					counts[lowVertex(halfEdge) / VERTEX_BLOCK_SIZE]++;
+			}
+		});
+
+		for (const std::vector<size_t>& counts : rangeCounts)
+		{
+			for (size_t block = 0; block < vertexBlockCount; block++)
+				blockCounts[block] += counts[block];
+		}
+	}
+
+	// the merge rounds of the sort may allocate as much again as the records themselves
+	const size_t recordsPerPass = std::max<size_t>(buildBudget / (2 * sizeof(EdgeRecord)), 1);
+
+	std::vector<EdgeRecord> records;
+	std::vector<size_t> rangeOffsets(rangeCount + 1);
+	std::atomic<size_t> boundaryCount = 0, nonManifoldCount = 0;
+
+	for (size_t firstBlock = 0; firstBlock < vertexBlockCount;)
+	{
+		// a single block over the budget still gets a pass of its own
+		size_t lastBlock = firstBlock, recordCount = blockCounts[firstBlock];
+		while (lastBlock + 1 < vertexBlockCount && recordCount + blockCounts[lastBlock + 1] <= recordsPerPass)
+			recordCount += blockCounts[++lastBlock];
+
+		const size_t low = firstBlock * VERTEX_BLOCK_SIZE, high = (lastBlock + 1) * VERTEX_BLOCK_SIZE;
+		auto inPass = [&](size_t halfEdge) { return !isDegenerate(halfEdge) && lowVertex(halfEdge) >= low && lowVertex(halfEdge) < high; };
+
+		// count, then scatter, so the records keep half-edge order before sorting
+		ParallelForRange(halfEdgeCount, GRAIN_SIZE, [&](size_t begin, size_t end)
+		{
+			size_t count = 0;
+			for (size_t halfEdge = begin; halfEdge < end; halfEdge++)
+				count += inPass(halfEdge);
+			rangeOffsets[begin / GRAIN_SIZE + 1] = count;
+		});
+
+		rangeOffsets[0] = 0;
+		for (size_t range = 0; range < rangeCount; range++)
+			rangeOffsets[range + 1] += rangeOffsets[range];
+
+		records.resize(recordCount);
+		ParallelForRange(halfEdgeCount, GRAIN_SIZE, [&](size_t begin, size_t end)
+		{
+			size_t slot = rangeOffsets[begin / GRAIN_SIZE];
+			for (size_t halfEdge = begin; halfEdge < end; halfEdge++)
+			{
+				if (!inPass(halfEdge))
+					continue;
+
+				unsigned int origin = indices[halfEdge], target = indices[GetNext(static_cast<unsigned int>(halfEdge))];
+				records[slot++] = { std::min(origin, target), std::max(origin, target), static_cast<unsigned int>(halfEdge) };
+			}
+		});
+
+		ParallelSort(records.begin(), records.end());
+
+		// every block handles the edges that start inside it, even if they run past its end
+		ParallelForRange(recordCount, GRAIN_SIZE, [&](size_t begin, size_t end)
+		{
+			auto sameEdge = [&](size_t a, size_t b) { return records[a].low == records[b].low && records[a].high == records[b].high; };
+
+			size_t boundary = 0, nonManifold = 0;
+			size_t first = begin;
+			while (first > 0 && first < recordCount && sameEdge(first, first - 1))
+				first++;
+
+			while (first < end)
+			{
+				size_t last = first + 1;
+				while (last < recordCount && sameEdge(first, last))
+					last++;
+
+				const unsigned int a = records[first].halfEdge, b = records[last - 1].halfEdge;
+				if (last - first == 2 && indices[a] != indices[b])
+				{
+					twins[a] = b;
+					twins[b] = a;
+				}
+				else
+				{
+					boundary += last - first;
+					nonManifold += last - first > 1;
+				}
+
+				first = last;
+			}
+
+			boundaryCount += boundary;
+			nonManifoldCount += nonManifold;
+		});
+
+		firstBlock = lastBlock + 1;
+	}
+
+	// degenerate half-edges never get a twin
+	size_t degenerateCount = 0;
+	for (size_t block = 0; block < vertexBlockCount; block++)
+		degenerateCount += blockCounts[block];
+	degenerateCount = halfEdgeCount - degenerateCount;
+
+	boundaryHalfEdgeCount = boundaryCount + degenerateCount;
+	nonManifoldEdgeCount = nonManifoldCount;
+}
+
+void Mesh::BuildOutgoing()
+{
+	// every vertex keeps its lowest boundary half-edge, or its lowest half-edge when it has none,
+	// so the result doesn't depend on the thread timing; degenerate half-edges have no twin
+	// but aren't a boundary, so they are never picked
+	const unsigned int interiorFlag = 1u << 31;
+
+	ParallelForRange(indices.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t halfEdge = begin; halfEdge < end; halfEdge++)
+		{
+			if (indices[halfEdge] == indices[GetNext(static_cast<unsigned int>(halfEdge))])
+				continue;
+
+			unsigned int key = static_cast<unsigned int>(halfEdge) | (IsBoundary(static_cast<unsigned int>(halfEdge)) ? 0 : interiorFlag);
+
+			std::atomic_ref<unsigned int> slot(outgoing[indices[halfEdge]]);
+			unsigned int current = slot.load(std::memory_order_relaxed);
+			while (key < current && !slot.compare_exchange_weak(current, key, std::memory_order_relaxed))
+			{
+				// retried with the value another thread stored
+			}
+		}
+	});
+
+	ParallelForRange(outgoing.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t vertex = begin; vertex < end; vertex++)
+		{
+			if (outgoing[vertex] != NO_HALF_EDGE)
+				outgoing[vertex] &= ~interiorFlag;
+		}
+	});
+}
\ No newline at end of file
@@ -1,8 +1,83 @@
 #pragma once
 
 #include "utils.h"
+#include "MeshData.h"
 
+// Triangle connectivity as flat half-edge arrays, for algorithms that walk the surface.
+// Half-edge h is corner h % 3 of face h / 3 and runs from vertex indices[h] to the next corner,
+// so next, previous, face and origin are all arithmetic; only the twins and one outgoing
+// half-edge per vertex are stored. Twins are found by sorting the edges in parallel, in passes
+// over vertex ranges so the sort buffers stay within a memory budget.
+//
+// Edges shared by more than two faces, or by two faces that disagree on their orientation,
+// are treated as boundaries. Around a vertex only the fan of its stored half-edge is walked.
 class Mesh
 {
+public:
+	Mesh(const MeshData& mesh, size_t buildBudget = DEFAULT_BUILD_BUDGET);
+	Mesh(const unsigned int* indices, size_t indexCount, size_t vertexCount, size_t buildBudget = DEFAULT_BUILD_BUDGET);
 
+	size_t GetVertexCount() const;
+	size_t GetFaceCount() const;
+	size_t GetHalfEdgeCount() const;
+	size_t GetBoundaryHalfEdgeCount() const;
+	size_t GetNonManifoldEdgeCount() const;
+
+	unsigned int GetOrigin(unsigned int halfEdge) const;
+	unsigned int GetTarget(unsigned int halfEdge) const;
+	unsigned int GetFace(unsigned int halfEdge) const;
+	unsigned int GetNext(unsigned int halfEdge) const;
+	unsigned int GetPrevious(unsigned int halfEdge) const;
+	// NO_HALF_EDGE on boundaries
+	unsigned int GetTwin(unsigned int halfEdge) const;
+	bool IsBoundary(unsigned int halfEdge) const;
+
+	// NO_HALF_EDGE for unused vertices; on a boundary vertex it is the half-edge the fan starts with
+	unsigned int GetOutgoing(unsigned int vertex) const;
+	// the next outgoing half-edge counterclockwise around its origin, NO_HALF_EDGE past a boundary
+	unsigned int GetNextAroundVertex(unsigned int halfEdge) const;
+	bool IsBoundaryVertex(unsigned int vertex) const;
+	size_t GetValence(unsigned int vertex) const;
+
+	// calls visit(neighbour) for every vertex sharing an edge with vertex, counterclockwise
+	template<typename Function>
+	void ForEachNeighbour(unsigned int vertex, Function&& visit) const;
+
+private:
+	void BuildTwins(size_t buildBudget);
+	void BuildOutgoing();
+
+private:
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> twins;
+	std::vector<unsigned int> outgoing;
+	size_t boundaryHalfEdgeCount, nonManifoldEdgeCount;
+
+public:
+	static const unsigned int NO_HALF_EDGE;
+	// bytes of edge records sorted at once; bigger meshes are built in several passes
+	static const size_t DEFAULT_BUILD_BUDGET;
 };
+
+template<typename Function>
+void Mesh::ForEachNeighbour(unsigned int vertex, Function&& visit) const
+{
+	const unsigned int first = GetOutgoing(vertex);
+	if (first == NO_HALF_EDGE)
+		return;
+
+	unsigned int halfEdge = first;
+	do
+	{
+		visit(GetTarget(halfEdge));
+
+		unsigned int next = GetNextAroundVertex(halfEdge);
+		// the edge closing an open fan has no outgoing half-edge of its own
+		if (next == NO_HALF_EDGE)
+		{
+			visit(GetOrigin(GetPrevious(halfEdge)));
+			return;
+		}
+		halfEdge = next;
+	} while (halfEdge != first);
+}
\ No newline at end of file
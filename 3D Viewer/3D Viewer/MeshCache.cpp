@@ -0,0 +1,189 @@
+#include "MeshCache.h"
+#include "BinaryMesh.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+const uint64_t MeshCache::DEFAULT_MAX_BYTES = 4ull * 1024 * 1024 * 1024;
+const size_t MeshCache::HASH_CHUNK_SIZE = 16 * 1024 * 1024;
+
+static const uint64_t HASH_PRIME_1 = 0x9E3779B185EBCA87ull;
+static const uint64_t HASH_PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+
+static uint64_t RotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t MixHash(uint64_t hash, uint64_t value)
+{
+	hash ^= RotateLeft(value * HASH_PRIME_2, 31) * HASH_PRIME_1;
+	return RotateLeft(hash, 27) * HASH_PRIME_1 + HASH_PRIME_2;
+}
+
+// four independent lanes over 8 byte words, so the multiplies pipeline
+static uint64_t HashChunk(const uint8_t* data, size_t size, uint64_t seed)
+{
+	uint64_t lanes[4] = { seed + HASH_PRIME_1, seed + HASH_PRIME_2, seed, seed - HASH_PRIME_1 };
+
+	size_t offset = 0;
+	for (; offset + 32 <= size; offset += 32)
+	{
+		uint64_t words[4];
+		std::memcpy(words, data + offset, sizeof(words));
+		for (int lane = 0; lane < 4; lane++)
+			lanes[lane] = RotateLeft(lanes[lane] + words[lane] * HASH_PRIME_2, 31) * HASH_PRIME_1;
+	}
+
+	uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+	for (; offset < size; offset++)
+		hash = MixHash(hash, data[offset]);
+
+	return MixHash(hash, size);
+}
+
+MeshCache::MeshCache(const std::string& directory, uint64_t maxBytes)
+	: directory(directory), maxBytes(maxBytes)
+{
+	fs::create_directories(this->directory);
+}
+
+MeshData MeshCache::Load(const std::string& filePath, const LoadOptions& options)
+{
+	// already processed, caching it would only copy the file
+	if (BinaryMesh::HasBinaryExtension(filePath))
+		return MeshData::LoadBinary(filePath);
+
+	const uint64_t key = MixHash(HashFile(filePath), options.GetHash());
+	const std::string entryPath = GetEntryPath(key);
+
+	try
+	{
+		MeshData mesh = MeshData::LoadBinary(entryPath);
+
+		// keeps the entry at the back of the eviction order
+		std::error_code error;
+		fs::last_write_time(entryPath, fs::file_time_type::clock::now(), error);
+
+		hitCount++;
+		bytesSaved += fs::file_size(filePath);
+		return mesh;
+	}
+	catch (const std::exception&)
+	{
+		// missing or unreadable entry, rebuild it below
+	}
+
+	missCount++;
+	MeshData mesh = MeshData::Load(filePath, options);
+
+	try
+	{
+		Store(entryPath, mesh);
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Could not write the mesh cache entry " << entryPath << "\n\t" << e.what() << std::endl;
+	}
+
+	return mesh;
+}
+
+uint64_t MeshCache::GetHitCount() const
+{
+	return hitCount;
+}
+
+uint64_t MeshCache::GetMissCount() const
+{
+	return missCount;
+}
+
+uint64_t MeshCache::GetBytesSaved() const
+{
+	return bytesSaved;
+}
+
+void MeshCache::PrintStatistics() const
+{
+	std::cout << std::format("Mesh cache: {} hits, {} misses, {:.1f} MB of parsing saved",
+		GetHitCount(), GetMissCount(), GetBytesSaved() / (1024.0 * 1024.0)) << std::endl;
+}
+
+uint64_t MeshCache::HashFile(const std::string& filePath)
+{
+	MappedFile file(filePath);
+	const uint8_t* data = file.GetData();
+	const size_t size = file.GetSize();
+
+	// chunks are hashed in parallel and then combined in order, so the result doesn't depend on the thread count
+	const size_t chunkCount = (size + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE;
+	std::vector<uint64_t> chunkHashes(chunkCount);
+
+	ParallelFor(chunkCount, [&](size_t chunk)
+	{
+		size_t offset = chunk * HASH_CHUNK_SIZE;
+		chunkHashes[chunk] = HashChunk(data + offset, std::min(HASH_CHUNK_SIZE, size - offset), chunk);
+	});
+
+	uint64_t hash = MixHash(HASH_PRIME_1, size);
+	for (uint64_t chunkHash : chunkHashes)
+		hash = MixHash(hash, chunkHash);
+	return hash;
+}
+
+std::string MeshCache::GetEntryPath(uint64_t key) const
+{
+	return (directory / std::format("{:016x}{}", key, BinaryMesh::EXTENSION)).string();
+}
+
+void MeshCache::Store(const std::string& entryPath, const MeshData& mesh)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// written under a temporary name first so a crash never leaves a truncated entry behind
+	const std::string temporaryPath = entryPath + ".tmp";
+	mesh.WriteBinary(temporaryPath);
+	fs::rename(temporaryPath, entryPath);
+
+	Evict();
+}
+
+void MeshCache::Evict()
+{
+	struct Entry
+	{
+		fs::path path;
+		uint64_t size;
+		fs::file_time_type lastUse;
+	};
+
+	std::vector<Entry> entries;
+	uint64_t totalBytes = 0;
+
+	for (const auto& file : fs::directory_iterator(directory))
+	{
+		if (!file.is_regular_file() || file.path().extension() != BinaryMesh::EXTENSION)
+			continue;
+
+		entries.push_back({ file.path(), file.file_size(), file.last_write_time() });
+		totalBytes += entries.back().size;
+	}
+
+	if (totalBytes <= maxBytes)
+		return;
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+
+	// the newest entry always stays, even when it alone is over the limit
+	for (size_t i = 0; i + 1 < entries.size() && totalBytes > maxBytes; i++)
+	{
+		// a mapped entry can't be deleted on Windows; it is retried after the next store
+		std::error_code error;
+		if (fs::remove(entries[i].path, error))
+			totalBytes -= entries[i].size;
+	}
+}
\ No newline at end of file
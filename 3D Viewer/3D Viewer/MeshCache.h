@@ -0,0 +1,49 @@
+#pragma once
+
+#include "utils.h"
+#include "MeshData.h"
+
+#include <atomic>
+#include <mutex>
+
+// On-disk cache of preprocessed meshes.
+// Entries are keyed by a hash of the source file contents and the load options and are stored
+// as .bmesh files, so a warm start maps the final vertex and index buffers instead of parsing
+// and preprocessing the source again. The least recently used entries are deleted once the
+// cache directory grows past maxBytes.
+class MeshCache
+{
+public:
+	MeshCache(const std::string& directory, uint64_t maxBytes = DEFAULT_MAX_BYTES);
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	// same result as MeshData::Load(), served from the cache when possible; safe to call from several threads
+	MeshData Load(const std::string& filePath, const LoadOptions& options = LoadOptions());
+
+	uint64_t GetHitCount() const;
+	uint64_t GetMissCount() const;
+	uint64_t GetBytesSaved() const;
+	void PrintStatistics() const;
+
+	static uint64_t HashFile(const std::string& filePath);
+
+private:
+	std::string GetEntryPath(uint64_t key) const;
+	void Store(const std::string& entryPath, const MeshData& mesh);
+	void Evict();
+
+private:
+	std::filesystem::path directory;
+	uint64_t maxBytes;
+	std::mutex mutex;
+
+	std::atomic<uint64_t> hitCount = 0;
+	std::atomic<uint64_t> missCount = 0;
+	// size of the source files that didn't have to be parsed
+	std::atomic<uint64_t> bytesSaved = 0;
+
+public:
+	static const uint64_t DEFAULT_MAX_BYTES;
+	static const size_t HASH_CHUNK_SIZE;
+};
\ No newline at end of file
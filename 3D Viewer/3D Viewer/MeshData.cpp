@@ -0,0 +1,843 @@
+#include "MeshData.h"
+
+#include "MeshSimplifier.h"
+#include "TextModelReader.h"
+#include "ObjReader.h"
+#include "PlyReader.h"
+#include "Morton.h"
+#include "Parallel.h"
+#include "VertexAdjacency.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+
+const size_t MeshData::MIN_TRIANGLES_PER_RANGE = 1024;
+const float MeshData::WELD_ATTRIBUTE_TOLERANCE = 1e-3f;
+const size_t MeshData::OPTIMIZE_BLOCK_TRIANGLES = 1 << 18;
+const size_t MeshData::MIN_LOD_TRIANGLES = 4096;
+const size_t MeshData::QUANTIZE_BLOCK_VERTICES = 1 << 16;
+const size_t MeshData::CONVERTED_LOD_COUNT = 3;
+
+// welding grid cells are this many epsilons wide, so most vertices only need their own cell
+static const float WELD_CELL_SCALE = 16.0f;
+
+// the normal calculation only reads positions and reads / writes normals, so both vertex
+// layouts share it: VertexStreams has these accessors itself, interleaved vertices get this one
+struct InterleavedVertices
+{
+	std::vector<Vertex>& vertices;
+
+	glm::vec3 GetPosition(size_t vertex) const { return vertices[vertex].position; }
+	glm::vec3 GetNormal(size_t vertex) const { return vertices[vertex].normal; }
+	void SetNormal(size_t vertex, const glm::vec3& normal) { vertices[vertex].normal = normal; }
+};
+
+const Vertex* MeshData::GetVertexData() const
+{
+	if (binaryMesh)
+		return binaryMesh->GetVertices();
+	return HasStreams() ? nullptr : vertices.data();
+}
+
+size_t MeshData::GetVertexCount() const
+{
+	if (binaryMesh)
+		return binaryMesh->GetVertexCount();
+	return HasStreams() ? streams.GetCount() : vertices.size();
+}
+
+bool MeshData::HasStreams() const
+{
+	return streams.GetCount() > 0;
+}
+
+void MeshData::CopyVertices(Vertex* destination, size_t first, size_t count) const
+{
+	if (HasStreams())
+		streams.Interleave(destination, first, count);
+	else
+		std::memcpy(destination, GetVertexData() + first, count * sizeof(Vertex));
+}
+
+bool MeshData::IsQuantized() const
+{
+	return quantizer.has_value();
+}
+
+size_t MeshData::GetUploadVertexSize() const
+{
+	return quantizer ? sizeof(QuantizedVertex) : sizeof(Vertex);
+}
+
+void MeshData::CopyUploadVertices(void* destination, size_t first, size_t count) const
+{
+	if (!quantizer)
+	{
+		CopyVertices(static_cast<Vertex*>(destination), first, count);
+		return;
+	}
+
+	QuantizedVertex* quantized = static_cast<QuantizedVertex*>(destination);
+	if (!HasStreams())
+	{
+		quantizer->Quantize(GetVertexData() + first, quantized, count);
+		return;
+	}
+
+	std::vector<Vertex> block;
+	for (size_t begin = 0; begin < count; begin += QUANTIZE_BLOCK_VERTICES)
+	{
+		const size_t blockCount = std::min(QUANTIZE_BLOCK_VERTICES, count - begin);
+		block.resize(blockCount);
+		CopyVertices(block.data(), first + begin, blockCount);
+		quantizer->Quantize(block.data(), quantized + begin, blockCount);
+	}
+}
+
+const unsigned int* MeshData::GetIndexData() const
+{
+	return binaryMesh ? binaryMesh->GetIndices() : indices.data();
+}
+
+size_t MeshData::GetIndexCount() const
+{
+	return binaryMesh ? binaryMesh->GetIndexCount() : indices.size();
+}
+
+void MeshData::PackIndices()
+{
+	const unsigned int* source = GetIndexData();
+	const size_t indexCount = GetIndexCount();
+	const size_t maxSpan = std::numeric_limits<uint16_t>::max();
+
+	shortIndices.clear();
+	indexRanges.clear();
+
+	std::vector<IndexRange> ranges;
+	for (size_t level = 0; level < GetLodCount(); level++)
+	{
+		const MeshLod lod = GetLod(level);
+		const size_t levelEnd = lod.firstIndex + lod.indexCount;
+		size_t rangeBegin = lod.firstIndex;
+		unsigned int low = std::numeric_limits<unsigned int>::max(), high = 0;
+
+		for (size_t i = lod.firstIndex; i + 2 < levelEnd; i += 3)
+		{
+			unsigned int triangleLow = std::min({ source[i], source[i + 1], source[i + 2] });
+			unsigned int triangleHigh = std::max({ source[i], source[i + 1], source[i + 2] });
+
+			if (std::max(high, triangleHigh) - std::min(low, triangleLow) <= maxSpan)
+			{
+				low = std::min(low, triangleLow);
+				high = std::max(high, triangleHigh);
+				continue;
+			}
+
+			// a single triangle spanning more than 16 bits can't be packed at all
+			if (i == rangeBegin)
+			{
+				indexRanges.push_back({ 0, indexCount, 0 });
+				return;
+			}
+
+			ranges.push_back({ rangeBegin * sizeof(uint16_t), i - rangeBegin, low });
+			rangeBegin = i;
+			low = triangleLow;
+			high = triangleHigh;
+		}
+		if (rangeBegin < levelEnd)
+			ranges.push_back({ rangeBegin * sizeof(uint16_t), levelEnd - rangeBegin, low });
+	}
+
+	if (ranges.size() > 1 && ranges.size() > indexCount / (3 * MIN_TRIANGLES_PER_RANGE))
+	{
+		indexRanges.push_back({ 0, indexCount, 0 });
+		return;
+	}
+
+	shortIndices.resize(indexCount);
+	ParallelFor(ranges.size(), [&](size_t i)
+	{
+		const IndexRange& range = ranges[i];
+		const size_t first = range.byteOffset / sizeof(uint16_t);
+		for (size_t index = first; index < first + range.indexCount; index++)
+			shortIndices[index] = static_cast<uint16_t>(source[index] - range.baseVertex);
+	});
+
+	indexRanges = std::move(ranges);
+}
+
+const void* MeshData::GetPackedIndexData() const
+{
+	return shortIndices.empty() ? static_cast<const void*>(GetIndexData()) : shortIndices.data();
+}
+
+size_t MeshData::GetPackedIndexSize() const
+{
+	return shortIndices.empty() ? sizeof(unsigned int) : sizeof(uint16_t);
+}
+
+size_t MeshData::GetPackedIndexBytes() const
+{
+	return GetIndexCount() * GetPackedIndexSize();
+}
+
+std::vector<IndexRange> MeshData::GetIndexRanges(size_t level) const
+{
+	const MeshLod lod = GetLod(level);
+	if (shortIndices.empty())
+		return { { lod.firstIndex * sizeof(unsigned int), lod.indexCount, 0 } };
+
+	std::vector<IndexRange> ranges;
+	for (const IndexRange& range : indexRanges)
+	{
+		const size_t firstIndex = range.byteOffset / sizeof(uint16_t);
+		if (firstIndex >= lod.firstIndex && firstIndex < lod.firstIndex + lod.indexCount)
+			ranges.push_back(range);
+	}
+	return ranges;
+}
+
+size_t MeshData::GetLodCount() const
+{
+	return std::max<size_t>(1, lods.size());
+}
+
+MeshLod MeshData::GetLod(size_t level) const
+{
+	if (lods.empty())
+		return { 0, GetIndexCount(), 0.0f };
+	return lods[level];
+}
+
+const Meshlet* MeshData::GetMeshlets(size_t level, size_t& count) const
+{
+	const MeshLod lod = GetLod(level);
+	auto byFirstIndex = [](const Meshlet& meshlet, size_t index) { return meshlet.firstIndex < index; };
+	auto first = std::lower_bound(meshlets.begin(), meshlets.end(), lod.firstIndex, byFirstIndex);
+	auto last = std::lower_bound(first, meshlets.end(), lod.firstIndex + lod.indexCount, byFirstIndex);
+
+	count = static_cast<size_t>(last - first);
+	return meshlets.data() + (first - meshlets.begin());
+}
+
+void MeshData::BuildLods(size_t levelCount, float triangleRatio)
+{
+	if (binaryMesh || HasStreams() || !lods.empty())
+		throw std::runtime_error("Levels of detail can only be built once, before the mesh is mapped or split into streams");
+	if (levelCount == 0 || indices.size() / 3 < MIN_LOD_TRIANGLES)
+		return;
+
+	// every level continues simplifying the one before, so the errors only grow
+	MeshSimplifier simplifier(*this);
+	lods.push_back({ 0, indices.size(), 0.0f });
+
+	for (size_t level = 1; level <= levelCount; level++)
+	{
+		const size_t previousTriangleCount = lods.back().indexCount / 3;
+		simplifier.Simplify(static_cast<size_t>(previousTriangleCount * static_cast<double>(triangleRatio)));
+		if (simplifier.GetTriangleCount() == 0 || simplifier.GetTriangleCount() >= previousTriangleCount)
+			break;
+
+		const MeshData lod = simplifier.GetMesh();
+		const unsigned int firstVertex = static_cast<unsigned int>(vertices.size());
+		lods.push_back({ indices.size(), lod.indices.size(), static_cast<float>(simplifier.GetMaxError()) });
+
+		vertices.insert(vertices.end(), lod.vertices.begin(), lod.vertices.end());
+		for (unsigned int index : lod.indices)
+			indices.push_back(firstVertex + index);
+	}
+
+	if (lods.size() == 1)
+		lods.clear();
+}
+
+QuantizationError MeshData::Quantize()
+{
+	glm::vec3 min, max;
+	GetBounds(min, max);
+	quantizer = VertexQuantizer(min, max);
+
+	QuantizationError error = {};
+	std::vector<Vertex> block;
+	for (size_t begin = 0; begin < GetVertexCount(); begin += QUANTIZE_BLOCK_VERTICES)
+	{
+		const size_t blockCount = std::min(QUANTIZE_BLOCK_VERTICES, GetVertexCount() - begin);
+		const Vertex* source;
+		if (HasStreams())
+		{
+			block.resize(blockCount);
+			CopyVertices(block.data(), begin, blockCount);
+			source = block.data();
+		}
+		else
+		{
+			source = GetVertexData() + begin;
+		}
+
+		const QuantizationError blockError = quantizer->Measure(source, blockCount);
+		error.position = std::max(error.position, blockError.position);
+		error.normalDegrees = std::max(error.normalDegrees, blockError.normalDegrees);
+		error.color = std::max(error.color, blockError.color);
+	}
+
+	return error;
+}
+
+void MeshData::ToStreams()
+{
+	if (binaryMesh || HasStreams() || vertices.empty())
+		return;
+
+	streams = VertexStreams::FromVertices(vertices.data(), vertices.size());
+	vertices.clear();
+	vertices.shrink_to_fit();
+}
+
+void MeshData::GetBounds(glm::vec3& min, glm::vec3& max) const
+{
+	if (HasStreams())
+	{
+		streams.ComputeBounds(min, max);
+		return;
+	}
+
+	min = glm::vec3(std::numeric_limits<float>::max());
+	max = glm::vec3(std::numeric_limits<float>::lowest());
+
+	const Vertex* data = GetVertexData();
+	for (size_t i = 0; i < GetVertexCount(); i++)
+	{
+		min = glm::min(min, data[i].position);
+		max = glm::max(max, data[i].position);
+	}
+}
+
+size_t MeshData::WeldVertices(float epsilon)
+{
+	if (binaryMesh || HasStreams() || !lods.empty())
+		throw std::runtime_error("Vertices can only be welded before they are mapped, split into streams or given levels of detail");
+	if (vertices.empty() || epsilon <= 0.0f)
+		return 0;
+
+	const size_t vertexCount = vertices.size();
+	const size_t grainSize = 1 << 16;
+	const float cellSize = epsilon * WELD_CELL_SCALE;
+
+	auto getCell = [cellSize](const glm::vec3& position) { return glm::i64vec3(glm::floor(position / cellSize)); };
+	auto hashCell = [](const glm::i64vec3& cell)
+	{
+		uint64_t hash = static_cast<uint64_t>(cell.x) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(cell.y) * 0xC2B2AE3D27D4EB4Full ^ static_cast<uint64_t>(cell.z) * 0x165667B19E3779F9ull;
+		return hash ^ (hash >> 29);
+	};
+
+	// the spatial hash grid is the vertices sorted by cell; a cell is one contiguous run, ordered by vertex
+	struct CellEntry
+	{
+		uint64_t cell;
+		unsigned int vertex;
+
+		bool operator<(const CellEntry& other) const { return cell != other.cell ? cell < other.cell : vertex < other.vertex; }
+	};
+
+	std::vector<CellEntry> grid(vertexCount);
+	ParallelForRange(vertexCount, grainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			grid[i] = { hashCell(getCell(vertices[i].position)), static_cast<unsigned int>(i) };
+	});
+	ParallelSort(grid.begin(), grid.end());
+
+	// cells are found through a directory indexed by the top bits of their hash: directory[b] is the first
+	// slot whose hash starts with b or more, so a lookup is one directory read and a short scan
+	int directoryBits = 1;
+	while ((size_t(1) << directoryBits) < vertexCount && directoryBits < 32)
+		directoryBits++;
+	const int shift = 64 - directoryBits;
+	std::vector<unsigned int> directory((size_t(1) << directoryBits) + 1);
+
+	ParallelForRange(vertexCount, grainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t slot = begin; slot < end; slot++)
+		{
+			const size_t bucket = grid[slot].cell >> shift;
+			const size_t previous = slot == 0 ? 0 : (grid[slot - 1].cell >> shift) + 1;
+			for (size_t b = slot == 0 ? 0 : previous; b <= bucket; b++)
+				directory[b] = static_cast<unsigned int>(slot);
+		}
+	});
+	for (size_t b = (grid.back().cell >> shift) + 1; b < directory.size(); b++)
+		directory[b] = static_cast<unsigned int>(vertexCount);
+
+	// the first slot of the cell run each slot belongs to
+	std::vector<unsigned int> runStarts(vertexCount);
+	for (size_t slot = 0; slot < vertexCount; slot++)
+		runStarts[slot] = slot > 0 && grid[slot - 1].cell == grid[slot].cell ? runStarts[slot - 1] : static_cast<unsigned int>(slot);
+
+	auto matches = [&](const Vertex& a, const Vertex& b)
+	{
+		auto close = [](const glm::vec3& a, const glm::vec3& b, float tolerance) { return glm::all(glm::lessThanEqual(glm::abs(a - b), glm::vec3(tolerance))); };
+		return glm::dot(a.position - b.position, a.position - b.position) <= epsilon * epsilon
+			&& close(a.normal, b.normal, WELD_ATTRIBUTE_TOLERANCE) && close(a.color, b.color, WELD_ATTRIBUTE_TOLERANCE);
+	};
+
+	// every vertex points at the lowest numbered vertex it matches, itself when there is none
+	std::vector<unsigned int> remap(vertexCount);
+	ParallelForRange(vertexCount, grainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t slot = begin; slot < end; slot++)
+		{
+			const unsigned int vertex = grid[slot].vertex;
+			const Vertex& current = vertices[vertex];
+			unsigned int target = vertex;
+
+			// the lower numbered vertices of the own cell come right before it
+			for (size_t other = runStarts[slot]; other < slot; other++)
+			{
+				if (matches(current, vertices[grid[other].vertex]))
+				{
+					target = grid[other].vertex;
+					break;
+				}
+			}
+
+			// neighbouring cells only matter when the epsilon ball crosses into them
+			const glm::i64vec3 cell = getCell(current.position);
+			const glm::vec3 cellMin = glm::vec3(cell) * cellSize;
+			const glm::ivec3 low = glm::ivec3(glm::lessThan(current.position - epsilon, cellMin));
+			const glm::ivec3 high = glm::ivec3(glm::greaterThanEqual(current.position + epsilon, cellMin + cellSize));
+
+			for (int64_t x = -low.x; x <= high.x; x++)
+			{
+				for (int64_t y = -low.y; y <= high.y; y++)
+				{
+					for (int64_t z = -low.z; z <= high.z; z++)
+					{
+						if (x == 0 && y == 0 && z == 0)
+							continue;
+
+						const uint64_t neighbour = hashCell(cell + glm::i64vec3(x, y, z));
+						size_t entry = directory[neighbour >> shift];
+						while (entry < vertexCount && grid[entry].cell < neighbour)
+							entry++;
+
+						for (; entry < vertexCount && grid[entry].cell == neighbour && grid[entry].vertex < target; entry++)
+						{
+							if (matches(current, vertices[grid[entry].vertex]))
+							{
+								target = grid[entry].vertex;
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			remap[vertex] = target;
+		}
+	});
+
+	// targets are always lower, so one ascending pass collapses the chains
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+		remap[vertex] = remap[remap[vertex]];
+
+	// the kept vertices move down in order; blocks count first, then fill in parallel
+	const size_t blockCount = (vertexCount + grainSize - 1) / grainSize;
+	std::vector<size_t> blockOffsets(blockCount + 1, 0);
+	ParallelForRange(vertexCount, grainSize, [&](size_t begin, size_t end)
+	{
+		size_t kept = 0;
+		for (size_t vertex = begin; vertex < end; vertex++)
+			kept += remap[vertex] == vertex;
+		blockOffsets[begin / grainSize + 1] = kept;
+	});
+	for (size_t block = 0; block < blockCount; block++)
+		blockOffsets[block + 1] += blockOffsets[block];
+
+	const size_t keptCount = blockOffsets[blockCount];
+	if (keptCount == vertexCount)
+		return 0;
+
+	std::vector<unsigned int> newIndices(vertexCount);
+	std::vector<Vertex> welded(keptCount);
+	ParallelForRange(vertexCount, grainSize, [&](size_t begin, size_t end)
+	{
+		size_t next = blockOffsets[begin / grainSize];
+		for (size_t vertex = begin; vertex < end; vertex++)
+		{
+			if (remap[vertex] != vertex)
+				continue;
+
+			newIndices[vertex] = static_cast<unsigned int>(next);
+			welded[next++] = vertices[vertex];
+		}
+	});
+
+	ParallelForRange(indices.size(), grainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			indices[i] = newIndices[remap[indices[i]]];
+	});
+
+	vertices = std::move(welded);
+	shortIndices.clear();
+	indexRanges.clear();
+
+	return vertexCount - keptCount;
+}
+
+void MeshData::SortTrianglesSpatially(size_t firstIndex, size_t indexCount)
+{
+	const size_t triangleCount = indexCount / 3;
+	unsigned int* rangeIndices = indices.data() + firstIndex;
+
+	glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		min = glm::min(min, vertices[rangeIndices[i]].position);
+		max = glm::max(max, vertices[rangeIndices[i]].position);
+	}
+	const glm::vec3 extent = glm::max(max - min, glm::vec3(std::numeric_limits<float>::min()));
+
+	// the triangle number is packed in the low half of the sort key
+	std::vector<uint64_t> keys(triangleCount);
+	ParallelForRange(triangleCount, 1 << 16, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			glm::vec3 centroid = (vertices[rangeIndices[i * 3]].position + vertices[rangeIndices[i * 3 + 1]].position + vertices[rangeIndices[i * 3 + 2]].position) / 3.0f;
+			keys[i] = (static_cast<uint64_t>(MortonCode((centroid - min) / extent)) << 32) | i;
+		}
+	});
+	ParallelSort(keys.begin(), keys.end());
+
+	std::vector<unsigned int> sorted(triangleCount * 3);
+	ParallelForRange(triangleCount, 1 << 16, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const size_t triangle = static_cast<uint32_t>(keys[i]);
+			for (size_t corner = 0; corner < 3; corner++)
+				sorted[i * 3 + corner] = rangeIndices[triangle * 3 + corner];
+		}
+	});
+	std::copy(sorted.begin(), sorted.end(), rangeIndices);
+}
+
+void MeshData::OptimizeOrder(size_t cacheSize)
+{
+	if (binaryMesh || HasStreams() || !lods.empty())
+		throw std::runtime_error("Vertex order can only be optimized before it is mapped, split into streams or given levels of detail");
+
+	// triangles never move between materials, and big ranges are cut so the blocks run in parallel;
+	// those are put in Morton order of their centroids first, so every block is a compact patch
+	struct Block
+	{
+		size_t firstIndex;
+		size_t indexCount;
+	};
+
+	std::vector<Block> blocks;
+	auto addRange = [&](size_t firstIndex, size_t indexCount)
+	{
+		if (indexCount > OPTIMIZE_BLOCK_TRIANGLES * 3)
+			SortTrianglesSpatially(firstIndex, indexCount);
+
+		for (size_t offset = 0; offset < indexCount; offset += OPTIMIZE_BLOCK_TRIANGLES * 3)
+			blocks.push_back({ firstIndex + offset, std::min(OPTIMIZE_BLOCK_TRIANGLES * 3, indexCount - offset) });
+	};
+
+	if (materials.empty())
+		addRange(0, indices.size() / 3 * 3);
+	for (const MaterialRange& material : materials)
+		addRange(material.firstIndex, material.indexCount);
+
+	ParallelFor(blocks.size(), [&](size_t block)
+	{
+		unsigned int* blockIndices = indices.data() + blocks[block].firstIndex;
+		const size_t indexCount = blocks[block].indexCount;
+
+		// the optimizer works on the block's own vertices, numbered from 0
+		std::vector<unsigned int> usedVertices(blockIndices, blockIndices + indexCount);
+		std::sort(usedVertices.begin(), usedVertices.end());
+		usedVertices.erase(std::unique(usedVertices.begin(), usedVertices.end()), usedVertices.end());
+
+		std::vector<unsigned int> localIndices(indexCount);
+		for (size_t i = 0; i < indexCount; i++)
+			localIndices[i] = static_cast<unsigned int>(std::lower_bound(usedVertices.begin(), usedVertices.end(), blockIndices[i]) - usedVertices.begin());
+
+		std::vector<size_t> clusterStarts;
+		MeshOptimizer::OptimizeVertexCache(localIndices.data(), indexCount, usedVertices.size(), cacheSize, clusterStarts);
+
+		for (size_t i = 0; i < indexCount; i++)
+			blockIndices[i] = usedVertices[localIndices[i]];
+
+		MeshOptimizer::OptimizeOverdraw(blockIndices, indexCount, vertices.data(), clusterStarts);
+	});
+
+	const std::vector<unsigned int> remap = MeshOptimizer::OptimizeVertexFetch(indices.data(), indices.size(), vertices.size());
+
+	std::vector<Vertex> reordered(vertices.size());
+	ParallelForRange(vertices.size(), 1 << 16, [&](size_t begin, size_t end)
+	{
+		for (size_t vertex = begin; vertex < end; vertex++)
+			reordered[remap[vertex]] = vertices[vertex];
+	});
+
+	vertices = std::move(reordered);
+	shortIndices.clear();
+	indexRanges.clear();
+}
+
+void MeshData::CenterModel()
+{
+	if (HasStreams())
+	{
+		streams.Translate(-streams.ComputeCentroid());
+		return;
+	}
+
+	glm::vec3 center = glm::vec3(0.0f);
+	for (auto& vertex : vertices)
+		center += vertex.position;
+
+	center /= vertices.size();
+
+	for (auto& vertex : vertices)
+		vertex.position -= center;
+}
+
+// leaves the weighted sums in the normals; the callers normalize them in their own layout
+template<typename Vertices>
+static void CalculateNormals(Vertices& vertices, size_t vertexCount, const std::vector<unsigned int>& indices, NormalWeighting weighting)
+{
+	const size_t faceCount = indices.size() / 3;
+	const size_t grainSize = 1 << 14;
+
+	// the cross product of two edges is twice the face area long
+	std::vector<glm::vec3> faceNormals(faceCount);
+	std::vector<glm::vec3> cornerAngles(weighting == NormalWeighting::Angle ? faceCount : 0);
+
+	ParallelForRange(faceCount, grainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t face = begin; face < end; face++)
+		{
+			const glm::vec3 p0 = vertices.GetPosition(indices[face * 3]);
+			const glm::vec3 p1 = vertices.GetPosition(indices[face * 3 + 1]);
+			const glm::vec3 p2 = vertices.GetPosition(indices[face * 3 + 2]);
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			if (weighting != NormalWeighting::Area && glm::length(normal) > 0.0f)
+				normal = glm::normalize(normal);
+			faceNormals[face] = normal;
+
+			if (weighting == NormalWeighting::Angle)
+			{
+				auto angle = [](const glm::vec3& a, const glm::vec3& b)
+				{
+					float lengths = glm::length(a) * glm::length(b);
+					return lengths > 0.0f ? std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.0f, 1.0f)) : 0.0f;
+				};
+				cornerAngles[face] = glm::vec3(angle(p1 - p0, p2 - p0), angle(p2 - p1, p0 - p1), angle(p0 - p2, p1 - p2));
+			}
+		}
+	});
+
+	// building the adjacency only pays off when there are threads to gather with;
+	// the scatter adds in the same face order, so both give the same normals
+	if (GetWorkerCount() == 1)
+	{
+		for (size_t face = 0; face < faceCount; face++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				float weight = weighting == NormalWeighting::Angle ? cornerAngles[face][corner] : 1.0f;
+				unsigned int vertex = indices[face * 3 + corner];
+				vertices.SetNormal(vertex, vertices.GetNormal(vertex) + faceNormals[face] * weight);
+			}
+		}
+		return;
+	}
+
+	const VertexAdjacency adjacency = VertexAdjacency::Build(indices.data(), faceCount * 3, vertexCount);
+
+	// every vertex sums its own faces in face order, the same order the old sequential scatter used
+	ParallelForRange(vertexCount, grainSize, [&](size_t begin, size_t end)
+	{
+		for (size_t vertex = begin; vertex < end; vertex++)
+		{
+			glm::vec3 normal = vertices.GetNormal(vertex);
+
+			for (size_t slot = adjacency.offsets[vertex]; slot < adjacency.offsets[vertex + 1]; slot++)
+			{
+				unsigned int face = adjacency.faces[slot];
+				if (weighting != NormalWeighting::Angle)
+				{
+					normal += faceNormals[face];
+					continue;
+				}
+
+				for (int corner = 0; corner < 3; corner++)
+				{
+					if (indices[face * 3 + corner] == vertex)
+						normal += faceNormals[face] * cornerAngles[face][corner];
+				}
+			}
+
+			vertices.SetNormal(vertex, normal);
+		}
+	});
+}
+
+void MeshData::CalculateNormals(NormalWeighting weighting)
+{
+	if (HasStreams())
+	{
+		::CalculateNormals(streams, streams.GetCount(), indices, weighting);
+		streams.NormalizeNormals();
+		return;
+	}
+
+	InterleavedVertices interleaved = { vertices };
+	::CalculateNormals(interleaved, vertices.size(), indices, weighting);
+
+	ParallelForRange(vertices.size(), 1 << 14, [&](size_t begin, size_t end)
+	{
+		for (size_t vertex = begin; vertex < end; vertex++)
+		{
+			glm::vec3& normal = vertices[vertex].normal;
+			if (glm::length(normal) > 0.0f)
+				normal = glm::normalize(normal);
+		}
+	});
+}
+
+void MeshData::Preprocess(const LoadOptions& options, bool hasNormals)
+{
+	if (options.weldVertices)
+	{
+		const size_t vertexCount = vertices.size();
+		const size_t merged = WeldVertices(options.weldEpsilon);
+		if (merged > 0)
+			std::cout << std::format("Welded {} of {} vertices, {} left", merged, vertexCount, vertices.size()) << std::endl;
+	}
+
+	if (options.optimizeOrder)
+	{
+		const MeshOptimizer::CacheStatistics before = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+		OptimizeOrder();
+		const MeshOptimizer::CacheStatistics after = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+		std::cout << std::format("Vertex cache ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", before.acmr, after.acmr, before.atvr, after.atvr) << std::endl;
+	}
+	// before the levels of detail are appended, so the centroid is the one of the full mesh alone
+	if (options.centerModel)
+		CenterModel();
+	if (options.lodCount > 0)
+	{
+		BuildLods(options.lodCount, options.lodTriangleRatio);
+		for (size_t level = 1; level < lods.size(); level++)
+			std::cout << std::format("LOD {}: {} triangles, error {:.6f}", level, lods[level].indexCount / 3, lods[level].error) << std::endl;
+	}
+	if (options.vertexStreams)
+		ToStreams();
+	if (options.calculateNormals && !hasNormals)
+		CalculateNormals(options.normalWeighting);
+}
+
+MeshData MeshData::Load(const std::string& filePath, const LoadOptions& options)
+{
+	// binary meshes are stored already processed, so nothing is done to them here
+	if (BinaryMesh::HasBinaryExtension(filePath))
+		return LoadBinary(filePath);
+
+	MeshData mesh;
+	bool hasNormals = ReadSource(filePath, mesh);
+	mesh.Preprocess(options, hasNormals);
+
+	return mesh;
+}
+
+MeshData MeshData::LoadBinary(const std::string& filePath)
+{
+	MeshData mesh;
+	mesh.binaryMesh = std::make_shared<const BinaryMesh>(filePath);
+
+	const BinaryMeshLod* lods = mesh.binaryMesh->GetLods();
+	for (size_t level = 0; level < mesh.binaryMesh->GetLodCount(); level++)
+		mesh.lods.push_back({ static_cast<size_t>(lods[level].firstIndex), static_cast<size_t>(lods[level].indexCount), lods[level].error });
+
+	return mesh;
+}
+
+bool MeshData::ReadSource(const std::string& filePath, MeshData& mesh)
+{
+	std::string extension = std::filesystem::path(filePath).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+	if (extension == ".obj")
+	{
+		ObjReader reader(filePath);
+		reader.Read(mesh);
+		return reader.HasNormals();
+	}
+
+	if (extension == ".ply")
+	{
+		PlyReader reader(filePath);
+		reader.Read(mesh);
+		return reader.HasNormals();
+	}
+
+	TextModelReader::Read(filePath, mesh.vertices, mesh.indices);
+
+	if (mesh.indices.size() % 3 != 0)
+	{
+		throw std::runtime_error(std::format("The number of indices is not divisible by 3 in model file {}: {}", filePath, mesh.indices.size()).data());
+	}
+
+	return false;
+}
+
+void MeshData::ConvertToBinary(const std::string& sourcePath, const std::string& destinationPath)
+{
+	LoadOptions options;
+	options.lodCount = CONVERTED_LOD_COUNT;
+	Load(sourcePath, options).WriteBinary(destinationPath);
+}
+
+void MeshData::WriteBinary(const std::string& filePath) const
+{
+	std::vector<BinaryMeshLod> binaryLods;
+	for (const MeshLod& lod : lods)
+		binaryLods.push_back({ lod.firstIndex, lod.indexCount, lod.error, 0 });
+
+	if (!HasStreams())
+	{
+		BinaryMesh::Write(filePath, GetVertexData(), GetVertexCount(), GetIndexData(), GetIndexCount(), binaryLods.data(), binaryLods.size());
+		return;
+	}
+
+	std::vector<Vertex> interleaved(GetVertexCount());
+	CopyVertices(interleaved.data(), 0, interleaved.size());
+	BinaryMesh::Write(filePath, interleaved.data(), interleaved.size(), GetIndexData(), GetIndexCount(), binaryLods.data(), binaryLods.size());
+}
+
+uint64_t LoadOptions::GetHash() const
+{
+	uint32_t epsilonBits;
+	std::memcpy(&epsilonBits, &weldEpsilon, sizeof(epsilonBits));
+	uint32_t ratioBits;
+	std::memcpy(&ratioBits, &lodTriangleRatio, sizeof(ratioBits));
+
+	// bump the first value whenever the preprocessing itself changes
+	const uint64_t values[] = { 2, centerModel, calculateNormals, static_cast<uint64_t>(normalWeighting), vertexStreams, weldVertices, epsilonBits, optimizeOrder,
+		lodCount, ratioBits };
+
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (uint64_t value : values)
+		hash = (hash ^ value) * 0x100000001B3ull;
+	return hash;
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "utils.h"
+#include "Vertex.h"
+#include "BinaryMesh.h"
+#include "VertexStreams.h"
+#include "MeshOptimizer.h"
+#include "VertexQuantizer.h"
+
+#include <memory>
+#include <optional>
+
+// Bvh.h includes this header
+class Bvh;
+
+// A run of triangles drawn with one material; faces are grouped by material so each one is contiguous
+struct MaterialRange
+{
+	std::string name;
+	glm::vec3 diffuseColor;
+	size_t firstIndex;
+	size_t indexCount;
+};
+
+// A run of packed indices drawn with one glDrawElementsBaseVertex call
+struct IndexRange
+{
+	size_t byteOffset;
+	size_t indexCount;
+	size_t baseVertex;
+};
+
+// A level of detail: the triangles at indices [firstIndex, firstIndex + indexCount), which only use vertices of their own
+struct MeshLod
+{
+	size_t firstIndex;
+	size_t indexCount;
+	// how far, in model units, the level may stray from the full mesh
+	float error;
+};
+
+// A cluster of triangles that is culled as a whole: a contiguous run of the index buffer
+// with the bounds of its triangles
+struct Meshlet
+{
+	// the same position in the 32-bit and in the packed index buffer
+	size_t firstIndex;
+	size_t indexCount;
+	// of the packed index run the meshlet lies in
+	size_t baseVertex;
+
+	glm::vec3 center;
+	float radius;
+	glm::vec3 min;
+	glm::vec3 max;
+
+	// the triangles all face away from any viewer for which
+	// dot(normalize(coneApex - viewer), coneAxis) >= coneCutoff; a cutoff of 1 never culls
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+// How the faces around a vertex contribute to its normal
+enum class NormalWeighting
+{
+	Uniform,
+	Area,
+	Angle
+};
+
+// Preprocessing applied after a model file is read. Part of the mesh cache key,
+// so every field that changes the produced buffers must be folded into GetHash().
+struct LoadOptions
+{
+	bool centerModel = true;
+	// only used when the file doesn't provide normals
+	bool calculateNormals = true;
+	NormalWeighting normalWeighting = NormalWeighting::Area;
+	// merges vertices closer than weldEpsilon (in model units) whose normals and colors also match
+	bool weldVertices = true;
+	float weldEpsilon = 1e-6f;
+	// reorders triangles and vertices for the vertex cache, overdraw and vertex fetch
+	bool optimizeOrder = true;
+	// simplified levels of detail appended to the mesh, each with lodTriangleRatio of the triangles of the one before;
+	// off by default since simplifying dominates the load time of large meshes
+	size_t lodCount = 0;
+	float lodTriangleRatio = 0.25f;
+	// keeps the vertices as VertexStreams until they are uploaded
+	bool vertexStreams = false;
+	// uploads the vertices of models as QuantizedVertex; the mesh itself keeps full precision,
+	// so this is applied after loading and isn't part of the hash
+	bool quantizeVertices = false;
+	// splits models into meshlets that are culled every frame; built after loading like the above
+	bool buildMeshlets = false;
+	// builds a BVH over the full detail triangles of models, so they can be picked with rays
+	bool buildBvh = false;
+
+	uint64_t GetHash() const;
+};
+
+// The CPU side of a model: loading and preprocessing never touch OpenGL,
+// so they can run without a context (converter, worker threads).
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<MaterialRange> materials;
+
+	// set when the geometry is read straight from a mapped .bmesh file instead of the vectors above
+	std::shared_ptr<const BinaryMesh> binaryMesh;
+
+	// set by ToStreams(); the vertices vector is empty then and GetVertexData() returns nullptr,
+	// so uploads go through CopyVertices(), which interleaves
+	VertexStreams streams;
+
+	// filled by PackIndices(); while empty the 32-bit indices are drawn as they are
+	std::vector<uint16_t> shortIndices;
+	std::vector<IndexRange> indexRanges;
+
+	// filled by BuildLods(): level 0 is the full mesh and the coarser levels follow it in the same
+	// vertex and index arrays; while empty the whole mesh is the only level
+	std::vector<MeshLod> lods;
+
+	// set by Quantize(); only changes how the vertices are uploaded
+	std::optional<VertexQuantizer> quantizer;
+
+	// filled by MeshletBuilder, in index order; while empty the mesh is culled as a whole
+	std::vector<Meshlet> meshlets;
+
+	// over level 0 with wide nodes, for RayCaster; shared by copies, which keep the same triangles
+	std::shared_ptr<const Bvh> bvh;
+
+	const Vertex* GetVertexData() const;
+	size_t GetVertexCount() const;
+	bool HasStreams() const;
+	// copies count vertices, starting at vertex first, whatever the storage
+	void CopyVertices(Vertex* destination, size_t first, size_t count) const;
+	bool IsQuantized() const;
+	// sizeof(QuantizedVertex) once quantized, sizeof(Vertex) otherwise
+	size_t GetUploadVertexSize() const;
+	// copies count vertices, starting at vertex first, in the format they are uploaded in
+	void CopyUploadVertices(void* destination, size_t first, size_t count) const;
+	const unsigned int* GetIndexData() const;
+	size_t GetIndexCount() const;
+
+	// Switches to 16-bit indices when the triangles can be cut, in order, into runs that each
+	// reference at most 65536 vertices from their base vertex; otherwise keeps 32-bit indices.
+	// Runs never cross levels of detail.
+	void PackIndices();
+	// the index buffer as it is uploaded; its element size is GetPackedIndexSize() bytes
+	const void* GetPackedIndexData() const;
+	size_t GetPackedIndexSize() const;
+	size_t GetPackedIndexBytes() const;
+	// the runs that draw one level of detail
+	std::vector<IndexRange> GetIndexRanges(size_t level = 0) const;
+
+	size_t GetLodCount() const;
+	MeshLod GetLod(size_t level) const;
+	// the meshlets of one level of detail, count is 0 without meshlets
+	const Meshlet* GetMeshlets(size_t level, size_t& count) const;
+	// Appends up to levelCount levels simplified by MeshSimplifier, each with triangleRatio of the
+	// triangles of the one before; stops early once the surface can't be simplified any further.
+	// Needs interleaved vertices and goes after WeldVertices() and OptimizeOrder().
+	void BuildLods(size_t levelCount, float triangleRatio);
+
+	// Maps the vertices into the mesh bounds for QuantizedVertex uploads; returns the error measured
+	// over every vertex, for positions VertexQuantizer::GetPositionErrorBound() up to float rounding.
+	QuantizationError Quantize();
+
+	void ToStreams();
+	void GetBounds(glm::vec3& min, glm::vec3& max) const;
+
+	// Merges every vertex into the lowest numbered vertex within epsilon of it whose normal and color
+	// match too, remaps the indices in place and drops the merged vertices; returns how many were
+	// merged. Chains of close vertices collapse into one. Needs interleaved vertices.
+	size_t WeldVertices(float epsilon);
+
+	// Runs MeshOptimizer over every material range, in blocks of OPTIMIZE_BLOCK_TRIANGLES that are
+	// optimized in parallel, then renumbers the vertices by first use. Needs interleaved vertices.
+	void OptimizeOrder(size_t cacheSize = MeshOptimizer::DEFAULT_CACHE_SIZE);
+	// reorders the triangles of an index range along a Morton curve of their centroids
+	void SortTrianglesSpatially(size_t firstIndex, size_t indexCount);
+
+	void CenterModel();
+	// area weighting matches what the viewer always did
+	void CalculateNormals(NormalWeighting weighting = NormalWeighting::Area);
+
+	void Preprocess(const LoadOptions& options, bool hasNormals);
+
+	static MeshData Load(const std::string& filePath, const LoadOptions& options = LoadOptions());
+	static MeshData LoadBinary(const std::string& filePath);
+	// reads any supported source format without preprocessing; returns whether the file provided normals
+	static bool ReadSource(const std::string& filePath, MeshData& mesh);
+
+	static void ConvertToBinary(const std::string& sourcePath, const std::string& destinationPath);
+	void WriteBinary(const std::string& filePath) const;
+
+	// fewer triangles per run on average and the draw calls cost more than the saved bandwidth
+	static const size_t MIN_TRIANGLES_PER_RANGE;
+	// how far normals and colors of welded vertices may differ, per component
+	static const float WELD_ATTRIBUTE_TOLERANCE;
+	static const size_t OPTIMIZE_BLOCK_TRIANGLES;
+	// smaller meshes are cheap enough to always draw in full
+	static const size_t MIN_LOD_TRIANGLES;
+	// streams are interleaved in blocks this big before they are quantized
+	static const size_t QUANTIZE_BLOCK_VERTICES;
+	// converted files are simplified once and loaded many times, so they always carry levels of detail
+	static const size_t CONVERTED_LOD_COUNT;
+};
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "MeshOptimizer.h"
+
+#include "Parallel.h"
+#include "VertexAdjacency.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+const size_t MeshOptimizer::DEFAULT_CACHE_SIZE = 16;
+const size_t MeshOptimizer::DEFAULT_OVERDRAW_RESOLUTION = 256;
+
+static const unsigned int NO_VERTEX = std::numeric_limits<unsigned int>::max();
+
+// Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007.
+// Emits all triangles around a fanning vertex, then moves on to the candidate that will still be in the
+// cache after its remaining triangles are emitted; with none left it pops the dead-end stack.
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, size_t cacheSize, std::vector<size_t>& clusterStarts)
+{
+	const size_t faceCount = indexCount / 3;
+	const VertexAdjacency adjacency = VertexAdjacency::Build(indices, faceCount * 3, vertexCount);
+
+	std::vector<unsigned int> liveFaces(vertexCount);
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+		liveFaces[vertex] = static_cast<unsigned int>(adjacency.offsets[vertex + 1] - adjacency.offsets[vertex]);
+
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(faceCount, false);
+	std::vector<unsigned int> deadEnds, candidates, output;
+	output.reserve(faceCount * 3);
+
+	size_t time = cacheSize + 1;
+	size_t cursor = 0;
+
+	auto skipDeadEnd = [&]()
+	{
+		while (!deadEnds.empty())
+		{
+			unsigned int vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveFaces[vertex] > 0)
+				return vertex;
+		}
+
+		for (; cursor < vertexCount; cursor++)
+		{
+			if (liveFaces[cursor] > 0)
+				return static_cast<unsigned int>(cursor);
+		}
+		return NO_VERTEX;
+	};
+
+	clusterStarts.assign(1, 0);
+	unsigned int fanning = skipDeadEnd();
+
+	while (fanning != NO_VERTEX)
+	{
+		candidates.clear();
+
+		for (size_t slot = adjacency.offsets[fanning]; slot < adjacency.offsets[fanning + 1]; slot++)
+		{
+			const unsigned int face = adjacency.faces[slot];
+			if (emitted[face])
+				continue;
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int vertex = indices[face * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveFaces[vertex]--;
+
+				if (time - cacheTime[vertex] > cacheSize)
+					cacheTime[vertex] = time++;
+			}
+			emitted[face] = true;
+		}
+
+		unsigned int next = NO_VERTEX;
+		size_t bestPriority = 0;
+		for (unsigned int candidate : candidates)
+		{
+			if (liveFaces[candidate] == 0)
+				continue;
+
+			// a candidate that would fall out of the cache while its fan is emitted is left to the dead-end stack
+			size_t priority = time - cacheTime[candidate] + 2 * liveFaces[candidate] <= cacheSize ? time - cacheTime[candidate] : 0;
+			if (priority > bestPriority)
+			{
+				next = candidate;
+				bestPriority = priority;
+			}
+		}
+
+		if (next == NO_VERTEX)
+		{
+			next = skipDeadEnd();
+			if (next != NO_VERTEX)
+				clusterStarts.push_back(output.size());
+		}
+		fanning = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, const std::vector<size_t>& clusterStarts)
+{
+	const size_t clusterCount = clusterStarts.size();
+	if (clusterCount < 2)
+		return;
+
+	auto clusterEnd = [&](size_t cluster) { return cluster + 1 < clusterCount ? clusterStarts[cluster + 1] : indexCount; };
+
+	glm::dvec3 meshCenter(0.0);
+	for (size_t i = 0; i < indexCount; i++)
+		meshCenter += glm::dvec3(vertices[indices[i]].position);
+	meshCenter /= static_cast<double>(std::max<size_t>(indexCount, 1));
+
+	// how far out the cluster lies along its own normal; the outermost ones occlude the most
+	std::vector<float> keys(clusterCount);
+	ParallelFor(clusterCount, [&](size_t cluster)
+	{
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+
+		for (size_t i = clusterStarts[cluster]; i + 3 <= clusterEnd(cluster); i += 3)
+		{
+			const glm::vec3& p0 = vertices[indices[i]].position;
+			const glm::vec3& p1 = vertices[indices[i + 1]].position;
+			const glm::vec3& p2 = vertices[indices[i + 2]].position;
+
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float faceArea = glm::length(cross);
+			centroid += (p0 + p1 + p2) / 3.0f * faceArea;
+			normal += cross;
+			area += faceArea;
+		}
+
+		if (area <= 0.0f || glm::length(normal) <= 0.0f)
+		{
+			keys[cluster] = 0.0f;
+			return;
+		}
+		keys[cluster] = glm::dot(centroid / area - glm::vec3(meshCenter), glm::normalize(normal));
+	});
+
+	std::vector<size_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(indexCount);
+	for (size_t cluster : order)
+		sorted.insert(sorted.end(), indices + clusterStarts[cluster], indices + clusterEnd(cluster));
+	std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+std::vector<unsigned int> MeshOptimizer::OptimizeVertexFetch(unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	std::vector<unsigned int> remap(vertexCount, NO_VERTEX);
+	unsigned int next = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (remap[indices[i]] == NO_VERTEX)
+			remap[indices[i]] = next++;
+		indices[i] = remap[indices[i]];
+	}
+
+	for (unsigned int& slot : remap)
+	{
+		if (slot == NO_VERTEX)
+			slot = next++;
+	}
+
+	return remap;
+}
+
+MeshOptimizer::CacheStatistics MeshOptimizer::AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+{
+	// a vertex is still in the FIFO while fewer than cacheSize misses happened since it was loaded
+	std::vector<size_t> loadedAt(vertexCount, std::numeric_limits<size_t>::max());
+	size_t misses = 0, usedVertices = 0;
+
+	for (size_t i = 0; i < indexCount / 3 * 3; i++)
+	{
+		size_t& loaded = loadedAt[indices[i]];
+		if (loaded != std::numeric_limits<size_t>::max() && misses - loaded < cacheSize)
+			continue;
+
+		usedVertices += loaded == std::numeric_limits<size_t>::max();
+		loaded = misses++;
+	}
+
+	CacheStatistics statistics;
+	statistics.acmr = indexCount >= 3 ? static_cast<double>(misses) / (indexCount / 3) : 0.0;
+	statistics.atvr = usedVertices > 0 ? static_cast<double>(misses) / usedVertices : 0.0;
+	return statistics;
+}
+
+double MeshOptimizer::AnalyzeOverdraw(const Vertex* vertices, const unsigned int* indices, size_t indexCount, size_t resolution)
+{
+	struct View
+	{
+		glm::vec3 forward, up;
+	};
+	const View views[] = {
+		{ { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } }, { { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } }, { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }, { { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+	};
+	const size_t viewCount = sizeof(views) / sizeof(views[0]);
+
+	glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		min = glm::min(min, vertices[indices[i]].position);
+		max = glm::max(max, vertices[indices[i]].position);
+	}
+	const glm::vec3 center = (min + max) * 0.5f;
+	const float scale = (resolution - 1) / std::max(glm::length(max - min), std::numeric_limits<float>::min());
+
+	std::vector<size_t> shaded(viewCount, 0), covered(viewCount, 0);
+	ParallelFor(viewCount, [&](size_t view)
+	{
+		// orthographic, looking along forward; counterclockwise on screen is front facing, as in the viewer
+		const glm::vec3 right = glm::cross(views[view].forward, views[view].up);
+		auto project = [&](const glm::vec3& position)
+		{
+			glm::vec3 offset = position - center;
+			return glm::vec3(glm::dot(offset, right) * scale + resolution * 0.5f, glm::dot(offset, views[view].up) * scale + resolution * 0.5f, glm::dot(offset, views[view].forward));
+		};
+
+		std::vector<float> depth(resolution * resolution, std::numeric_limits<float>::max());
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			const glm::vec3 a = project(vertices[indices[i]].position);
+			const glm::vec3 b = project(vertices[indices[i + 1]].position);
+			const glm::vec3 c = project(vertices[indices[i + 2]].position);
+
+			const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			if (area <= 0.0f)
+				continue;
+
+			const int minX = std::max(0, static_cast<int>(std::floor(std::min({ a.x, b.x, c.x }))));
+			const int minY = std::max(0, static_cast<int>(std::floor(std::min({ a.y, b.y, c.y }))));
+			const int maxX = std::min(static_cast<int>(resolution) - 1, static_cast<int>(std::ceil(std::max({ a.x, b.x, c.x }))));
+			const int maxY = std::min(static_cast<int>(resolution) - 1, static_cast<int>(std::ceil(std::max({ a.y, b.y, c.y }))));
+
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int x = minX; x <= maxX; x++)
+				{
+					const float px = x + 0.5f, py = y + 0.5f;
+					const float w0 = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+					const float w1 = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+					const float w2 = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+						continue;
+
+					const float z = (w0 * a.z + w1 * b.z + w2 * c.z) / area;
+					float& stored = depth[y * resolution + x];
+					if (z < stored)
+					{
+						stored = z;
+						shaded[view]++;
+					}
+				}
+			}
+		}
+
+		for (float value : depth)
+			covered[view] += value != std::numeric_limits<float>::max();
+	});
+
+	const size_t totalCovered = std::accumulate(covered.begin(), covered.end(), size_t(0));
+	return totalCovered > 0 ? static_cast<double>(std::accumulate(shaded.begin(), shaded.end(), size_t(0))) / totalCovered : 0.0;
+}
\ No newline at end of file
@@ -0,0 +1,617 @@
+#include "MeshSimplifier.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <limits>
+
+const double MeshSimplifier::BOUNDARY_WEIGHT = 10.0;
+const float MeshSimplifier::MIN_NORMAL_COSINE = 0.2f;
+const float MeshSimplifier::ROUND_COST_QUANTILE = 0.5f;
+
+static const size_t GRAIN_SIZE = 1 << 12;
+static const unsigned int NO_VERTEX = std::numeric_limits<unsigned int>::max();
+
+MeshSimplifier::Quadric MeshSimplifier::Quadric::FromPlane(const glm::dvec3& normal, double distance, double weight)
+{
+	const double a = normal.x, b = normal.y, c = normal.z, d = distance;
+	return {
+		weight * a * a, weight * a * b, weight * a * c, weight * a * d,
+		weight * b * b, weight * b * c, weight * b * d,
+		weight * c * c, weight * c * d,
+		weight * d * d,
+		weight
+	};
+}
+
+MeshSimplifier::Quadric& MeshSimplifier::Quadric::operator+=(const Quadric& other)
+{
+	xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+	yy += other.yy; yz += other.yz; yw += other.yw;
+	zz += other.zz; zw += other.zw;
+	ww += other.ww;
+	weight += other.weight;
+	return *this;
+}
+
+double MeshSimplifier::Quadric::Evaluate(const glm::dvec3& p) const
+{
+	return xx * p.x * p.x + 2.0 * xy * p.x * p.y + 2.0 * xz * p.x * p.z + 2.0 * xw * p.x
+		+ yy * p.y * p.y + 2.0 * yz * p.y * p.z + 2.0 * yw * p.y
+		+ zz * p.z * p.z + 2.0 * zw * p.z
+		+ ww;
+}
+
+// solves the gradient for zero by Cramer's rule; fails when the planes don't pin a single point
+bool MeshSimplifier::Quadric::FindMinimum(glm::dvec3& position) const
+{
+	const double det = xx * (yy * zz - yz * yz) - xy * (xy * zz - yz * xz) + xz * (xy * yz - yy * xz);
+	const double trace = xx + yy + zz;
+	if (std::abs(det) <= 1e-9 * trace * trace * trace)
+		return false;
+
+	const double detX = -xw * (yy * zz - yz * yz) + xy * (yw * zz - yz * zw) - xz * (yw * yz - yy * zw);
+	const double detY = -xx * (yw * zz - zw * yz) + xw * (xy * zz - yz * xz) - xz * (xy * zw - yw * xz);
+	const double detZ = -xx * (yy * zw - yz * yw) + xy * (xy * zw - yw * xz) - xw * (xy * yz - yy * xz);
+	position = glm::dvec3(detX, detY, detZ) / det;
+	return true;
+}
+
+// collapses are ordered by cost, then by a vertex; a non negative float orders like its bits
+static uint64_t MakeKey(float cost, unsigned int vertex)
+{
+	return static_cast<uint64_t>(std::bit_cast<uint32_t>(cost)) << 32 | vertex;
+}
+
+MeshSimplifier::MeshSimplifier(const MeshData& mesh)
+	: vertices(mesh.GetVertexCount()), indices(mesh.GetIndexData(), mesh.GetIndexData() + mesh.GetIndexCount() / 3 * 3),
+	materials(mesh.materials), triangleCount(0), maxError(0.0)
+{
+	mesh.CopyVertices(vertices.data(), 0, vertices.size());
+	InitFaceLists();
+	InitQuadrics();
+
+	// every vertex starts out dirty, so the first round finds all of these
+	cheapestCollapses.resize(vertices.size());
+	dirtyVertices.assign(vertices.size(), true);
+}
+
+void MeshSimplifier::Simplify(size_t targetTriangleCount)
+{
+	while (GetTriangleCount() > targetTriangleCount && SimplifyRound(targetTriangleCount))
+		;
+}
+
+size_t MeshSimplifier::GetTriangleCount() const
+{
+	return triangleCount;
+}
+
+double MeshSimplifier::GetMaxError() const
+{
+	return maxError;
+}
+
+static bool IsCollapsed(const unsigned int* corners)
+{
+	return corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0];
+}
+
+MeshData MeshSimplifier::GetMesh() const
+{
+	MeshData mesh;
+	mesh.indices.reserve(triangleCount * 3);
+	auto copyFaces = [&](size_t firstIndex, size_t indexCount)
+	{
+		for (size_t i = firstIndex; i < firstIndex + indexCount; i += 3)
+		{
+			if (!IsCollapsed(&indices[i]))
+				mesh.indices.insert(mesh.indices.end(), &indices[i], &indices[i] + 3);
+		}
+	};
+
+	if (materials.empty())
+		copyFaces(0, indices.size());
+
+	for (const MaterialRange& material : materials)
+	{
+		MaterialRange& range = mesh.materials.emplace_back(material);
+		range.firstIndex = mesh.indices.size();
+		copyFaces(material.firstIndex, material.indexCount);
+		range.indexCount = mesh.indices.size() - range.firstIndex;
+	}
+
+	std::vector<unsigned int> remap(vertices.size(), NO_VERTEX);
+	for (unsigned int index : mesh.indices)
+		remap[index] = 0;
+
+	for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+	{
+		if (remap[vertex] == NO_VERTEX)
+			continue;
+		remap[vertex] = static_cast<unsigned int>(mesh.vertices.size());
+		mesh.vertices.push_back(vertices[vertex]);
+	}
+
+	ParallelForRange(mesh.indices.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			mesh.indices[i] = remap[mesh.indices[i]];
+	});
+
+	return mesh;
+}
+
+std::vector<MeshData> MeshSimplifier::BuildLodChain(const MeshData& mesh, const std::vector<float>& triangleRatios)
+{
+	MeshSimplifier simplifier(mesh);
+	const size_t triangleCount = simplifier.GetTriangleCount();
+
+	std::vector<MeshData> lods;
+	float previousRatio = 1.0f;
+	for (float ratio : triangleRatios)
+	{
+		if (!(ratio > 0.0f && ratio <= previousRatio))
+			throw std::runtime_error(std::format("LOD triangle ratios must be decreasing and in (0, 1], got {}", ratio).data());
+		previousRatio = ratio;
+
+		simplifier.Simplify(static_cast<size_t>(triangleCount * static_cast<double>(ratio)));
+		lods.push_back(simplifier.GetMesh());
+	}
+
+	return lods;
+}
+
+// the lists start out as the vertex adjacency, without the faces that are already degenerate
+void MeshSimplifier::InitFaceLists()
+{
+	VertexAdjacency adjacency = VertexAdjacency::Build(indices.data(), indices.size(), vertices.size());
+	faceLists = std::move(adjacency.faces);
+	faceListOffsets = std::move(adjacency.offsets);
+	faceListOffsets.pop_back();
+	faceListCounts.resize(vertices.size());
+	faceListCapacities.resize(vertices.size());
+
+	ParallelForRange(vertices.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t vertex = begin; vertex < end; vertex++)
+		{
+			const size_t first = faceListOffsets[vertex];
+			const size_t last = vertex + 1 < vertices.size() ? faceListOffsets[vertex + 1] : faceLists.size();
+			faceListCapacities[vertex] = static_cast<unsigned int>(last - first);
+			faceListCounts[vertex] = static_cast<unsigned int>(std::remove_if(faceLists.begin() + first, faceLists.begin() + last,
+				[&](unsigned int face) { return IsCollapsed(&indices[face * 3]); }) - (faceLists.begin() + first));
+		}
+	});
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+		triangleCount += !IsCollapsed(&indices[i]);
+}
+
+// Every vertex sums the area weighted planes of its faces. Its edges used by one face only lie on
+// the boundary and add a plane through the edge, perpendicular to the face, so borders stay put.
+void MeshSimplifier::InitQuadrics()
+{
+	quadrics.resize(vertices.size());
+	boundaryVertices.resize(vertices.size());
+
+	ParallelForRange(vertices.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		// the other end of every edge around the vertex and the face it was seen in
+		std::vector<std::pair<unsigned int, unsigned int>> edges;
+
+		for (size_t vertex = begin; vertex < end; vertex++)
+		{
+			Quadric quadric = {};
+			edges.clear();
+
+			const unsigned int* faces = &faceLists[faceListOffsets[vertex]];
+			for (const unsigned int* slot = faces; slot != faces + faceListCounts[vertex]; slot++)
+			{
+				const unsigned int face = *slot;
+				const unsigned int* corners = &indices[face * 3];
+				const glm::dvec3 p0 = vertices[corners[0]].position, p1 = vertices[corners[1]].position, p2 = vertices[corners[2]].position;
+
+				const glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+				const double doubleArea = glm::length(normal);
+				if (doubleArea > 0.0)
+					quadric += Quadric::FromPlane(normal / doubleArea, -glm::dot(normal / doubleArea, p0), doubleArea * 0.5);
+
+				for (int corner = 0; corner < 3; corner++)
+				{
+					if (corners[corner] != vertex)
+						edges.push_back({ corners[corner], face });
+				}
+			}
+
+			std::sort(edges.begin(), edges.end());
+			bool boundary = false;
+			for (size_t first = 0, last; first < edges.size(); first = last)
+			{
+				for (last = first + 1; last < edges.size() && edges[last].first == edges[first].first; last++)
+					;
+				if (last - first == 2)
+					continue;
+
+				boundary = true;
+				if (last - first > 2)
+					continue;
+
+				const unsigned int* corners = &indices[edges[first].second * 3];
+				const glm::dvec3 p0 = vertices[corners[0]].position, p1 = vertices[corners[1]].position, p2 = vertices[corners[2]].position;
+				const glm::dvec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+				const glm::dvec3 origin = vertices[vertex].position;
+				const glm::dvec3 edge = glm::dvec3(vertices[edges[first].first].position) - origin;
+
+				const glm::dvec3 normal = glm::cross(edge, faceNormal);
+				const double length = glm::length(normal);
+				if (length > 0.0)
+					quadric += Quadric::FromPlane(normal / length, -glm::dot(normal / length, origin), BOUNDARY_WEIGHT * glm::dot(edge, edge));
+			}
+
+			quadrics[vertex] = quadric;
+			boundaryVertices[vertex] = boundary;
+		}
+	});
+}
+
+// Looks again for the cheapest collapse of the dirty vertices, then walks the candidates from the
+// cheapest and takes every collapse whose ends lie outside the rings of those already taken. Two such
+// collapses can't touch the same triangle, so the batch is applied in parallel. Only collapses below
+// the round's cost quantile are considered, so the cheap ones across the mesh go first.
+bool MeshSimplifier::SimplifyRound(size_t targetTriangleCount)
+{
+	const size_t vertexCount = vertices.size();
+
+	std::vector<unsigned int> dirty;
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		if (dirtyVertices[vertex])
+			dirty.push_back(static_cast<unsigned int>(vertex));
+	}
+
+	ParallelForRange(dirty.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		Scratch scratch;
+		for (size_t i = begin; i < end; i++)
+		{
+			cheapestCollapses[dirty[i]] = FindCheapestCollapse(dirty[i], scratch);
+			dirtyVertices[dirty[i]] = false;
+		}
+	});
+
+	// every collapse once, from whichever end has it as its cheapest, ordered by cost
+	std::vector<uint64_t> candidates;
+	for (size_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		const Collapse& collapse = cheapestCollapses[vertex];
+		if (collapse.cost == std::numeric_limits<float>::infinity())
+			continue;
+		if (vertex == collapse.removed && cheapestCollapses[collapse.kept].removed == vertex)
+			continue;
+		candidates.push_back(MakeKey(collapse.cost, static_cast<unsigned int>(vertex)));
+	}
+
+	if (candidates.empty())
+		return false;
+
+	ParallelSort(candidates.begin(), candidates.end());
+	const size_t consideredCount = std::max<size_t>(1, static_cast<size_t>(candidates.size() * static_cast<double>(ROUND_COST_QUANTILE)));
+
+	// the ring of every collapse taken is locked; those are also the vertices whose faces change
+	std::vector<uint8_t> locked(vertexCount, false);
+	std::vector<unsigned int> changed;
+	std::vector<Collapse> batch;
+	std::vector<size_t> listOffsets;
+	size_t listsEnd = faceLists.size();
+	size_t remainingTriangles = triangleCount;
+
+	auto lockRing = [&](unsigned int vertex)
+	{
+		const unsigned int* faces = &faceLists[faceListOffsets[vertex]];
+		for (const unsigned int* face = faces; face != faces + faceListCounts[vertex]; face++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const unsigned int neighbour = indices[*face * 3 + corner];
+				if (!locked[neighbour])
+				{
+					locked[neighbour] = true;
+					changed.push_back(neighbour);
+				}
+			}
+		}
+	};
+
+	for (size_t i = 0; i < consideredCount && remainingTriangles > targetTriangleCount; i++)
+	{
+		const Collapse& collapse = cheapestCollapses[static_cast<uint32_t>(candidates[i])];
+		if (locked[collapse.kept] || locked[collapse.removed])
+			continue;
+
+		// the merged list stays where the kept one is when it fits, and goes to the end otherwise
+		const unsigned int mergedCount = faceListCounts[collapse.kept] + faceListCounts[collapse.removed] - 2 * collapse.sharedFaces;
+		if (mergedCount <= faceListCapacities[collapse.kept])
+			listOffsets.push_back(faceListOffsets[collapse.kept]);
+		else
+		{
+			listOffsets.push_back(listsEnd);
+			listsEnd += mergedCount;
+		}
+
+		batch.push_back(collapse);
+		remainingTriangles -= std::min<size_t>(remainingTriangles, collapse.sharedFaces);
+		lockRing(collapse.kept);
+		lockRing(collapse.removed);
+	}
+
+	if (batch.empty())
+		return false;
+
+	faceLists.resize(listsEnd);
+	ParallelForRange(batch.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		std::vector<unsigned int> merged;
+		for (size_t i = begin; i < end; i++)
+			ApplyCollapse(batch[i], listOffsets[i], merged);
+	});
+
+	// the faces that collapsed are still in the lists of their third vertex, which is in a ring
+	ParallelForRange(changed.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			unsigned int* faces = &faceLists[faceListOffsets[changed[i]]];
+			faceListCounts[changed[i]] = static_cast<unsigned int>(std::remove_if(faces, faces + faceListCounts[changed[i]],
+				[&](unsigned int face) { return IsCollapsed(&indices[face * 3]); }) - faces);
+		}
+	});
+
+	for (const Collapse& collapse : batch)
+	{
+		triangleCount -= std::min<size_t>(triangleCount, collapse.sharedFaces);
+		const double weight = quadrics[collapse.kept].weight;
+		if (weight > 0.0)
+			maxError = std::max(maxError, std::sqrt(collapse.cost / weight));
+	}
+
+	// the vertices whose ring changed look for their cheapest collapse again, which covers every edge
+	// that changed, and so do those whose cheapest collapse was one of those edges
+	ParallelForRange(vertexCount, GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t vertex = begin; vertex < end; vertex++)
+		{
+			const Collapse& collapse = cheapestCollapses[vertex];
+			dirtyVertices[vertex] = locked[vertex] || (collapse.kept != NO_VERTEX && (locked[collapse.kept] || locked[collapse.removed]));
+		}
+	});
+
+	if (faceLists.size() > 2 * triangleCount * 3)
+		CompactFaceLists();
+
+	return true;
+}
+
+MeshSimplifier::Collapse MeshSimplifier::FindCheapestCollapse(unsigned int vertex, Scratch& scratch) const
+{
+	scratch.neighbours.clear();
+	AppendNeighbours(vertex, NO_VERTEX, scratch.neighbours);
+
+	// evaluated from the lower end either way, so both ends agree on the edge
+	scratch.collapses.clear();
+	for (unsigned int neighbour : scratch.neighbours)
+		scratch.collapses.push_back(EvaluateCollapse(std::min(vertex, neighbour), std::max(vertex, neighbour)));
+
+	// the costs are cheap and the checks are not, so the edges are checked from the cheapest until one passes
+	auto getKey = [vertex](const Collapse& collapse) { return MakeKey(collapse.cost, collapse.kept == vertex ? collapse.removed : collapse.kept); };
+	std::sort(scratch.collapses.begin(), scratch.collapses.end(), [&](const Collapse& a, const Collapse& b) { return getKey(a) < getKey(b); });
+	for (Collapse& collapse : scratch.collapses)
+	{
+		if (CheckCollapse(collapse, vertex, scratch.neighbours, scratch.ring))
+			return collapse;
+	}
+
+	return { std::numeric_limits<float>::infinity(), NO_VERTEX, NO_VERTEX, 0, glm::vec3(0.0f) };
+}
+
+size_t MeshSimplifier::AppendNeighbours(unsigned int vertex, unsigned int excluded, std::vector<unsigned int>& neighbours) const
+{
+	const size_t first = neighbours.size();
+	const unsigned int* faces = &faceLists[faceListOffsets[vertex]];
+	for (const unsigned int* face = faces; face != faces + faceListCounts[vertex]; face++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const unsigned int neighbour = indices[*face * 3 + corner];
+			if (neighbour != vertex && neighbour != excluded)
+				neighbours.push_back(neighbour);
+		}
+	}
+
+	std::sort(neighbours.begin() + first, neighbours.end());
+	neighbours.erase(std::unique(neighbours.begin() + first, neighbours.end()), neighbours.end());
+	return neighbours.size() - first;
+}
+
+// the position that costs the least along the quadrics of both ends; a vertex on the boundary
+// pulls the other one onto itself
+MeshSimplifier::Collapse MeshSimplifier::EvaluateCollapse(unsigned int kept, unsigned int removed) const
+{
+	Quadric quadric = quadrics[kept];
+	quadric += quadrics[removed];
+
+	const glm::dvec3 keptPosition = vertices[kept].position;
+	const glm::dvec3 removedPosition = vertices[removed].position;
+	const glm::dvec3 midpoint = (keptPosition + removedPosition) * 0.5;
+
+	glm::dvec3 position;
+	if (boundaryVertices[kept] != boundaryVertices[removed])
+		position = boundaryVertices[kept] ? keptPosition : removedPosition;
+	else if (!quadric.FindMinimum(position) || glm::distance(position, midpoint) > glm::distance(keptPosition, removedPosition))
+	{
+		position = midpoint;
+		for (const glm::dvec3& candidate : { keptPosition, removedPosition })
+		{
+			if (quadric.Evaluate(candidate) < quadric.Evaluate(position))
+				position = candidate;
+		}
+	}
+
+	return { static_cast<float>(std::max(0.0, quadric.Evaluate(position))), kept, removed, 0, position };
+}
+
+// Fails for edges that would pinch the surface (the ends share more neighbours than faces),
+// fold a triangle over, close a hole by joining two boundary vertices through the inside,
+// or that have more than two faces.
+bool MeshSimplifier::CheckCollapse(Collapse& collapse, unsigned int end, const std::vector<unsigned int>& endNeighbours, std::vector<unsigned int>& ring) const
+{
+	const unsigned int kept = collapse.kept, removed = collapse.removed;
+	const unsigned int* keptFaces = &faceLists[faceListOffsets[kept]];
+	const unsigned int* keptFacesEnd = keptFaces + faceListCounts[kept];
+	const unsigned int* removedFaces = &faceLists[faceListOffsets[removed]];
+	const unsigned int* removedFacesEnd = removedFaces + faceListCounts[removed];
+
+	unsigned int sharedFaces = 0;
+	for (const unsigned int *a = keptFaces, *b = removedFaces; a != keptFacesEnd && b != removedFacesEnd;)
+	{
+		if (*a == *b)
+		{
+			sharedFaces++;
+			a++;
+			b++;
+		}
+		else if (*a < *b)
+			a++;
+		else
+			b++;
+	}
+
+	if (sharedFaces == 0 || sharedFaces > 2)
+		return false;
+	if (boundaryVertices[kept] && boundaryVertices[removed] && sharedFaces != 1)
+		return false;
+
+	// the ring of the other end leaves out the given one, so the edge itself isn't counted
+	ring.clear();
+	AppendNeighbours(end == kept ? removed : kept, end, ring);
+
+	unsigned int sharedNeighbours = 0;
+	for (const unsigned int *a = endNeighbours.data(), *b = ring.data(); a != endNeighbours.data() + endNeighbours.size() && b != ring.data() + ring.size();)
+	{
+		if (*a == *b)
+		{
+			sharedNeighbours++;
+			a++;
+			b++;
+		}
+		else if (*a < *b)
+			a++;
+		else
+			b++;
+	}
+
+	if (sharedNeighbours != sharedFaces)
+		return false;
+
+	const glm::dvec3 position = collapse.position;
+	for (const unsigned int* faces : { keptFaces, removedFaces })
+	{
+		const unsigned int* facesEnd = faces == keptFaces ? keptFacesEnd : removedFacesEnd;
+		for (const unsigned int* face = faces; face != facesEnd; face++)
+		{
+			const unsigned int* corners = &indices[*face * 3];
+			if ((corners[0] == kept || corners[1] == kept || corners[2] == kept) && (corners[0] == removed || corners[1] == removed || corners[2] == removed))
+				continue;
+
+			glm::dvec3 before[3], after[3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				before[corner] = vertices[corners[corner]].position;
+				after[corner] = corners[corner] == kept || corners[corner] == removed ? position : before[corner];
+			}
+
+			const glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			const glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+			const double lengths = glm::length(normalBefore) * glm::length(normalAfter);
+			if (glm::dot(normalBefore, normalBefore) > 0.0 && glm::dot(normalBefore, normalAfter) <= MIN_NORMAL_COSINE * lengths)
+				return false;
+		}
+	}
+
+	collapse.sharedFaces = sharedFaces;
+	return true;
+}
+
+// Colors and normals are taken where the new position projects onto the old edge. The faces of the
+// removed vertex are handed to the kept one; the shared ones are left with the kept vertex twice,
+// which marks them collapsed, and still have to be dropped from the list of their third vertex.
+void MeshSimplifier::ApplyCollapse(const Collapse& collapse, size_t listOffset, std::vector<unsigned int>& merged)
+{
+	Vertex& kept = vertices[collapse.kept];
+	const Vertex& removed = vertices[collapse.removed];
+
+	const glm::vec3 edge = removed.position - kept.position;
+	const float edgeLengthSquared = glm::dot(edge, edge);
+	const float t = edgeLengthSquared > 0.0f ? glm::clamp(glm::dot(collapse.position - kept.position, edge) / edgeLengthSquared, 0.0f, 1.0f) : 0.5f;
+
+	const glm::vec3 normal = glm::mix(kept.normal, removed.normal, t);
+	if (glm::dot(normal, normal) > 0.0f)
+		kept.normal = glm::normalize(normal);
+	kept.color = glm::mix(kept.color, removed.color, t);
+	kept.position = collapse.position;
+
+	quadrics[collapse.kept] += quadrics[collapse.removed];
+	boundaryVertices[collapse.kept] |= boundaryVertices[collapse.removed];
+
+	const unsigned int* keptFaces = &faceLists[faceListOffsets[collapse.kept]];
+	const unsigned int* removedFaces = &faceLists[faceListOffsets[collapse.removed]];
+	merged.resize(faceListCounts[collapse.kept] + faceListCounts[collapse.removed]);
+	merged.resize(std::set_symmetric_difference(keptFaces, keptFaces + faceListCounts[collapse.kept],
+		removedFaces, removedFaces + faceListCounts[collapse.removed], merged.begin()) - merged.begin());
+
+	for (const unsigned int* face = removedFaces; face != removedFaces + faceListCounts[collapse.removed]; face++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (indices[*face * 3 + corner] == collapse.removed)
+				indices[*face * 3 + corner] = collapse.kept;
+		}
+	}
+
+	if (listOffset != faceListOffsets[collapse.kept])
+	{
+		faceListOffsets[collapse.kept] = listOffset;
+		faceListCapacities[collapse.kept] = static_cast<unsigned int>(merged.size());
+	}
+	std::copy(merged.begin(), merged.end(), faceLists.begin() + listOffset);
+	faceListCounts[collapse.kept] = static_cast<unsigned int>(merged.size());
+	faceListCounts[collapse.removed] = 0;
+}
+
+// moves every list to the start of the space the lists before it use, dropping the unused capacity
+void MeshSimplifier::CompactFaceLists()
+{
+	std::vector<size_t> offsets(vertices.size());
+	size_t offset = 0;
+	for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+	{
+		offsets[vertex] = offset;
+		offset += faceListCounts[vertex];
+	}
+
+	std::vector<unsigned int> lists(offset);
+	ParallelForRange(vertices.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t vertex = begin; vertex < end; vertex++)
+		{
+			std::copy_n(faceLists.begin() + faceListOffsets[vertex], faceListCounts[vertex], lists.begin() + offsets[vertex]);
+			faceListCapacities[vertex] = faceListCounts[vertex];
+		}
+	});
+
+	faceLists = std::move(lists);
+	faceListOffsets = std::move(offsets);
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "utils.h"
+#include "MeshData.h"
+#include "VertexAdjacency.h"
+
+// Quadric error metric edge collapse (Garland and Heckbert), made parallel by collapsing in rounds.
+// Every vertex remembers its cheapest valid collapse; a round looks again only around the last batch,
+// then walks the collapses from the cheapest and takes each one whose ends lie outside the rings of
+// those already taken: those never share a triangle, so a whole batch is applied at once without locks.
+// The faces around every vertex are updated in place, so nothing is rebuilt between rounds.
+// Colors and normals are interpolated along the collapsed edge.
+// Collapses that would flip a triangle, pinch the surface or move a boundary inwards are skipped.
+class MeshSimplifier
+{
+public:
+	MeshSimplifier(const MeshData& mesh);
+
+	// collapses edges until at most targetTriangleCount triangles are left or no valid collapse remains
+	void Simplify(size_t targetTriangleCount);
+	size_t GetTriangleCount() const;
+	// the largest distance, in model units, between a collapsed vertex and the planes it stands for
+	// (root mean square, weighted like the quadrics); the geometric error of the current state
+	double GetMaxError() const;
+	// a compacted copy of the current state, unused vertices dropped
+	MeshData GetMesh() const;
+
+	// each level continues from the previous one with the same quadrics; ratios are of the source triangle count
+	static std::vector<MeshData> BuildLodChain(const MeshData& mesh, const std::vector<float>& triangleRatios);
+
+private:
+	// the symmetric 4x4 matrix of summed squared plane distances, upper triangle only,
+	// and the summed weight of those planes
+	struct Quadric
+	{
+		double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+		double weight;
+
+		static Quadric FromPlane(const glm::dvec3& normal, double distance, double weight);
+		Quadric& operator+=(const Quadric& other);
+		double Evaluate(const glm::dvec3& position) const;
+		bool FindMinimum(glm::dvec3& position) const;
+	};
+
+	// the lower vertex is kept and moved to position, the higher one is merged into it
+	struct Collapse
+	{
+		float cost;
+		unsigned int kept, removed;
+		// how many triangles the collapse removes
+		unsigned int sharedFaces;
+		glm::vec3 position;
+	};
+
+	void InitFaceLists();
+	void InitQuadrics();
+	// returns whether anything was collapsed
+	bool SimplifyRound(size_t targetTriangleCount);
+	// buffers reused by the evaluations on one thread
+	struct Scratch
+	{
+		std::vector<unsigned int> neighbours, ring;
+		std::vector<Collapse> collapses;
+	};
+
+	// the cost is infinite when no edge of the vertex can collapse
+	Collapse FindCheapestCollapse(unsigned int vertex, Scratch& scratch) const;
+	Collapse EvaluateCollapse(unsigned int kept, unsigned int removed) const;
+	// fills in the shared faces; false when the collapse would damage the surface.
+	// endNeighbours are the sorted neighbours of end, one of the two ends
+	bool CheckCollapse(Collapse& collapse, unsigned int end, const std::vector<unsigned int>& endNeighbours, std::vector<unsigned int>& ring) const;
+	// appends the sorted neighbours of vertex other than excluded; returns how many
+	size_t AppendNeighbours(unsigned int vertex, unsigned int excluded, std::vector<unsigned int>& neighbours) const;
+	// the merged faces of both ends are written to faceLists at listOffset
+	void ApplyCollapse(const Collapse& collapse, size_t listOffset, std::vector<unsigned int>& merged);
+	void CompactFaceLists();
+
+private:
+	std::vector<Vertex> vertices;
+	// faces never move, so the face lists stay valid; collapsed ones are left with a repeated vertex
+	std::vector<unsigned int> indices;
+	std::vector<MaterialRange> materials;
+	std::vector<Quadric> quadrics;
+	std::vector<uint8_t> boundaryVertices;
+	size_t triangleCount;
+	double maxError;
+
+	// the live faces around vertex v, sorted, are faceListCounts[v] entries at faceLists[faceListOffsets[v]];
+	// a list that outgrows its capacity moves to the end, and the whole is compacted once half of it is unused
+	std::vector<unsigned int> faceLists;
+	std::vector<size_t> faceListOffsets;
+	std::vector<unsigned int> faceListCounts, faceListCapacities;
+
+	// the cheapest collapse of every vertex, valid until a collapse nearby marks the vertex dirty
+	std::vector<Collapse> cheapestCollapses;
+	std::vector<uint8_t> dirtyVertices;
+
+public:
+	// how much more the planes through boundary edges weigh than the surface itself
+	static const double BOUNDARY_WEIGHT;
+	// the least cosine between a triangle's normal before and after a collapse
+	static const float MIN_NORMAL_COSINE;
+	// a round only takes collapses no costlier than this quantile of the candidates, so cheap ones go first
+	static const float ROUND_COST_QUANTILE;
+};
\ No newline at end of file
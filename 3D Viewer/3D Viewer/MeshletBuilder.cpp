@@ -0,0 +1,153 @@
+#include "MeshletBuilder.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const size_t MeshletBuilder::DEFAULT_MAX_VERTICES = 64;
+const size_t MeshletBuilder::DEFAULT_MAX_TRIANGLES = 124;
+const float MeshletBuilder::MIN_CONE_COSINE = 0.1f;
+
+static const size_t GRAIN_SIZE = 1 << 8;
+
+std::vector<Meshlet> MeshletBuilder::Build(const MeshData& mesh, size_t maxVertices, size_t maxTriangles)
+{
+	if (mesh.indexRanges.empty())
+		throw std::runtime_error("Meshlets can only be built once the indices are packed");
+	if (maxVertices < 3 || maxTriangles == 0)
+		throw std::runtime_error(std::format("A meshlet needs room for a triangle, got {} vertices and {} triangles", maxVertices, maxTriangles).data());
+
+	const unsigned int* indices = mesh.GetIndexData();
+	const size_t indexSize = mesh.GetPackedIndexSize();
+
+	// a vertex belongs to the current meshlet when its stamp is the meshlet's
+	std::vector<uint32_t> stamps(mesh.GetVertexCount(), 0);
+	uint32_t stamp = 0;
+
+	auto countNewVertices = [&](size_t i)
+	{
+		size_t count = 0;
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			const unsigned int vertex = indices[i + corner];
+			const bool repeated = (corner > 0 && vertex == indices[i]) || (corner > 1 && vertex == indices[i + 1]);
+			if (stamps[vertex] != stamp && !repeated)
+				count++;
+		}
+		return count;
+	};
+
+	std::vector<Meshlet> meshlets;
+	for (size_t level = 0; level < mesh.GetLodCount(); level++)
+	{
+		for (const IndexRange& range : mesh.GetIndexRanges(level))
+		{
+			const size_t first = range.byteOffset / indexSize;
+			const size_t end = first + range.indexCount;
+
+			Meshlet meshlet = {};
+			meshlet.firstIndex = first;
+			meshlet.baseVertex = range.baseVertex;
+			size_t vertexCount = 0;
+			stamp++;
+
+			for (size_t i = first; i + 2 < end; i += 3)
+			{
+				size_t newVertices = countNewVertices(i);
+				if (meshlet.indexCount / 3 == maxTriangles || vertexCount + newVertices > maxVertices)
+				{
+					meshlets.push_back(meshlet);
+					meshlet.firstIndex = i;
+					meshlet.indexCount = 0;
+					vertexCount = 0;
+					stamp++;
+					newVertices = countNewVertices(i);
+				}
+
+				for (size_t corner = 0; corner < 3; corner++)
+					stamps[indices[i + corner]] = stamp;
+				vertexCount += newVertices;
+				meshlet.indexCount += 3;
+			}
+
+			if (meshlet.indexCount > 0)
+				meshlets.push_back(meshlet);
+		}
+	}
+
+	ParallelForRange(meshlets.size(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			ComputeBounds(mesh, meshlets[i]);
+	});
+
+	return meshlets;
+}
+
+void MeshletBuilder::ComputeBounds(const MeshData& mesh, Meshlet& meshlet)
+{
+	const Vertex* vertices = mesh.GetVertexData();
+	const unsigned int* indices = mesh.GetIndexData() + meshlet.firstIndex;
+	auto position = [&](size_t i) { return vertices != nullptr ? vertices[indices[i]].position : mesh.streams.GetPosition(indices[i]); };
+	// unit length, zero for degenerate triangles
+	auto faceNormal = [&](size_t i)
+	{
+		const glm::vec3 normal = glm::cross(position(i + 1) - position(i), position(i + 2) - position(i));
+		const float length = glm::length(normal);
+		return length > 0.0f ? normal / length : glm::vec3(0.0f);
+	};
+
+	meshlet.min = glm::vec3(std::numeric_limits<float>::max());
+	meshlet.max = glm::vec3(std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i < meshlet.indexCount; i++)
+	{
+		meshlet.min = glm::min(meshlet.min, position(i));
+		meshlet.max = glm::max(meshlet.max, position(i));
+	}
+
+	meshlet.center = (meshlet.min + meshlet.max) * 0.5f;
+	float squaredRadius = 0.0f;
+	for (size_t i = 0; i < meshlet.indexCount; i++)
+	{
+		const glm::vec3 offset = position(i) - meshlet.center;
+		squaredRadius = std::max(squaredRadius, glm::dot(offset, offset));
+	}
+	meshlet.radius = std::sqrt(squaredRadius);
+
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = glm::vec3(0.0f);
+	meshlet.coneCutoff = 1.0f;
+
+	glm::vec3 normalSum(0.0f);
+	for (size_t i = 0; i < meshlet.indexCount; i += 3)
+		normalSum += faceNormal(i);
+	const float sumLength = glm::length(normalSum);
+	if (sumLength == 0.0f)
+		return;
+
+	const glm::vec3 axis = normalSum / sumLength;
+	float minCosine = 1.0f;
+	for (size_t i = 0; i < meshlet.indexCount; i += 3)
+	{
+		const glm::vec3 normal = faceNormal(i);
+		if (normal != glm::vec3(0.0f))
+			minCosine = std::min(minCosine, glm::dot(normal, axis));
+	}
+	if (minCosine < MIN_CONE_COSINE)
+		return;
+
+	// moves the apex back along the axis until it is behind every triangle's plane
+	float apexDistance = 0.0f;
+	for (size_t i = 0; i < meshlet.indexCount; i += 3)
+	{
+		const glm::vec3 normal = faceNormal(i);
+		if (normal != glm::vec3(0.0f))
+			apexDistance = std::max(apexDistance, glm::dot(meshlet.center - position(i), normal) / glm::dot(axis, normal));
+	}
+
+	meshlet.coneApex = meshlet.center - axis * apexDistance;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minCosine * minCosine);
+}
\ No newline at end of file
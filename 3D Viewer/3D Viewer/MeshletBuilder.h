@@ -0,0 +1,25 @@
+#pragma once
+
+#include "utils.h"
+#include "MeshData.h"
+
+// Cuts the index runs of a mesh into meshlets of at most maxVertices distinct vertices and
+// maxTriangles triangles. The triangles are taken in the order they already have, so the index
+// buffer stays as it is and a mesh ordered by MeshOptimizer gives compact clusters; meshlets
+// never cross a packed index run or a level of detail.
+class MeshletBuilder
+{
+public:
+	// needs MeshData::PackIndices(); returns the meshlets of every level of detail in index order
+	static std::vector<Meshlet> Build(const MeshData& mesh, size_t maxVertices = DEFAULT_MAX_VERTICES, size_t maxTriangles = DEFAULT_MAX_TRIANGLES);
+
+private:
+	static void ComputeBounds(const MeshData& mesh, Meshlet& meshlet);
+
+public:
+	// the sizes mesh shaders favour, which also keep the bounds tight
+	static const size_t DEFAULT_MAX_VERTICES;
+	static const size_t DEFAULT_MAX_TRIANGLES;
+	// wider cones cull too little to be worth testing
+	static const float MIN_CONE_COSINE;
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "MeshletCuller.h"
+
+#include "Parallel.h"
+
+const size_t MeshletCuller::PARALLEL_GRAIN_SIZE = 1024;
+
+// planes in model space, normalized so that distances are in model units
+static bool IsVisible(const Meshlet& meshlet, const glm::vec4* planes, const glm::vec3& viewer)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const glm::vec3 normal = glm::vec3(planes[i]);
+		if (glm::dot(normal, meshlet.center) + planes[i].w < -meshlet.radius)
+			return false;
+
+		// the corner of the box furthest along the plane normal
+		const glm::vec3 corner = glm::mix(meshlet.min, meshlet.max, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+		if (glm::dot(normal, corner) + planes[i].w < 0.0f)
+			return false;
+	}
+
+	// written so that a viewer right at the apex keeps the meshlet
+	return !(glm::dot(glm::normalize(meshlet.coneApex - viewer), meshlet.coneAxis) >= meshlet.coneCutoff);
+}
+
+MeshletCuller::MeshletCuller()
+	: visibleCount(0)
+{
+	// empty
+}
+
+const std::vector<IndexRange>& MeshletCuller::Cull(const Meshlet* meshlets, size_t count, size_t indexSize, const glm::mat4& modelView, const glm::mat4& projection)
+{
+	// the frustum planes straight from the rows of the model to clip space matrix
+	const glm::mat4 modelToClip = projection * modelView;
+	const glm::vec4 rows[4] =
+	{
+		glm::vec4(modelToClip[0][0], modelToClip[1][0], modelToClip[2][0], modelToClip[3][0]),
+		glm::vec4(modelToClip[0][1], modelToClip[1][1], modelToClip[2][1], modelToClip[3][1]),
+		glm::vec4(modelToClip[0][2], modelToClip[1][2], modelToClip[2][2], modelToClip[3][2]),
+		glm::vec4(modelToClip[0][3], modelToClip[1][3], modelToClip[2][3], modelToClip[3][3])
+	};
+	glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	const glm::vec3 viewer = glm::vec3(glm::inverse(modelView)[3]);
+
+	visible.resize(count);
+	ParallelForRange(count, PARALLEL_GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			visible[i] = IsVisible(meshlets[i], planes, viewer);
+	});
+
+	ranges.clear();
+	visibleCount = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!visible[i])
+			continue;
+
+		const Meshlet& meshlet = meshlets[i];
+		const size_t byteOffset = meshlet.firstIndex * indexSize;
+		visibleCount++;
+
+		if (!ranges.empty() && ranges.back().baseVertex == meshlet.baseVertex && ranges.back().byteOffset + ranges.back().indexCount * indexSize == byteOffset)
+			ranges.back().indexCount += meshlet.indexCount;
+		else
+			ranges.push_back({ byteOffset, meshlet.indexCount, meshlet.baseVertex });
+	}
+
+	return ranges;
+}
+
+const std::vector<IndexRange>& MeshletCuller::GetRanges() const
+{
+	return ranges;
+}
+
+size_t MeshletCuller::GetVisibleCount() const
+{
+	return visibleCount;
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "utils.h"
+#include "MeshData.h"
+
+// Culls the meshlets of one level of detail every frame, in parallel: against the view frustum by
+// their bounding spheres and then their boxes, and by their normal cones when they face away.
+// The meshlets that survive and follow each other in the index buffer are merged into as few
+// index ranges as possible, drawn with the same glDrawElementsBaseVertex calls as whole meshes.
+class MeshletCuller
+{
+public:
+	MeshletCuller();
+
+	// modelView and projection as the shaders get them, indexSize as MeshData::GetPackedIndexSize()
+	const std::vector<IndexRange>& Cull(const Meshlet* meshlets, size_t count, size_t indexSize, const glm::mat4& modelView, const glm::mat4& projection);
+	// the ranges of the last Cull()
+	const std::vector<IndexRange>& GetRanges() const;
+	size_t GetVisibleCount() const;
+
+private:
+	std::vector<uint8_t> visible;
+	std::vector<IndexRange> ranges;
+	size_t visibleCount;
+
+public:
+	// fewer meshlets are culled on the calling thread alone
+	static const size_t PARALLEL_GRAIN_SIZE;
+};
\ No newline at end of file
@@ -1,33 +1,41 @@
 #include "Model.h"
 
 #include "utils.h"
+#include "GLState.h"
+
+#include <algorithm>
 
 Model::Model(const std::string& filePath)
-	: modelMatrix(glm::mat4(1.0f))
+	: Model(MeshData::Load(filePath))
 {
-	std::ifstream fin(filePath);
-	std::string line;
-
-	ReadVertices(fin);
-	ReadIndices(fin);
-
-	if (indices.size() % 3 != 0)
-	{
-		throw std::exception(std::format("The number of indices is not divisible by 3 in model file {}: {}", filePath, indices.size()).data());
-	}
+	// empty
+}
 
+Model::Model(MeshData&& mesh)
+	: mesh(std::move(mesh)), meshletsCulled(false), modelMatrix(glm::mat4(1.0f))
+{
 	VAO = 0;
 	VBO = 0;
 	EBO = 0;
-	
-	CenterModel();
 
-	CalculateNormals();
 	InitBuffers();
+	InitLods();
+}
+
+Model::Model(MeshData&& mesh, GLuint VBO, GLuint EBO)
+	: mesh(std::move(mesh)), meshletsCulled(false), modelMatrix(glm::mat4(1.0f))
+{
+	VAO = 0;
+	this->VBO = VBO;
+	this->EBO = EBO;
+
+	InitVertexArray();
+	InitLods();
 }
 
 Model::Model(Model&& model) noexcept
-	: vertices(std::move(model.vertices)), indices(std::move(model.indices)), modelMatrix(std::move(model.modelMatrix))
+	: mesh(std::move(model.mesh)), lodSelector(std::move(model.lodSelector)), lodRanges(std::move(model.lodRanges)),
+	meshletCuller(std::move(model.meshletCuller)), meshletsCulled(model.meshletsCulled), modelMatrix(std::move(model.modelMatrix))
 {
 	VAO = model.VAO;
 	VBO = model.VBO;
@@ -39,9 +47,14 @@ Model::Model(Model&& model) noexcept
 }
 
 Model::Model(const Model& model)
-	: vertices(model.vertices), modelMatrix(model.modelMatrix)
+	: mesh(model.mesh), meshletsCulled(false), modelMatrix(model.modelMatrix)
 {
+	VAO = 0;
+	VBO = 0;
+	EBO = 0;
+
 	InitBuffers();
+	InitLods();
 }
 
 Model::~Model()
@@ -59,6 +72,81 @@ glm::vec3 Model::GetPosition() const
 	return glm::vec3(modelMatrix[3][0], modelMatrix[3][1], modelMatrix[3][2]);
 }
 
+const MeshData& Model::GetMesh() const
+{
+	return mesh;
+}
+
+void Model::SelectLod(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float viewportHeight)
+{
+	lodSelector.Select(viewMatrix * modelMatrix, projectionMatrix, viewportHeight);
+}
+
+size_t Model::GetLod() const
+{
+	return lodSelector.GetLevel();
+}
+
+void Model::CullMeshlets(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+{
+	if (mesh.meshlets.empty())
+		return;
+
+	size_t count;
+	const Meshlet* meshlets = mesh.GetMeshlets(lodSelector.GetLevel(), count);
+	meshletCuller.Cull(meshlets, count, mesh.GetPackedIndexSize(), viewMatrix * modelMatrix, projectionMatrix);
+	meshletsCulled = true;
+}
+
+RayHit Model::Pick(const Ray& ray) const
+{
+	RayHit hit;
+	Pick(&ray, 1, &hit);
+	return hit;
+}
+
+// the rays go into model space unnormalized, so the distances along them stay the same
+void Model::Pick(const Ray* rays, size_t count, RayHit* hits) const
+{
+	if (mesh.bvh == nullptr)
+	{
+		std::fill(hits, hits + count, RayHit());
+		return;
+	}
+
+	const glm::mat4 inverseModelMatrix = glm::inverse(modelMatrix);
+	std::vector<Ray> modelRays(count);
+	for (size_t ray = 0; ray < count; ray++)
+	{
+		modelRays[ray].origin = glm::vec3(inverseModelMatrix * glm::vec4(rays[ray].origin, 1.0f));
+		modelRays[ray].direction = glm::vec3(inverseModelMatrix * glm::vec4(rays[ray].direction, 0.0f));
+	}
+
+	const RayCaster caster(mesh, *mesh.bvh);
+	if (count == 1)
+		hits[0] = caster.Intersect(modelRays[0]);
+	else
+		caster.Intersect(modelRays.data(), count, hits);
+
+	for (size_t ray = 0; ray < count; ray++)
+	{
+		if (hits[ray].IsHit())
+			hits[ray].position = glm::vec3(modelMatrix * glm::vec4(hits[ray].position, 1.0f));
+	}
+}
+
+ObjectUniforms Model::GetObjectUniforms() const
+{
+	ObjectUniforms uniforms(modelMatrix);
+	if (mesh.IsQuantized())
+	{
+		uniforms.quantizedVertices = 1;
+		uniforms.positionOffset = mesh.quantizer->GetOffset();
+		uniforms.positionScale = mesh.quantizer->GetScale();
+	}
+	return uniforms;
+}
+
 void Model::SetPosition(const glm::vec3& position)
 {
 	modelMatrix[3][0] = position.x;
@@ -97,137 +185,125 @@ void Model::Rotate(const glm::vec3& rotation)
 	modelMatrix = glm::rotate(modelMatrix, rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
 }
 
-void Model::CenterModel()
-{
-	glm::vec3 center = glm::vec3(0.0f);
-	for (auto& vertex : vertices)
-		center += vertex.position;
-
-	center /= vertices.size();
-
-	for (auto& vertex : vertices)
-		vertex.position -= center;
-}
-
-void Model::ReadVertices(std::istream& fin)
+void Model::InitBuffers()
 {
-	int vertexCount;
-	fin >> vertexCount;
-
-	vertices.resize(vertexCount);
-
-	for (int i = 0; i < vertexCount; i++)
-	{
-		float x, y, z;
-		fin >> x >> y >> z;
-		vertices[i].position = glm::vec3(x, y, z);
-	}
+	GLCall(glGenVertexArrays(1, &VAO));
+	GLState::BindVertexArray(VAO);
 
-	int colorCount;
-	fin >> colorCount;
-	for (int i = 0; i < colorCount; i++)
+	GLCall(glGenBuffers(1, &VBO));
+	GLState::BindBuffer(GL_ARRAY_BUFFER, VBO);
+	// binary meshes are uploaded straight from the file mapping, vertex streams are interleaved
+	// and quantized vertices packed into the buffer
+	const size_t vertexBytes = mesh.GetVertexCount() * mesh.GetUploadVertexSize();
+	if (mesh.HasStreams() || mesh.IsQuantized())
 	{
-		float r, g, b;
-		fin >> r >> g >> b;
-		vertices[i].color = glm::vec3(r, g, b);
+		GLCall(glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW));
+		void* destination = glMapBufferRange(GL_ARRAY_BUFFER, 0, vertexBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (destination != nullptr)
+		{
+			mesh.CopyUploadVertices(destination, 0, mesh.GetVertexCount());
+			GLCall(glUnmapBuffer(GL_ARRAY_BUFFER));
+		}
+		else
+		{
+			// the driver refused the mapping, so the vertices take a detour through system memory
+			std::vector<uint8_t> staging(vertexBytes);
+			mesh.CopyUploadVertices(staging.data(), 0, mesh.GetVertexCount());
+			GLCall(glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, staging.data()));
+		}
 	}
-
-	/*
-	for (int i = 0; i < vertexCount; i++)
+	else
 	{
-		float nx, ny, nz;
-		fin >> nx >> ny >> nz;
-		vertices[i].normal = glm::vec3(nx, ny, nz);
+		GLCall(glBufferData(GL_ARRAY_BUFFER, vertexBytes, mesh.GetVertexData(), GL_STATIC_DRAW));
 	}
-	*/
-}
-
-void Model::ReadIndices(std::istream& fin)
-{
-	unsigned int indexCount;
-	fin >> indexCount;
 
-	indices.resize(indexCount * 3);
+	GLCall(glGenBuffers(1, &EBO));
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	if (mesh.indexRanges.empty())
+		mesh.PackIndices();
+	GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.GetPackedIndexBytes(), mesh.GetPackedIndexData(), GL_STATIC_DRAW));
 
-	for (unsigned int i = 0; i < indexCount * 3; i++)
-	{
-		unsigned int index;
-		fin >> index;
-		indices[i] = index;
-	}
+	InitVertexArray();
 }
 
-void Model::CalculateNormals()
+void Model::InitVertexArray()
 {
-	for (int i = 0; i < indices.size(); i += 3)
+	if (VAO == 0)
 	{
-		glm::vec3 v1 = vertices[indices[i + 1]].position - vertices[indices[i]].position;
-		glm::vec3 v2 = vertices[indices[i + 2]].position - vertices[indices[i + 1]].position;
-		glm::vec3 v3 = vertices[indices[i]].position - vertices[indices[i + 2]].position;
-
-		vertices[indices[i]].normal += glm::cross(v1, -v3);
-		vertices[indices[i + 1]].normal += glm::cross(v2, -v1);
-		vertices[indices[i + 2]].normal += glm::cross(v3, -v2);
+		GLCall(glGenVertexArrays(1, &VAO));
 	}
+	GLState::BindVertexArray(VAO);
+
+	GLState::BindBuffer(GL_ARRAY_BUFFER, VBO);
 
-	for (auto& vertex : vertices)
+	if (mesh.IsQuantized())
 	{
-		if (glm::length(vertex.normal) > 0.0f)
-			vertex.normal = glm::normalize(vertex.normal);
-	}
-}
+		// vertex Positions, [0, 1] inside the mesh bounds
+		GLCall(glEnableVertexAttribArray(0));
+		GLCall(glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, position)));
 
-void Model::InitBuffers()
-{
-	GLCall(glGenVertexArrays(1, &VAO));
-	GLCall(glBindVertexArray(VAO));
+		// vertex normals, octahedral codes in [-1, 1]
+		GLCall(glEnableVertexAttribArray(1));
+		GLCall(glVertexAttribPointer(1, dimof(QuantizedVertex::normal), GL_SHORT, GL_TRUE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, normal)));
 
-	GLCall(glGenBuffers(1, &VBO));
-	GLCall(glBindBuffer(GL_ARRAY_BUFFER, VBO));
-	GLCall(glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices[0]), vertices.data(), GL_STATIC_DRAW));
-
-	// vertex Positions
-	GLCall(glEnableVertexAttribArray(0));
-	GLCall(glVertexAttribPointer(0, dimof(vertices[0].position), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position)));
+		// vertex color coords
+		GLCall(glEnableVertexAttribArray(2));
+		GLCall(glVertexAttribPointer(2, dimof(QuantizedVertex::color), GL_UNSIGNED_BYTE, GL_TRUE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, color)));
+	}
+	else
+	{
+		// vertex Positions
+		GLCall(glEnableVertexAttribArray(0));
+		GLCall(glVertexAttribPointer(0, dimof(Vertex::position), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position)));
 
-	// vertex normals
-	GLCall(glEnableVertexAttribArray(1));
-	GLCall(glVertexAttribPointer(1, dimof(vertices[0].normal), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal)));
+		// vertex normals
+		GLCall(glEnableVertexAttribArray(1));
+		GLCall(glVertexAttribPointer(1, dimof(Vertex::normal), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal)));
 
-	// vertex color coords
-	GLCall(glEnableVertexAttribArray(2));
-	GLCall(glVertexAttribPointer(2, dimof(vertices[0].color), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color)));
+		// vertex color coords
+		GLCall(glEnableVertexAttribArray(2));
+		GLCall(glVertexAttribPointer(2, dimof(Vertex::color), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color)));
+	}
 
-	GLCall(glGenBuffers(1, &EBO));
-	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO));
-	GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(indices[0]), indices.data(), GL_STATIC_DRAW));
+	// the element buffer stays bound to the VAO
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	GLState::BindVertexArray(0);
+}
 
-	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-	GLCall(glBindVertexArray(0));
+// GetIndexRanges() also covers meshes that were uploaded with their 32-bit indices
+void Model::InitLods()
+{
+	lodSelector = LodSelector(mesh);
+	lodRanges.clear();
+	for (size_t level = 0; level < mesh.GetLodCount(); level++)
+		lodRanges.push_back(mesh.GetIndexRanges(level));
 }
 
+// nothing is unbound afterwards, so drawing the same model again binds nothing
 void Model::Render() const
 {
-	GLCall(glBindVertexArray(VAO));
-	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO));
-
-	GLCall(glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, nullptr));
+	GLState::BindVertexArray(VAO);
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
-	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-	GLCall(glBindVertexArray(0));
+	const GLenum indexType = GetIndexType(mesh.GetPackedIndexSize());
+	const std::vector<IndexRange>& ranges = meshletsCulled ? meshletCuller.GetRanges() : lodRanges[lodSelector.GetLevel()];
+	for (const IndexRange& range : ranges)
+	{
+		GLCall(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)range.indexCount, indexType, (void*)range.byteOffset, (GLint)range.baseVertex));
+	}
 }
 
 void Model::DestroyBuffers()
 {
-	GLCall(glBindVertexArray(0));
-	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+	if (VAO == 0 && VBO == 0 && EBO == 0)
+		return;
 
 	if(EBO != 0)
-		GLCall(glDeleteBuffers(1, &EBO));
+		GLState::DeleteBuffer(EBO);
 	if(VBO != 0)
-		GLCall(glDeleteBuffers(1, &VBO));
+		GLState::DeleteBuffer(VBO);
 	if(VAO != 0)
-		GLCall(glDeleteVertexArrays(1, &VAO));
+		GLState::DeleteVertexArray(VAO);
 
 	VAO = 0;
 	VBO = 0;
@@ -2,19 +2,42 @@
 
 #include "utils.h"
 #include "Vertex.h"
+#include "MeshData.h"
+#include "LodSelector.h"
+#include "MeshletCuller.h"
+#include "RayCaster.h"
+#include "UniformBuffers.h"
 
 class Model
 {
 public:
 	Model(const std::string& filePath);
+	Model(MeshData&& mesh);
+	// takes ownership of vertex and index buffers that were already filled with the mesh data,
+	// the index buffer as packed by MeshData::PackIndices()
+	Model(MeshData&& mesh, GLuint VBO, GLuint EBO);
 	Model(Model&& model) noexcept;
 	Model(const Model&);
 	~Model();
 
+	// draws the level of detail picked by the last SelectLod(), the full mesh until then;
+	// meshes with meshlets only draw the ones that survived the last CullMeshlets()
 	void Render() const;
+	void SelectLod(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float viewportHeight);
+	size_t GetLod() const;
+	// culls the meshlets of the current level of detail, does nothing for meshes without any
+	void CullMeshlets(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+	// the model matrix and how the shaders unpack this model's vertices
+	ObjectUniforms GetObjectUniforms() const;
+	// the closest triangle a world space ray hits, with the position and distance in world space;
+	// only meshes loaded with LoadOptions::buildBvh can be hit
+	RayHit Pick(const Ray& ray) const;
+	// every ray on its own, in parallel
+	void Pick(const Ray* rays, size_t count, RayHit* hits) const;
 
 	glm::mat4 GetModelMatrix() const;
 	glm::vec3 GetPosition() const;
+	const MeshData& GetMesh() const;
 
 	void SetPosition(const glm::vec3& position);
 	void SetScale(const glm::vec3& scale);
@@ -24,22 +47,23 @@ public:
 	void Scale(const glm::vec3& scale);
 	void Rotate(const glm::vec3& rotation);
 
-	void CenterModel();
-
 private:
-	void ReadVertices(std::istream& fin);
-	void ReadIndices(std::istream& fin);
-
-	void CalculateNormals();
-
 	void InitBuffers();
+	void InitVertexArray();
+	void InitLods();
 	void DestroyBuffers();
 
 private:
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
+	MeshData mesh;
 
 	GLuint VAO, VBO, EBO;
 
+	LodSelector lodSelector;
+	// the index runs of every level of detail, all in EBO
+	std::vector<std::vector<IndexRange>> lodRanges;
+
+	MeshletCuller meshletCuller;
+	bool meshletsCulled;
+
 	glm::mat4 modelMatrix;
 };
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include "ModelLoader.h"
+
+#include "MeshletBuilder.h"
+#include "Bvh.h"
+#include "GLState.h"
+
+#include <cstring>
+
+const size_t ModelLoader::UPLOAD_BYTES_PER_FRAME = 8 * 1024 * 1024;
+const size_t ModelLoader::SLICE_SIZE = 2 * 1024 * 1024;
+const size_t ModelLoader::STAGING_SLOT_COUNT = 8;
+
+ModelLoader::ModelLoader(MeshCache* cache, const LoadOptions& options)
+	: cache(cache), options(options)
+{
+	InitStaging();
+	worker = std::thread(&ModelLoader::WorkerLoop, this);
+}
+
+ModelLoader::~ModelLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	worker.join();
+
+	// uploads still waiting in the queue have no GL objects yet, and arena pages belong to their arena
+	if (currentUpload && currentUpload->request.onLoaded)
+	{
+		GLState::DeleteBuffer(currentUpload->VBO);
+		GLState::DeleteBuffer(currentUpload->EBO);
+	}
+
+	DestroyStaging();
+}
+
+void ModelLoader::Load(const std::string& filePath, LoadedCallback onLoaded)
+{
+	Enqueue({ filePath, std::move(onLoaded), nullptr, nullptr });
+}
+
+void ModelLoader::LoadMesh(const std::string& filePath, BufferArena& arena, MeshLoadedCallback onLoaded)
+{
+	Enqueue({ filePath, nullptr, std::move(onLoaded), &arena });
+}
+
+void ModelLoader::Enqueue(Request&& request)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingRequests.push_back(std::move(request));
+		requestsInFlight++;
+	}
+	condition.notify_one();
+}
+
+bool ModelLoader::IsIdle() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return requestsInFlight == 0;
+}
+
+void ModelLoader::Update()
+{
+	size_t budget = UPLOAD_BYTES_PER_FRAME;
+	while (budget > 0)
+	{
+		if (!currentUpload)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (readyUploads.empty())
+				return;
+
+			currentUpload = std::move(readyUploads.front());
+			readyUploads.pop_front();
+		}
+
+		if (!currentUpload->error.empty())
+		{
+			std::cout << "Could not load the model from \n\t" << currentUpload->request.filePath << "\n\t" << currentUpload->error << std::endl;
+			currentUpload.reset();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			requestsInFlight--;
+			continue;
+		}
+
+		size_t remaining = ContinueUpload(budget);
+		// out of budget, or the staging ring is still busy
+		if (currentUpload)
+			return;
+		budget = remaining;
+	}
+}
+
+size_t ModelLoader::ContinueUpload(size_t budget)
+{
+	if (currentUpload->VBO == 0)
+		BeginUpload();
+
+	const MeshData& mesh = currentUpload->mesh;
+	const size_t vertexSize = mesh.GetUploadVertexSize();
+	const size_t vertexBytes = mesh.GetVertexCount() * vertexSize;
+	const size_t indexBytes = mesh.GetPackedIndexBytes();
+
+	while (budget > 0)
+	{
+		GLuint target;
+		size_t base;
+		size_t* uploaded;
+		size_t size;
+		std::function<void(void*)> copy;
+
+		if (currentUpload->vertexBytesUploaded < vertexBytes)
+		{
+			target = currentUpload->VBO;
+			base = currentUpload->vertexByteOffset;
+			uploaded = &currentUpload->vertexBytesUploaded;
+			// whole vertices only, vertex streams are interleaved and quantized vertices packed while they are copied
+			size = std::min({ SLICE_SIZE, vertexBytes - *uploaded, budget }) / vertexSize * vertexSize;
+			const size_t firstVertex = *uploaded / vertexSize;
+			copy = [&mesh, firstVertex, size, vertexSize](void* destination) { mesh.CopyUploadVertices(destination, firstVertex, size / vertexSize); };
+		}
+		else if (currentUpload->indexBytesUploaded < indexBytes)
+		{
+			target = currentUpload->EBO;
+			base = currentUpload->indexByteOffset;
+			uploaded = &currentUpload->indexBytesUploaded;
+			size = std::min({ SLICE_SIZE, indexBytes - *uploaded, budget });
+			const uint8_t* source = static_cast<const uint8_t*>(mesh.GetPackedIndexData()) + *uploaded;
+			copy = [source, size](void* destination) { std::memcpy(destination, source, size); };
+		}
+		else
+		{
+			break;
+		}
+
+		if (size == 0)
+			break;
+
+		size_t copied = UploadSlice(target, base + *uploaded, size, copy);
+		if (copied == 0)
+			break;
+
+		*uploaded += copied;
+		budget -= copied;
+	}
+
+	if (currentUpload->vertexBytesUploaded == vertexBytes && currentUpload->indexBytesUploaded == indexBytes)
+		FinishUpload();
+
+	return budget;
+}
+
+void ModelLoader::WorkerLoop()
+{
+	while (true)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !pendingRequests.empty(); });
+			if (stopping)
+				return;
+
+			request = std::move(pendingRequests.front());
+			pendingRequests.pop_front();
+		}
+
+		auto upload = std::make_unique<Upload>();
+		upload->request = std::move(request);
+
+		try
+		{
+			if (cache != nullptr)
+				upload->mesh = cache->Load(upload->request.filePath, options);
+			else
+				upload->mesh = MeshData::Load(upload->request.filePath, options);
+
+			upload->mesh.PackIndices();
+
+			if (options.buildMeshlets && upload->request.onLoaded)
+				upload->mesh.meshlets = MeshletBuilder::Build(upload->mesh);
+
+			if (options.buildBvh && upload->request.onLoaded)
+			{
+				auto bvh = std::make_shared<Bvh>(upload->mesh);
+				bvh->BuildWideNodes();
+				upload->mesh.bvh = std::move(bvh);
+			}
+
+			// meshes for shared buffers stay full precision, the buffers have one vertex format
+			if (options.quantizeVertices && upload->request.onLoaded)
+			{
+				const QuantizationError error = upload->mesh.Quantize();
+				std::cout << std::format("Quantized {} vertices, error: position {:.6f}, normal {:.4f} degrees, color {:.4f}",
+					upload->mesh.GetVertexCount(), error.position, error.normalDegrees, error.color) << std::endl;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			upload->error = e.what();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		readyUploads.push_back(std::move(upload));
+	}
+}
+
+void ModelLoader::InitStaging()
+{
+	slotFences.assign(STAGING_SLOT_COUNT, nullptr);
+
+	if (!GLEW_ARB_buffer_storage)
+		return;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	GLCall(glGenBuffers(1, &stagingBuffer));
+	GLCall(glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer));
+	GLCall(glBufferStorage(GL_COPY_READ_BUFFER, SLICE_SIZE * STAGING_SLOT_COUNT, nullptr, flags));
+	stagingMemory = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, SLICE_SIZE * STAGING_SLOT_COUNT, flags));
+	GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+
+	// without the mapping the ring is useless, and slices are written straight into their buffers
+	if (stagingMemory == nullptr)
+		DestroyStaging();
+}
+
+void ModelLoader::DestroyStaging()
+{
+	for (auto& fence : slotFences)
+	{
+		if (fence != nullptr)
+		{
+			GLCall(glDeleteSync(fence));
+		}
+		fence = nullptr;
+	}
+
+	if (stagingBuffer != 0)
+	{
+		GLCall(glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer));
+		if (stagingMemory != nullptr)
+		{
+			GLCall(glUnmapBuffer(GL_COPY_READ_BUFFER));
+		}
+		GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+		GLState::DeleteBuffer(stagingBuffer);
+	}
+
+	stagingBuffer = 0;
+	stagingMemory = nullptr;
+}
+
+void ModelLoader::BeginUpload()
+{
+	const MeshData& mesh = currentUpload->mesh;
+
+	if (BufferArena* arena = currentUpload->request.arena)
+	{
+		currentUpload->allocation = arena->Allocate(mesh);
+		currentUpload->VBO = arena->GetVertexBuffer(currentUpload->allocation.page);
+		currentUpload->EBO = arena->GetIndexBuffer(currentUpload->allocation.page);
+		currentUpload->vertexByteOffset = currentUpload->allocation.baseVertex * sizeof(Vertex);
+		currentUpload->indexByteOffset = currentUpload->allocation.indexByteOffset;
+		return;
+	}
+
+	// the storage is allocated up front and filled slice by slice; GL_COPY_WRITE_BUFFER leaves the VAO state alone
+	GLCall(glGenBuffers(1, &currentUpload->VBO));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, currentUpload->VBO));
+	GLCall(glBufferData(GL_COPY_WRITE_BUFFER, mesh.GetVertexCount() * mesh.GetUploadVertexSize(), nullptr, GL_STATIC_DRAW));
+
+	GLCall(glGenBuffers(1, &currentUpload->EBO));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, currentUpload->EBO));
+	GLCall(glBufferData(GL_COPY_WRITE_BUFFER, mesh.GetPackedIndexBytes(), nullptr, GL_STATIC_DRAW));
+
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+
+void ModelLoader::FinishUpload()
+{
+	std::unique_ptr<Upload> upload = std::move(currentUpload);
+
+	if (upload->request.onMeshLoaded)
+	{
+		upload->request.onMeshLoaded(std::move(upload->mesh), upload->allocation);
+	}
+	else
+	{
+		Model model(std::move(upload->mesh), upload->VBO, upload->EBO);
+		upload->request.onLoaded(std::move(model));
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	requestsInFlight--;
+}
+
+size_t ModelLoader::UploadSlice(GLuint target, size_t offset, size_t size, const std::function<void(void*)>& copy)
+{
+	// without a staging ring the slice is written straight into the destination range
+	if (stagingMemory == nullptr)
+	{
+		GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, target));
+		void* destination = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		if (destination != nullptr)
+		{
+			copy(destination);
+			GLCall(glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+		}
+		else
+		{
+			// the driver refused the mapping, so the slice is handed over as a copy
+			std::vector<uint8_t> slice(size);
+			copy(slice.data());
+			GLCall(glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, slice.data()));
+		}
+		GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+		return size;
+	}
+
+	// a slot can only be rewritten once the GPU has finished the copy that last read from it
+	GLsync& fence = slotFences[nextSlot];
+	if (fence != nullptr)
+	{
+		if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			return 0;
+
+		GLCall(glDeleteSync(fence));
+		fence = nullptr;
+	}
+
+	const size_t stagingOffset = nextSlot * SLICE_SIZE;
+	copy(stagingMemory + stagingOffset);
+
+	GLCall(glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, target));
+	GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, stagingOffset, offset, size));
+	GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	nextSlot = (nextSlot + 1) % STAGING_SLOT_COUNT;
+
+	return size;
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "utils.h"
+#include "BufferArena.h"
+#include "MeshData.h"
+#include "MeshCache.h"
+#include "Model.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Loads models without stalling the frame loop.
+// Parsing and preprocessing run on a worker thread; the finished mesh is then copied to the GPU
+// in fixed-size slices, at most UPLOAD_BYTES_PER_FRAME per Update() call, through a persistently
+// mapped staging ring (or plain glBufferSubData slices when ARB_buffer_storage is missing).
+class ModelLoader
+{
+public:
+	using LoadedCallback = std::function<void(Model&& model)>;
+	using MeshLoadedCallback = std::function<void(MeshData&& mesh, const BufferArena::Allocation& allocation)>;
+
+	// meshes go through the cache when one is given; it has to outlive the loader
+	ModelLoader(MeshCache* cache = nullptr, const LoadOptions& options = LoadOptions());
+	ModelLoader(const ModelLoader&) = delete;
+	ModelLoader& operator=(const ModelLoader&) = delete;
+	~ModelLoader();
+
+	// the callback runs on the thread calling Update(), once the model is fully uploaded
+	void Load(const std::string& filePath, LoadedCallback onLoaded);
+	// for meshes that go into shared buffers; the mesh is uploaded into its arena slices like a model,
+	// and the callback gets the CPU data along with them; the arena has to outlive the request
+	void LoadMesh(const std::string& filePath, BufferArena& arena, MeshLoadedCallback onLoaded);
+
+	// must be called once per frame from the thread that owns the GL context
+	void Update();
+
+	bool IsIdle() const;
+
+private:
+	struct Request
+	{
+		std::string filePath;
+		// exactly one of the callbacks is set, the arena along with onMeshLoaded
+		LoadedCallback onLoaded;
+		MeshLoadedCallback onMeshLoaded;
+		BufferArena* arena = nullptr;
+	};
+
+	struct Upload
+	{
+		Request request;
+		MeshData mesh;
+		std::string error;
+
+		// arena meshes are written into the slices of a shared page, models get buffers of their own
+		BufferArena::Allocation allocation;
+		GLuint VBO = 0;
+		GLuint EBO = 0;
+		size_t vertexByteOffset = 0;
+		size_t indexByteOffset = 0;
+		size_t vertexBytesUploaded = 0;
+		size_t indexBytesUploaded = 0;
+	};
+
+	void WorkerLoop();
+
+	void InitStaging();
+	void DestroyStaging();
+
+	void Enqueue(Request&& request);
+
+	// return the part of the budget left over
+	size_t ContinueUpload(size_t budget);
+
+	void BeginUpload();
+	void FinishUpload();
+	// copy writes the size bytes of the slice to the pointer it gets;
+	// returns the number of bytes copied, 0 when the staging ring is still in use by the GPU
+	size_t UploadSlice(GLuint target, size_t offset, size_t size, const std::function<void(void*)>& copy);
+
+private:
+	MeshCache* cache;
+	LoadOptions options;
+	std::thread worker;
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+
+	std::deque<Request> pendingRequests;
+	std::deque<std::unique_ptr<Upload>> readyUploads;
+	std::unique_ptr<Upload> currentUpload;
+	size_t requestsInFlight = 0;
+
+	GLuint stagingBuffer = 0;
+	uint8_t* stagingMemory = nullptr;
+	std::vector<GLsync> slotFences;
+	size_t nextSlot = 0;
+
+public:
+	static const size_t UPLOAD_BYTES_PER_FRAME;
+	static const size_t SLICE_SIZE;
+	static const size_t STAGING_SLOT_COUNT;
+};
\ No newline at end of file
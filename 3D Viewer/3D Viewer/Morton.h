@@ -0,0 +1,23 @@
+#pragma once
+
+#include "utils.h"
+
+// Morton (Z-order) codes: nearby points get nearby codes, so sorting by them groups geometry spatially.
+
+// spreads the low 10 bits of value so there are two zero bits between each of them
+inline uint32_t SpreadBits(uint32_t value)
+{
+	value &= 0x3FF;
+	value = (value | (value << 16)) & 0x030000FF;
+	value = (value | (value << 8)) & 0x0300F00F;
+	value = (value | (value << 4)) & 0x030C30C3;
+	value = (value | (value << 2)) & 0x09249249;
+	return value;
+}
+
+// 30 bit code of a point inside the unit cube
+inline uint32_t MortonCode(const glm::vec3& normalized)
+{
+	glm::uvec3 cell = glm::uvec3(glm::clamp(normalized * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f)));
+	return (SpreadBits(cell.x) << 2) | (SpreadBits(cell.y) << 1) | SpreadBits(cell.z);
+}
\ No newline at end of file
@@ -0,0 +1,326 @@
+#include "ObjReader.h"
+
+#include "Parallel.h"
+#include "TextParsing.h"
+
+#include <cstring>
+#include <limits>
+
+const size_t ObjReader::BLOCK_SIZE = 16 * 1024 * 1024;
+const size_t ObjReader::SHARD_COUNT = 64;
+const unsigned int ObjReader::NO_NORMAL = 0xFFFFFFFF;
+const glm::vec3 ObjReader::DEFAULT_COLOR = glm::vec3(1.0f, 1.0f, 1.0f);
+
+ObjReader::ObjReader(const std::string& filePath)
+	: filePath(filePath)
+{
+	// material 0 is used by the faces that come before any usemtl
+	materials.push_back({ "", DEFAULT_COLOR });
+}
+
+bool ObjReader::HasNormals() const
+{
+	return hasNormals;
+}
+
+void ObjReader::Read(MeshData& mesh)
+{
+	std::ifstream fin(filePath, std::ios::binary);
+	if (!fin)
+	{
+		throw std::runtime_error(std::format("Could not open model file {}", filePath).data());
+	}
+
+	// the file is streamed in blocks; the unfinished last line of a block is carried over to the next one
+	std::vector<char> buffer(BLOCK_SIZE);
+	size_t carried = 0;
+	size_t lineNumber = 1;
+
+	while (fin)
+	{
+		if (carried == buffer.size())
+			buffer.resize(buffer.size() * 2);
+
+		fin.read(buffer.data() + carried, buffer.size() - carried);
+		size_t available = carried + static_cast<size_t>(fin.gcount());
+		bool lastBlock = !fin;
+
+		const char* current = buffer.data();
+		const char* end = buffer.data() + available;
+		while (current < end)
+		{
+			const char* lineEnd = std::find(current, end, '\n');
+			if (lineEnd == end && !lastBlock)
+				break;
+
+			ParseLine(std::string_view(current, lineEnd - current), lineNumber++);
+			current = lineEnd == end ? end : lineEnd + 1;
+		}
+
+		carried = end - current;
+		std::memmove(buffer.data(), current, carried);
+	}
+
+	BuildMesh(mesh);
+}
+
+void ObjReader::ParseLine(std::string_view line, size_t lineNumber)
+{
+	const char* current = line.data();
+	const char* end = line.data() + line.size();
+
+	std::string_view keyword = NextToken(current, end);
+	if (keyword.empty() || keyword[0] == '#')
+		return;
+
+	auto readVec3 = [&](glm::vec3& value)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (!ParseValue(NextToken(current, end), value[i]))
+				throw std::runtime_error(std::format("Invalid '{}' statement at line {} in model file {}", keyword, lineNumber, filePath).data());
+		}
+	};
+
+	if (keyword == "v")
+	{
+		glm::vec3 position;
+		readVec3(position);
+		positions.push_back(position);
+
+		// some exporters append the vertex color to the position
+		glm::vec3 color;
+		std::string_view red = NextToken(current, end);
+		bool colored = !red.empty() && ParseValue(red, color.r)
+			&& ParseValue(NextToken(current, end), color.g) && ParseValue(NextToken(current, end), color.b);
+
+		if (colored)
+		{
+			colors.resize(positions.size(), DEFAULT_COLOR);
+			hasColor.resize(positions.size(), false);
+			colors.back() = color;
+			hasColor.back() = true;
+		}
+	}
+	else if (keyword == "vn")
+	{
+		glm::vec3 normal;
+		readVec3(normal);
+		normals.push_back(normal);
+	}
+	else if (keyword == "vc")
+	{
+		glm::vec3 color;
+		readVec3(color);
+
+		// the n-th vc statement colors the n-th vertex
+		size_t colorIndex = vertexColorCount++;
+		colors.resize(std::max(colors.size(), colorIndex + 1), DEFAULT_COLOR);
+		hasColor.resize(std::max(hasColor.size(), colorIndex + 1), false);
+		colors[colorIndex] = color;
+		hasColor[colorIndex] = true;
+	}
+	else if (keyword == "f")
+	{
+		ParseFace(current, end, lineNumber);
+	}
+	else if (keyword == "usemtl")
+	{
+		currentMaterial = FindOrAddMaterial(NextToken(current, end));
+	}
+	else if (keyword == "mtllib")
+	{
+		std::string_view library = NextToken(current, end);
+		ReadMaterials((std::filesystem::path(filePath).parent_path() / library).string());
+	}
+}
+
+void ObjReader::ParseFace(const char* current, const char* end, size_t lineNumber)
+{
+	faceCorners.clear();
+
+	auto resolve = [&](std::string_view text, size_t count) -> unsigned int
+	{
+		long long index;
+		if (!ParseValue(text, index) || index == 0)
+			throw std::runtime_error(std::format("Invalid face index '{}' at line {} in model file {}", text, lineNumber, filePath).data());
+
+		long long resolved = index > 0 ? index - 1 : static_cast<long long>(count) + index;
+		if (resolved < 0 || resolved >= static_cast<long long>(count))
+			throw std::runtime_error(std::format("Face index {} out of range at line {} in model file {}", index, lineNumber, filePath).data());
+
+		return static_cast<unsigned int>(resolved);
+	};
+
+	for (std::string_view token = NextToken(current, end); !token.empty(); token = NextToken(current, end))
+	{
+		// v, v/vt, v//vn or v/vt/vn
+		size_t firstSlash = token.find('/');
+		size_t secondSlash = firstSlash == std::string_view::npos ? std::string_view::npos : token.find('/', firstSlash + 1);
+
+		Corner corner;
+		corner.position = resolve(token.substr(0, firstSlash), positions.size());
+		corner.normal = NO_NORMAL;
+		corner.material = currentMaterial;
+
+		if (secondSlash != std::string_view::npos && secondSlash + 1 < token.size())
+			corner.normal = resolve(token.substr(secondSlash + 1), normals.size());
+		else
+			hasNormals = false;
+
+		faceCorners.push_back(corner);
+	}
+
+	if (faceCorners.size() < 3)
+		throw std::runtime_error(std::format("Face with less than 3 corners at line {} in model file {}", lineNumber, filePath).data());
+
+	for (size_t i = 1; i + 1 < faceCorners.size(); i++)
+	{
+		corners.push_back(faceCorners[0]);
+		corners.push_back(faceCorners[i]);
+		corners.push_back(faceCorners[i + 1]);
+	}
+}
+
+void ObjReader::ReadMaterials(const std::string& libraryPath)
+{
+	std::ifstream fin(libraryPath);
+	if (!fin)
+	{
+		std::cout << "Could not open material library " << libraryPath << "; using the default color" << std::endl;
+		return;
+	}
+
+	unsigned int material = 0;
+	std::string line;
+	while (std::getline(fin, line))
+	{
+		const char* current = line.data();
+		const char* end = line.data() + line.size();
+
+		std::string_view keyword = NextToken(current, end);
+		if (keyword == "newmtl")
+		{
+			material = FindOrAddMaterial(NextToken(current, end));
+		}
+		else if (keyword == "Kd" && material != 0)
+		{
+			glm::vec3 diffuse;
+			if (ParseValue(NextToken(current, end), diffuse.r) && ParseValue(NextToken(current, end), diffuse.g)
+				&& ParseValue(NextToken(current, end), diffuse.b))
+			{
+				materials[material].diffuseColor = diffuse;
+			}
+		}
+	}
+}
+
+unsigned int ObjReader::FindOrAddMaterial(std::string_view name)
+{
+	auto it = materialLookup.find(std::string(name));
+	if (it != materialLookup.end())
+		return it->second;
+
+	unsigned int material = static_cast<unsigned int>(materials.size());
+	materials.push_back({ std::string(name), DEFAULT_COLOR });
+	materialLookup.emplace(std::string(name), material);
+	return material;
+}
+
+size_t ObjReader::HashCorner(const Corner& corner)
+{
+	uint64_t hash = corner.position * 0x9E3779B97F4A7C15ull;
+	hash ^= (corner.normal + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+	hash ^= corner.material * 0x165667B19E3779F9ull;
+	return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+Vertex ObjReader::MakeVertex(const Corner& corner) const
+{
+	glm::vec3 normal = corner.normal == NO_NORMAL || !hasNormals ? glm::vec3(0.0f) : normals[corner.normal];
+	bool colored = corner.position < hasColor.size() && hasColor[corner.position];
+	glm::vec3 color = colored ? colors[corner.position] : materials[corner.material].diffuseColor;
+
+	return Vertex(positions[corner.position], normal, color);
+}
+
+void ObjReader::BuildMesh(MeshData& mesh)
+{
+	const size_t triangleCount = corners.size() / 3;
+
+	// group the triangles by material (stable counting sort) so every material is one contiguous range
+	std::vector<size_t> materialStart(materials.size() + 1, 0);
+	for (size_t t = 0; t < triangleCount; t++)
+		materialStart[corners[3 * t].material + 1]++;
+	for (size_t m = 1; m < materialStart.size(); m++)
+		materialStart[m] += materialStart[m - 1];
+
+	std::vector<Corner> sortedCorners(corners.size());
+	std::vector<size_t> nextTriangle(materialStart.begin(), materialStart.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		size_t destination = nextTriangle[corners[3 * t].material]++;
+		std::copy_n(&corners[3 * t], 3, &sortedCorners[3 * destination]);
+	}
+	corners.clear();
+	corners.shrink_to_fit();
+
+	mesh.materials.clear();
+	for (size_t m = 0; m < materials.size(); m++)
+	{
+		if (materialStart[m + 1] > materialStart[m])
+			mesh.materials.push_back({ materials[m].name, materials[m].diffuseColor, 3 * materialStart[m], 3 * (materialStart[m + 1] - materialStart[m]) });
+	}
+
+	// every shard of the hash map is owned by exactly one task, so no locking is needed;
+	// the corners of a shard are visited in file order, which keeps the result deterministic
+	const size_t cornerCount = sortedCorners.size();
+	std::vector<unsigned char> cornerShard(cornerCount);
+	// the shard comes from the high bits of the hash, since the buckets of each map come from the low ones
+	const size_t shardSpan = std::numeric_limits<size_t>::max() / SHARD_COUNT + 1;
+	ParallelForRange(cornerCount, 1 << 16, [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+			cornerShard[c] = static_cast<unsigned char>(HashCorner(sortedCorners[c]) / shardSpan);
+	});
+
+	std::vector<std::vector<unsigned int>> shardCorners(SHARD_COUNT);
+	for (size_t c = 0; c < cornerCount; c++)
+		shardCorners[cornerShard[c]].push_back(static_cast<unsigned int>(c));
+
+	std::vector<unsigned int> cornerVertex(cornerCount);
+	std::vector<std::vector<Corner>> shardVertices(SHARD_COUNT);
+
+	auto cornerHash = [](const Corner& corner) { return HashCorner(corner); };
+	ParallelFor(SHARD_COUNT, [&](size_t shard)
+	{
+		std::unordered_map<Corner, unsigned int, decltype(cornerHash)> lookup(shardCorners[shard].size(), cornerHash);
+
+		for (unsigned int c : shardCorners[shard])
+		{
+			auto [it, inserted] = lookup.try_emplace(sortedCorners[c], static_cast<unsigned int>(shardVertices[shard].size()));
+			if (inserted)
+				shardVertices[shard].push_back(sortedCorners[c]);
+			cornerVertex[c] = it->second;
+		}
+	});
+
+	std::vector<size_t> shardBase(SHARD_COUNT + 1, 0);
+	for (size_t shard = 0; shard < SHARD_COUNT; shard++)
+		shardBase[shard + 1] = shardBase[shard] + shardVertices[shard].size();
+
+	mesh.vertices.resize(shardBase[SHARD_COUNT]);
+	mesh.indices.resize(cornerCount);
+
+	ParallelFor(SHARD_COUNT, [&](size_t shard)
+	{
+		for (size_t i = 0; i < shardVertices[shard].size(); i++)
+			mesh.vertices[shardBase[shard] + i] = MakeVertex(shardVertices[shard][i]);
+	});
+
+	ParallelForRange(cornerCount, 1 << 16, [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+			mesh.indices[c] = static_cast<unsigned int>(shardBase[cornerShard[c]] + cornerVertex[c]);
+	});
+}
\ No newline at end of file
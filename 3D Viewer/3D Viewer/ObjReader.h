@@ -0,0 +1,72 @@
+#pragma once
+
+#include "utils.h"
+#include "Vertex.h"
+#include "MeshData.h"
+
+#include <string_view>
+#include <unordered_map>
+
+// Streaming Wavefront OBJ + MTL reader.
+// Understands v (with optional r g b), vn, vc, f (any polygon, fan triangulated, negative indices),
+// usemtl and mtllib; other statements are skipped. Face corners that share the same
+// position / normal / material are merged into one vertex through a sharded hash map built in parallel.
+class ObjReader
+{
+public:
+	ObjReader(const std::string& filePath);
+
+	void Read(MeshData& mesh);
+
+	// false when at least one face corner came without a vn index, so the normals must be calculated
+	bool HasNormals() const;
+
+private:
+	struct Corner
+	{
+		unsigned int position;
+		unsigned int normal;
+		unsigned int material;
+
+		bool operator==(const Corner& other) const = default;
+	};
+
+	struct Material
+	{
+		std::string name;
+		glm::vec3 diffuseColor;
+	};
+
+	void ParseLine(std::string_view line, size_t lineNumber);
+	void ParseFace(const char* current, const char* end, size_t lineNumber);
+	void ReadMaterials(const std::string& libraryPath);
+	unsigned int FindOrAddMaterial(std::string_view name);
+
+	void BuildMesh(MeshData& mesh);
+	Vertex MakeVertex(const Corner& corner) const;
+
+	static size_t HashCorner(const Corner& corner);
+
+private:
+	std::string filePath;
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec3> colors;
+	std::vector<bool> hasColor;
+	size_t vertexColorCount = 0;
+
+	std::vector<Material> materials;
+	std::unordered_map<std::string, unsigned int> materialLookup;
+	unsigned int currentMaterial = 0;
+
+	std::vector<Corner> corners;
+	std::vector<Corner> faceCorners;
+	bool hasNormals = true;
+
+public:
+	static const size_t BLOCK_SIZE;
+	static const size_t SHARD_COUNT;
+	static const unsigned int NO_NORMAL;
+	static const glm::vec3 DEFAULT_COLOR;
+};
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline unsigned int GetWorkerCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Runs task(i) for every i in [0, taskCount) on all hardware threads.
+// Tasks are handed out one at a time, so uneven tasks still balance; the first exception is rethrown.
+template<typename Function>
+void ParallelFor(size_t taskCount, Function&& task)
+{
+	unsigned int workerCount = static_cast<unsigned int>(std::min<size_t>(GetWorkerCount(), taskCount));
+	if (workerCount <= 1)
+	{
+		for (size_t i = 0; i < taskCount; i++)
+			task(i);
+		return;
+	}
+
+	std::atomic<size_t> nextTask = 0;
+	std::exception_ptr firstException;
+	std::mutex exceptionMutex;
+
+	auto worker = [&]()
+	{
+		try
+		{
+			for (size_t i = nextTask++; i < taskCount; i = nextTask++)
+				task(i);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(exceptionMutex);
+			if (!firstException)
+				firstException = std::current_exception();
+			nextTask = taskCount;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(workerCount - 1);
+	for (unsigned int i = 1; i < workerCount; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& thread : threads)
+		thread.join();
+
+	if (firstException)
+		std::rethrow_exception(firstException);
+}
+
+// Splits [0, count) into blocks of grainSize elements and runs range(begin, end) for each of them in parallel.
+template<typename Function>
+void ParallelForRange(size_t count, size_t grainSize, Function&& range)
+{
+	grainSize = std::max<size_t>(grainSize, 1);
+	size_t blockCount = (count + grainSize - 1) / grainSize;
+
+	ParallelFor(blockCount, [&](size_t block)
+	{
+		size_t begin = block * grainSize;
+		range(begin, std::min(begin + grainSize, count));
+	});
+}
+
+// Sorts the whole range by sorting one block per worker and then merging neighbouring blocks in parallel rounds.
+template<typename Iterator, typename Compare = std::less<>>
+void ParallelSort(Iterator first, Iterator last, Compare compare = Compare())
+{
+	const size_t count = static_cast<size_t>(last - first);
+	const size_t blockSize = std::max<size_t>((count + GetWorkerCount() - 1) / GetWorkerCount(), 1 << 14);
+
+	ParallelForRange(count, blockSize, [&](size_t begin, size_t end)
+	{
+		std::sort(first + begin, first + end, compare);
+	});
+
+	for (size_t width = blockSize; width < count; width *= 2)
+	{
+		ParallelFor((count + 2 * width - 1) / (2 * width), [&](size_t pair)
+		{
+			size_t begin = pair * 2 * width;
+			size_t middle = std::min(begin + width, count);
+			size_t end = std::min(begin + 2 * width, count);
+			std::inplace_merge(first + begin, first + middle, first + end, compare);
+		});
+	}
+}
\ No newline at end of file
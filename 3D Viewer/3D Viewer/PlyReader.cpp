@@ -0,0 +1,445 @@
+#include "PlyReader.h"
+
+#include "Parallel.h"
+#include "TextParsing.h"
+
+#include <cstring>
+
+const size_t PlyReader::BATCH_SIZE = 1 << 16;
+
+template<typename T>
+static T Load(const uint8_t* data)
+{
+	T value;
+	std::memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+PlyReader::PlyReader(const std::string& filePath)
+	: filePath(filePath), file(filePath)
+{
+	ParseHeader();
+}
+
+bool PlyReader::HasNormals() const
+{
+	return hasNormals;
+}
+
+void PlyReader::Read(MeshData& mesh)
+{
+	const uint8_t* data = file.GetData() + dataOffset;
+
+	for (const auto& element : elements)
+	{
+		if (element.name == "vertex")
+			data = ReadVertices(element, data, mesh);
+		else if (element.name == "face")
+			data = ReadFaces(element, data, mesh);
+		else
+			data = SkipElement(element, data);
+	}
+
+	const size_t vertexCount = mesh.vertices.size();
+	std::atomic<bool> outOfRange = false;
+	ParallelForRange(mesh.indices.size(), BATCH_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			if (mesh.indices[i] >= vertexCount)
+				outOfRange = true;
+		}
+	});
+
+	if (outOfRange)
+	{
+		throw std::runtime_error(std::format("Face index out of range in model file {}", filePath).data());
+	}
+}
+
+void PlyReader::ParseHeader()
+{
+	const char* begin = reinterpret_cast<const char*>(file.GetData());
+	const char* end = begin + file.GetSize();
+
+	const char* current = begin;
+	Element* element = nullptr;
+	bool isFirstLine = true;
+
+	while (true)
+	{
+		const char* lineEnd = std::find(current, end, '\n');
+		if (lineEnd == end)
+			throw std::runtime_error(std::format("The PLY header of model file {} has no end_header", filePath).data());
+
+		const char* token = current;
+		std::string_view keyword = NextToken(token, lineEnd);
+		current = lineEnd + 1;
+
+		if (isFirstLine)
+		{
+			if (keyword != "ply")
+				throw std::runtime_error(std::format("The model file {} is not a PLY file", filePath).data());
+			isFirstLine = false;
+		}
+		else if (keyword == "format")
+		{
+			if (NextToken(token, lineEnd) != "binary_little_endian")
+				throw std::runtime_error(std::format("Only binary little-endian PLY files are supported: {}", filePath).data());
+		}
+		else if (keyword == "element")
+		{
+			Element newElement;
+			newElement.name = std::string(NextToken(token, lineEnd));
+			if (!ParseValue(NextToken(token, lineEnd), newElement.count))
+				throw std::runtime_error(std::format("Invalid element count for '{}' in model file {}", newElement.name, filePath).data());
+			newElement.stride = 0;
+
+			elements.push_back(std::move(newElement));
+			element = &elements.back();
+		}
+		else if (keyword == "property")
+		{
+			if (element == nullptr)
+				throw std::runtime_error(std::format("PLY property declared before any element in model file {}", filePath).data());
+
+			Property property;
+			std::string_view type = NextToken(token, lineEnd);
+			property.isList = type == "list";
+			if (property.isList)
+			{
+				property.countType = ParseType(NextToken(token, lineEnd));
+				type = NextToken(token, lineEnd);
+			}
+			property.type = ParseType(type);
+			property.name = std::string(NextToken(token, lineEnd));
+			property.offset = 0;
+
+			element->properties.push_back(std::move(property));
+		}
+		else if (keyword == "end_header")
+		{
+			break;
+		}
+	}
+
+	dataOffset = current - begin;
+
+	// records without lists have a fixed size, which allows batched and parallel conversion
+	for (auto& element : elements)
+	{
+		size_t offset = 0;
+		bool hasList = false;
+		for (auto& property : element.properties)
+		{
+			property.offset = offset;
+			hasList |= property.isList;
+			offset += TypeSize(property.type);
+		}
+		element.stride = hasList ? 0 : offset;
+	}
+}
+
+const uint8_t* PlyReader::ReadVertices(const Element& element, const uint8_t* data, MeshData& mesh)
+{
+	if (element.stride == 0)
+		throw std::runtime_error(std::format("List properties on vertices are not supported in model file {}", filePath).data());
+
+	struct Field
+	{
+		size_t offset;
+		PropertyType type;
+		float scale;
+	};
+
+	auto field = [&](std::initializer_list<std::string_view> names) -> Field
+	{
+		for (auto name : names)
+		{
+			if (const Property* property = FindProperty(element, name))
+			{
+				float scale = 1.0f;
+				if (property->type == PropertyType::UInt8)
+					scale = 1.0f / 255.0f;
+				else if (property->type == PropertyType::UInt16)
+					scale = 1.0f / 65535.0f;
+				return { property->offset, property->type, scale };
+			}
+		}
+		return { 0, PropertyType::Float32, 0.0f };
+	};
+
+	const Field x = field({ "x" }), y = field({ "y" }), z = field({ "z" });
+	const Field nx = field({ "nx" }), ny = field({ "ny" }), nz = field({ "nz" });
+	const Field red = field({ "red", "diffuse_red", "r" });
+	const Field green = field({ "green", "diffuse_green", "g" });
+	const Field blue = field({ "blue", "diffuse_blue", "b" });
+
+	if (x.scale == 0.0f || y.scale == 0.0f || z.scale == 0.0f)
+		throw std::runtime_error(std::format("The vertices in model file {} have no x, y, z properties", filePath).data());
+
+	hasNormals = nx.scale != 0.0f && ny.scale != 0.0f && nz.scale != 0.0f;
+	const bool hasColors = red.scale != 0.0f && green.scale != 0.0f && blue.scale != 0.0f;
+
+	const uint8_t* end = data + element.count * element.stride;
+	CheckBounds(end);
+
+	// the type check is the same for every record, so it is always predicted
+	auto fetch = [](const Field& field, const uint8_t* record)
+	{
+		if (field.type == PropertyType::Float32)
+			return Load<float>(record + field.offset);
+		if (field.type == PropertyType::UInt8)
+			return record[field.offset] * field.scale;
+		return static_cast<float>(ReadScalar(field.type, record + field.offset)) * field.scale;
+	};
+
+	mesh.vertices.resize(element.count);
+	ParallelForRange(element.count, BATCH_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const uint8_t* record = data + i * element.stride;
+			Vertex& vertex = mesh.vertices[i];
+
+			vertex.position = glm::vec3(fetch(x, record), fetch(y, record), fetch(z, record));
+			if (hasNormals)
+				vertex.normal = glm::vec3(fetch(nx, record), fetch(ny, record), fetch(nz, record));
+			if (hasColors)
+				vertex.color = glm::vec3(fetch(red, record), fetch(green, record), fetch(blue, record));
+		}
+	});
+
+	return end;
+}
+
+const uint8_t* PlyReader::ReadFaces(const Element& element, const uint8_t* data, MeshData& mesh)
+{
+	const Property* indexList = FindProperty(element, "vertex_indices");
+	if (indexList == nullptr)
+		indexList = FindProperty(element, "vertex_index");
+	if (indexList == nullptr || !indexList->isList)
+		throw std::runtime_error(std::format("The faces in model file {} have no vertex index list", filePath).data());
+
+	// fast path: the index list is the only property and every face has the same corner count as the first one
+	if (element.properties.size() == 1 && element.count > 0)
+	{
+		CheckBounds(data + TypeSize(indexList->countType));
+		unsigned int cornerCount = static_cast<unsigned int>(ReadScalar(indexList->countType, data));
+
+		if ((cornerCount == 3 || cornerCount == 4) && ReadFixedFaces(element, data, cornerCount, mesh))
+			return data + element.count * (TypeSize(indexList->countType) + cornerCount * TypeSize(indexList->type));
+	}
+
+	return ReadVariableFaces(element, data, mesh);
+}
+
+bool PlyReader::ReadFixedFaces(const Element& element, const uint8_t* data, unsigned int cornerCount, MeshData& mesh)
+{
+	const Property& indexList = element.properties[0];
+	const size_t countSize = TypeSize(indexList.countType);
+	const size_t indexSize = TypeSize(indexList.type);
+	const size_t stride = countSize + cornerCount * indexSize;
+
+	if (data + element.count * stride > file.GetData() + file.GetSize())
+		return false;
+
+	const size_t indicesPerFace = cornerCount == 3 ? 3 : 6;
+	mesh.indices.resize(element.count * indicesPerFace);
+
+	auto readIndex = [&](const uint8_t* index) -> unsigned int
+	{
+		if (indexList.type == PropertyType::Int32 || indexList.type == PropertyType::UInt32)
+			return Load<uint32_t>(index);
+		return static_cast<unsigned int>(ReadScalar(indexList.type, index));
+	};
+
+	std::atomic<bool> mismatch = false;
+	ParallelForRange(element.count, BATCH_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t face = begin; face < end; face++)
+		{
+			const uint8_t* record = data + face * stride;
+			if (static_cast<unsigned int>(ReadScalar(indexList.countType, record)) != cornerCount)
+			{
+				mismatch = true;
+				return;
+			}
+
+			const uint8_t* corners = record + countSize;
+			unsigned int* destination = &mesh.indices[face * indicesPerFace];
+			destination[0] = readIndex(corners);
+			destination[1] = readIndex(corners + indexSize);
+			destination[2] = readIndex(corners + 2 * indexSize);
+
+			if (cornerCount == 4)
+			{
+				destination[3] = destination[0];
+				destination[4] = destination[2];
+				destination[5] = readIndex(corners + 3 * indexSize);
+			}
+		}
+	});
+
+	if (mismatch)
+		mesh.indices.clear();
+
+	return !mismatch;
+}
+
+const uint8_t* PlyReader::ReadVariableFaces(const Element& element, const uint8_t* data, MeshData& mesh)
+{
+	mesh.indices.clear();
+	mesh.indices.reserve(element.count * 3);
+
+	std::vector<unsigned int> polygon;
+	for (size_t face = 0; face < element.count; face++)
+	{
+		for (const auto& property : element.properties)
+		{
+			if (!property.isList)
+			{
+				data += TypeSize(property.type);
+				continue;
+			}
+
+			CheckBounds(data + TypeSize(property.countType));
+			size_t count = static_cast<size_t>(ReadScalar(property.countType, data));
+			data += TypeSize(property.countType);
+
+			const size_t itemSize = TypeSize(property.type);
+			CheckBounds(data + count * itemSize);
+
+			if (property.name == "vertex_indices" || property.name == "vertex_index")
+			{
+				polygon.resize(count);
+				for (size_t i = 0; i < count; i++)
+					polygon[i] = static_cast<unsigned int>(ReadScalar(property.type, data + i * itemSize));
+
+				for (size_t i = 1; i + 1 < count; i++)
+				{
+					mesh.indices.push_back(polygon[0]);
+					mesh.indices.push_back(polygon[i]);
+					mesh.indices.push_back(polygon[i + 1]);
+				}
+			}
+
+			data += count * itemSize;
+		}
+	}
+
+	CheckBounds(data);
+	return data;
+}
+
+const uint8_t* PlyReader::SkipElement(const Element& element, const uint8_t* data)
+{
+	if (element.stride != 0)
+	{
+		data += element.count * element.stride;
+		CheckBounds(data);
+		return data;
+	}
+
+	for (size_t i = 0; i < element.count; i++)
+	{
+		for (const auto& property : element.properties)
+		{
+			if (property.isList)
+			{
+				CheckBounds(data + TypeSize(property.countType));
+				size_t count = static_cast<size_t>(ReadScalar(property.countType, data));
+				data += TypeSize(property.countType) + count * TypeSize(property.type);
+			}
+			else
+			{
+				data += TypeSize(property.type);
+			}
+		}
+	}
+
+	CheckBounds(data);
+	return data;
+}
+
+const PlyReader::Property* PlyReader::FindProperty(const Element& element, std::string_view name) const
+{
+	for (const auto& property : element.properties)
+	{
+		if (property.name == name)
+			return &property;
+	}
+	return nullptr;
+}
+
+void PlyReader::CheckBounds(const uint8_t* end) const
+{
+	if (end > file.GetData() + file.GetSize())
+		throw std::runtime_error(std::format("Unexpected end of model file {}", filePath).data());
+}
+
+PlyReader::PropertyType PlyReader::ParseType(std::string_view name)
+{
+	if (name == "char" || name == "int8")
+		return PropertyType::Int8;
+	if (name == "uchar" || name == "uint8")
+		return PropertyType::UInt8;
+	if (name == "short" || name == "int16")
+		return PropertyType::Int16;
+	if (name == "ushort" || name == "uint16")
+		return PropertyType::UInt16;
+	if (name == "int" || name == "int32")
+		return PropertyType::Int32;
+	if (name == "uint" || name == "uint32")
+		return PropertyType::UInt32;
+	if (name == "float" || name == "float32")
+		return PropertyType::Float32;
+	if (name == "double" || name == "float64")
+		return PropertyType::Float64;
+
+	throw std::runtime_error(std::format("Unknown PLY property type '{}'", name).data());
+}
+
+size_t PlyReader::TypeSize(PropertyType type)
+{
+	switch (type)
+	{
+	case PropertyType::Int8:
+	case PropertyType::UInt8:
+		return 1;
+	case PropertyType::Int16:
+	case PropertyType::UInt16:
+		return 2;
+	case PropertyType::Int32:
+	case PropertyType::UInt32:
+	case PropertyType::Float32:
+		return 4;
+	case PropertyType::Float64:
+		return 8;
+	}
+	return 0;
+}
+
+double PlyReader::ReadScalar(PropertyType type, const uint8_t* data)
+{
+	switch (type)
+	{
+	case PropertyType::Int8:
+		return Load<int8_t>(data);
+	case PropertyType::UInt8:
+		return Load<uint8_t>(data);
+	case PropertyType::Int16:
+		return Load<int16_t>(data);
+	case PropertyType::UInt16:
+		return Load<uint16_t>(data);
+	case PropertyType::Int32:
+		return Load<int32_t>(data);
+	case PropertyType::UInt32:
+		return Load<uint32_t>(data);
+	case PropertyType::Float32:
+		return Load<float>(data);
+	case PropertyType::Float64:
+		return Load<double>(data);
+	}
+	return 0.0;
+}
\ No newline at end of file
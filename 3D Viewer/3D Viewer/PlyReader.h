@@ -0,0 +1,79 @@
+#pragma once
+
+#include "utils.h"
+#include "Vertex.h"
+#include "MeshData.h"
+
+#include <string_view>
+
+// Reader for binary little-endian PLY files as written by 3D scanners.
+// The file is mapped and every element block is converted in large parallel batches;
+// the property layout is resolved once from the header, so the per-record work is plain loads.
+// Triangle and quad face lists take a fixed-stride fast path, anything else is fan triangulated.
+class PlyReader
+{
+public:
+	PlyReader(const std::string& filePath);
+
+	void Read(MeshData& mesh);
+
+	bool HasNormals() const;
+
+private:
+	enum class PropertyType
+	{
+		Int8,
+		UInt8,
+		Int16,
+		UInt16,
+		Int32,
+		UInt32,
+		Float32,
+		Float64
+	};
+
+	struct Property
+	{
+		std::string name;
+		PropertyType type;
+		bool isList;
+		PropertyType countType;
+		size_t offset;
+	};
+
+	struct Element
+	{
+		std::string name;
+		size_t count;
+		std::vector<Property> properties;
+		// 0 when the element contains a list, so its records have different sizes
+		size_t stride;
+	};
+
+	void ParseHeader();
+
+	const uint8_t* ReadVertices(const Element& element, const uint8_t* data, MeshData& mesh);
+	const uint8_t* ReadFaces(const Element& element, const uint8_t* data, MeshData& mesh);
+	const uint8_t* SkipElement(const Element& element, const uint8_t* data);
+
+	bool ReadFixedFaces(const Element& element, const uint8_t* data, unsigned int cornerCount, MeshData& mesh);
+	const uint8_t* ReadVariableFaces(const Element& element, const uint8_t* data, MeshData& mesh);
+
+	const Property* FindProperty(const Element& element, std::string_view name) const;
+	void CheckBounds(const uint8_t* end) const;
+
+	static PropertyType ParseType(std::string_view name);
+	static size_t TypeSize(PropertyType type);
+	static double ReadScalar(PropertyType type, const uint8_t* data);
+
+private:
+	std::string filePath;
+	MappedFile file;
+
+	std::vector<Element> elements;
+	size_t dataOffset = 0;
+	bool hasNormals = false;
+
+public:
+	static const size_t BATCH_SIZE;
+};
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include "RayCaster.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define RAY_CASTER_SIMD
+	#include <immintrin.h>
+#endif
+
+const size_t RayCaster::BATCH_GRAIN_SIZE = 64;
+
+// 3 pending lanes on each of 64 levels, which binned builds stay well under; degenerate trees spill to the heap
+static const size_t STACK_SIZE = 3 * 64;
+
+// four triangles as one corner and two edges, component by component
+struct TrianglePacket
+{
+	float aX[4], aY[4], aZ[4];
+	float edge1X[4], edge1Y[4], edge1Z[4];
+	float edge2X[4], edge2Y[4], edge2Z[4];
+};
+
+bool RayHit::IsHit() const
+{
+	return triangle != std::numeric_limits<uint32_t>::max();
+}
+
+// returns a bit per lane whose box the ray enters before maxDistance, with the distances it enters them at
+static int IntersectBoxes(const Bvh::WideNode& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float* entries)
+{
+#ifdef RAY_CASTER_SIMD
+	const __m128 originX = _mm_set1_ps(origin.x), originY = _mm_set1_ps(origin.y), originZ = _mm_set1_ps(origin.z);
+	const __m128 inverseX = _mm_set1_ps(inverseDirection.x), inverseY = _mm_set1_ps(inverseDirection.y), inverseZ = _mm_set1_ps(inverseDirection.z);
+
+	const __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), originX), inverseX);
+	const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), originX), inverseX);
+	const __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), originY), inverseY);
+	const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), originY), inverseY);
+	const __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), originZ), inverseZ);
+	const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), originZ), inverseZ);
+
+	const __m128 entry = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+	const __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(maxDistance)));
+
+	_mm_storeu_ps(entries, entry);
+	return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+#else
+	int mask = 0;
+	for (int lane = 0; lane < 4; lane++)
+	{
+		const float x0 = (node.minX[lane] - origin.x) * inverseDirection.x, x1 = (node.maxX[lane] - origin.x) * inverseDirection.x;
+		const float y0 = (node.minY[lane] - origin.y) * inverseDirection.y, y1 = (node.maxY[lane] - origin.y) * inverseDirection.y;
+		const float z0 = (node.minZ[lane] - origin.z) * inverseDirection.z, z1 = (node.maxZ[lane] - origin.z) * inverseDirection.z;
+
+		const float entry = std::max({ std::min(x0, x1), std::min(y0, y1), std::min(z0, z1), 0.0f });
+		const float exit = std::min({ std::max(x0, x1), std::max(y0, y1), std::max(z0, z1), maxDistance });
+
+		entries[lane] = entry;
+		if (entry <= exit)
+			mask |= 1 << lane;
+	}
+	return mask;
+#endif
+}
+
+// Moller-Trumbore on four triangles; returns a bit per lane hit in (0, maxDistance), with the distances
+// and barycentrics of the hits. Degenerate triangles, and the ray running along a triangle, never hit.
+static int IntersectTriangles(const TrianglePacket& packet, const Ray& ray, float maxDistance, float* distances, float* us, float* vs)
+{
+#ifdef RAY_CASTER_SIMD
+	const __m128 directionX = _mm_set1_ps(ray.direction.x), directionY = _mm_set1_ps(ray.direction.y), directionZ = _mm_set1_ps(ray.direction.z);
+	const __m128 edge1X = _mm_load_ps(packet.edge1X), edge1Y = _mm_load_ps(packet.edge1Y), edge1Z = _mm_load_ps(packet.edge1Z);
+	const __m128 edge2X = _mm_load_ps(packet.edge2X), edge2Y = _mm_load_ps(packet.edge2Y), edge2Z = _mm_load_ps(packet.edge2Z);
+
+	// p = direction x edge2
+	const __m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+	const __m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+	const __m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+	const __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+	const __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+	// s = origin - a
+	const __m128 sX = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(packet.aX));
+	const __m128 sY = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(packet.aY));
+	const __m128 sZ = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(packet.aZ));
+	const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, pX), _mm_mul_ps(sY, pY)), _mm_mul_ps(sZ, pZ)), inverseDeterminant);
+
+	// q = s x edge1
+	const __m128 qX = _mm_sub_ps(_mm_mul_ps(sY, edge1Z), _mm_mul_ps(sZ, edge1Y));
+	const __m128 qY = _mm_sub_ps(_mm_mul_ps(sZ, edge1X), _mm_mul_ps(sX, edge1Z));
+	const __m128 qZ = _mm_sub_ps(_mm_mul_ps(sX, edge1Y), _mm_mul_ps(sY, edge1X));
+	const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), inverseDeterminant);
+	const __m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverseDeterminant);
+
+	// NaNs from a zero determinant fail every comparison
+	const __m128 zero = _mm_setzero_ps();
+	__m128 hit = _mm_cmpneq_ps(determinant, zero);
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	hit = _mm_and_ps(hit, _mm_cmpgt_ps(distance, zero));
+	hit = _mm_and_ps(hit, _mm_cmplt_ps(distance, _mm_set1_ps(maxDistance)));
+
+	_mm_storeu_ps(distances, distance);
+	_mm_storeu_ps(us, u);
+	_mm_storeu_ps(vs, v);
+	return _mm_movemask_ps(hit);
+#else
+	int mask = 0;
+	for (int lane = 0; lane < 4; lane++)
+	{
+		const glm::vec3 edge1(packet.edge1X[lane], packet.edge1Y[lane], packet.edge1Z[lane]);
+		const glm::vec3 edge2(packet.edge2X[lane], packet.edge2Y[lane], packet.edge2Z[lane]);
+
+		const glm::vec3 p = glm::cross(ray.direction, edge2);
+		const float determinant = glm::dot(edge1, p);
+		if (determinant == 0.0f)
+			continue;
+		const float inverseDeterminant = 1.0f / determinant;
+
+		const glm::vec3 s = ray.origin - glm::vec3(packet.aX[lane], packet.aY[lane], packet.aZ[lane]);
+		const glm::vec3 q = glm::cross(s, edge1);
+		us[lane] = glm::dot(s, p) * inverseDeterminant;
+		vs[lane] = glm::dot(ray.direction, q) * inverseDeterminant;
+		distances[lane] = glm::dot(edge2, q) * inverseDeterminant;
+
+		if (us[lane] >= 0.0f && vs[lane] >= 0.0f && us[lane] + vs[lane] <= 1.0f && distances[lane] > 0.0f && distances[lane] < maxDistance)
+			mask |= 1 << lane;
+	}
+	return mask;
+#endif
+}
+
+RayCaster::RayCaster(const MeshData& mesh, const Bvh& bvh)
+	: mesh(mesh), bvh(bvh), vertices(mesh.GetVertexData()), indices(mesh.GetIndexData() + bvh.GetFirstIndex())
+{
+	if (!bvh.GetNodes().empty() && bvh.GetWideNodes().empty())
+		throw std::runtime_error("Rays are only cast through wide BVH nodes, call Bvh::BuildWideNodes() first");
+}
+
+RayHit RayCaster::Intersect(const Ray& ray, float maxDistance) const
+{
+	RayHit hit;
+	hit.distance = maxDistance;
+
+	const std::vector<Bvh::WideNode>& wideNodes = bvh.GetWideNodes();
+	if (wideNodes.empty())
+		return hit;
+
+	// zero components become infinities, which the slab test handles
+	const glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+	struct StackEntry
+	{
+		uint32_t node;
+		float entry;
+	};
+	StackEntry stack[STACK_SIZE];
+	size_t stackSize = 0;
+	stack[stackSize++] = { 0, 0.0f };
+	// the top of the stack once the array is full
+	std::vector<StackEntry> overflow;
+
+	while (stackSize > 0 || !overflow.empty())
+	{
+		StackEntry current;
+		if (!overflow.empty())
+		{
+			current = overflow.back();
+			overflow.pop_back();
+		}
+		else
+			current = stack[--stackSize];
+		// a closer hit was found since it was pushed
+		if (current.entry > hit.distance)
+			continue;
+
+		const Bvh::WideNode& node = wideNodes[current.node];
+		float entries[4];
+		const int mask = IntersectBoxes(node, ray.origin, inverseDirection, hit.distance, entries);
+
+		StackEntry children[4];
+		size_t childCount = 0;
+		for (int lane = 0; lane < 4; lane++)
+		{
+			// the inverted boxes of empty lanes don't reliably fail the slab test
+			if (!(mask & (1 << lane)) || node.children[lane] == Bvh::EMPTY_LANE)
+				continue;
+
+			if (node.counts[lane] > 0)
+				IntersectLeaf(node.children[lane], node.counts[lane], ray, hit);
+			else
+				children[childCount++] = { node.children[lane], entries[lane] };
+		}
+
+		// the nearest child is pushed last, so it is visited first
+		std::sort(children, children + childCount, [](const StackEntry& first, const StackEntry& second) { return first.entry > second.entry; });
+		for (size_t child = 0; child < childCount; child++)
+		{
+			if (stackSize < STACK_SIZE)
+				stack[stackSize++] = children[child];
+			else
+				overflow.push_back(children[child]);
+		}
+	}
+
+	if (hit.IsHit())
+		hit.position = ray.origin + ray.direction * hit.distance;
+	return hit;
+}
+
+void RayCaster::Intersect(const Ray* rays, size_t count, RayHit* hits) const
+{
+	ParallelForRange(count, BATCH_GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t ray = begin; ray < end; ray++)
+			hits[ray] = Intersect(rays[ray]);
+	});
+}
+
+Ray RayCaster::FromCursor(const glm::vec2& cursor, const glm::vec2& viewportSize, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+{
+	// window coordinates grow downwards, normalized device coordinates upwards
+	const glm::vec2 ndc(cursor.x / viewportSize.x * 2.0f - 1.0f, 1.0f - cursor.y / viewportSize.y * 2.0f);
+	const glm::mat4 inverse = glm::inverse(projectionMatrix * viewMatrix);
+
+	glm::vec4 nearPoint = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+	nearPoint /= nearPoint.w;
+	farPoint /= farPoint.w;
+
+	return { glm::vec3(nearPoint), glm::normalize(glm::vec3(farPoint - nearPoint)) };
+}
+
+// tests the triangles of a leaf four at a time, keeping the closest hit
+void RayCaster::IntersectLeaf(uint32_t first, uint32_t count, const Ray& ray, RayHit& hit) const
+{
+	const std::vector<uint32_t>& triangles = bvh.GetTriangles();
+
+	for (uint32_t group = first; group < first + count; group += 4)
+	{
+		// missing lanes stay degenerate and never hit
+		alignas(16) TrianglePacket packet = {};
+		for (uint32_t lane = 0; lane < 4 && group + lane < first + count; lane++)
+		{
+			const uint32_t triangle = triangles[group + lane];
+			const glm::vec3 a = GetPosition(triangle, 0);
+			const glm::vec3 edge1 = GetPosition(triangle, 1) - a;
+			const glm::vec3 edge2 = GetPosition(triangle, 2) - a;
+
+			packet.aX[lane] = a.x;
+			packet.aY[lane] = a.y;
+			packet.aZ[lane] = a.z;
+			packet.edge1X[lane] = edge1.x;
+			packet.edge1Y[lane] = edge1.y;
+			packet.edge1Z[lane] = edge1.z;
+			packet.edge2X[lane] = edge2.x;
+			packet.edge2Y[lane] = edge2.y;
+			packet.edge2Z[lane] = edge2.z;
+		}
+
+		float distances[4], us[4], vs[4];
+		const int mask = IntersectTriangles(packet, ray, hit.distance, distances, us, vs);
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			if ((mask & (1 << lane)) && distances[lane] < hit.distance)
+			{
+				hit.triangle = triangles[group + lane];
+				hit.u = us[lane];
+				hit.v = vs[lane];
+				hit.distance = distances[lane];
+			}
+		}
+	}
+}
+
+glm::vec3 RayCaster::GetPosition(uint32_t triangle, size_t corner) const
+{
+	const unsigned int vertex = indices[3 * triangle + corner];
+	return vertices != nullptr ? vertices[vertex].position : mesh.streams.GetPosition(vertex);
+}
\ No newline at end of file
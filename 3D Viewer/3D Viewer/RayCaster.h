@@ -0,0 +1,61 @@
+#pragma once
+
+#include "utils.h"
+#include "MeshData.h"
+#include "Bvh.h"
+
+#include <limits>
+
+struct Ray
+{
+	glm::vec3 origin;
+	// doesn't have to be normalized, distances are then measured in units of its length
+	glm::vec3 direction;
+};
+
+// The nearest triangle a ray hits
+struct RayHit
+{
+	// counted from the first index of the level the BVH covers
+	uint32_t triangle = std::numeric_limits<uint32_t>::max();
+	// the hit point is (1 - u - v) * a + u * b + v * c of the triangle's corners
+	float u = 0.0f, v = 0.0f;
+	float distance = std::numeric_limits<float>::max();
+	glm::vec3 position = glm::vec3(0.0f);
+
+	bool IsHit() const;
+};
+
+// Casts rays against the triangles of a mesh through the 4-wide nodes of its BVH. The four boxes
+// of a node, and the triangles of a leaf four at a time, are tested with SSE; the triangles are
+// read through the index buffer, so nothing is stored per triangle besides the BVH itself.
+// Both sides of a triangle are hit.
+class RayCaster
+{
+public:
+	// needs Bvh::BuildWideNodes(); both have to outlive the caster
+	RayCaster(const MeshData& mesh, const Bvh& bvh);
+
+	// the ray, in the space of the mesh, is hit from its origin to maxDistance
+	RayHit Intersect(const Ray& ray, float maxDistance = std::numeric_limits<float>::max()) const;
+	// every ray on its own, in parallel
+	void Intersect(const Ray* rays, size_t count, RayHit* hits) const;
+
+	// the world space ray through a cursor position, in window pixels from the top left,
+	// starting on the near plane
+	static Ray FromCursor(const glm::vec2& cursor, const glm::vec2& viewportSize, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+
+private:
+	void IntersectLeaf(uint32_t first, uint32_t count, const Ray& ray, RayHit& hit) const;
+	glm::vec3 GetPosition(uint32_t triangle, size_t corner) const;
+
+private:
+	const MeshData& mesh;
+	const Bvh& bvh;
+	const Vertex* vertices;
+	const unsigned int* indices;
+
+public:
+	// batched rays are handed out to the threads this many at a time
+	static const size_t BATCH_GRAIN_SIZE;
+};
\ No newline at end of file
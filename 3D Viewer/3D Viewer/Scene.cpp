@@ -0,0 +1,41 @@
+#include "Scene.h"
+
+#include <algorithm>
+
+void Scene::Add(const MeshData& mesh, const BufferArena::Allocation& allocation, const glm::mat4& modelMatrix)
+{
+	Object object = { allocation, modelMatrix, ObjectUniforms(modelMatrix), LodSelector(mesh) };
+
+	auto position = std::upper_bound(objects.begin(), objects.end(), object.allocation.page,
+		[](size_t page, const Object& other) { return page < other.allocation.page; });
+	objects.insert(position, object);
+}
+
+void Scene::SelectLods(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float viewportHeight)
+{
+	for (Object& object : objects)
+		object.lodSelector.Select(viewMatrix * object.modelMatrix, projectionMatrix, viewportHeight);
+}
+
+void Scene::Render(UniformBuffers& uniformBuffers)
+{
+	arena.BeginDraw();
+
+	for (const Object& object : objects)
+	{
+		uniformBuffers.SetObject(object.uniforms);
+		arena.Draw(object.allocation, object.lodSelector.GetLevel());
+	}
+
+	arena.EndDraw();
+}
+
+BufferArena& Scene::GetArena()
+{
+	return arena;
+}
+
+size_t Scene::GetObjectCount() const
+{
+	return objects.size();
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "utils.h"
+#include "BufferArena.h"
+#include "LodSelector.h"
+#include "UniformBuffers.h"
+
+// Many static meshes drawn from one BufferArena.
+// Objects are kept ordered by arena page, so a frame binds the shared VAO once
+// and every page once, whatever the number of objects.
+class Scene
+{
+public:
+	// the mesh has to be uploaded into the allocation, which comes from GetArena()
+	void Add(const MeshData& mesh, const BufferArena::Allocation& allocation, const glm::mat4& modelMatrix);
+	BufferArena& GetArena();
+
+	// picks every object's level of detail for this frame
+	void SelectLods(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float viewportHeight);
+	// the shaders must be in use; only the object uniforms change per object
+	void Render(UniformBuffers& uniformBuffers);
+
+	size_t GetObjectCount() const;
+
+private:
+	struct Object
+	{
+		BufferArena::Allocation allocation;
+		glm::mat4 modelMatrix;
+		// the objects never move, so these are only computed once
+		ObjectUniforms uniforms;
+		LodSelector lodSelector;
+	};
+
+private:
+	BufferArena arena;
+	std::vector<Object> objects;
+};
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "SceneDescription.h"
+#include "TextParsing.h"
+
+const std::string SceneDescription::EXTENSION = ".scene";
+
+std::vector<SceneEntry> SceneDescription::Read(const std::string& filePath)
+{
+	std::ifstream file(filePath);
+	if (!file.is_open())
+		throw std::runtime_error(std::format("Could not open scene file {}", filePath).data());
+
+	const std::filesystem::path directory = std::filesystem::path(filePath).parent_path();
+	std::vector<SceneEntry> entries;
+
+	std::string line;
+	for (size_t lineNumber = 1; std::getline(file, line); lineNumber++)
+	{
+		const char* current = line.data();
+		const char* end = current + std::min(line.size(), line.find('#'));
+
+		std::string_view keyword = NextToken(current, end);
+		if (keyword.empty())
+			continue;
+		if (keyword != "model")
+			throw std::runtime_error(std::format("Unknown statement '{}' on line {} of scene file {}", keyword, lineNumber, filePath).data());
+
+		std::string_view path = NextToken(current, end);
+		if (path.empty())
+			throw std::runtime_error(std::format("Missing model path on line {} of scene file {}", lineNumber, filePath).data());
+
+		auto readVector = [&](int count)
+		{
+			glm::vec3 value;
+			for (int axis = 0; axis < count; axis++)
+			{
+				std::string_view token = NextToken(current, end);
+				if (!ParseValue(token, value[axis]))
+					throw std::runtime_error(std::format("Invalid value '{}' on line {} of scene file {}", token, lineNumber, filePath).data());
+			}
+			return count == 1 ? glm::vec3(value.x) : value;
+		};
+
+		glm::vec3 position(0.0f), rotation(0.0f), scale(1.0f);
+		for (std::string_view property = NextToken(current, end); !property.empty(); property = NextToken(current, end))
+		{
+			if (property == "position")
+				position = readVector(3);
+			else if (property == "rotation")
+				rotation = readVector(3);
+			else if (property == "scale")
+			{
+				// a single factor scales uniformly
+				const char* afterFirst = current;
+				NextToken(afterFirst, end);
+				float ignored;
+				bool uniform = !ParseValue(NextToken(afterFirst, end), ignored);
+				scale = readVector(uniform ? 1 : 3);
+			}
+			else
+				throw std::runtime_error(std::format("Unknown property '{}' on line {} of scene file {}", property, lineNumber, filePath).data());
+		}
+
+		glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), position);
+		modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		modelMatrix = glm::scale(modelMatrix, scale);
+
+		entries.push_back({ (directory / std::filesystem::path(path)).string(), modelMatrix });
+	}
+
+	return entries;
+}
+
+bool SceneDescription::HasSceneExtension(const std::string& filePath)
+{
+	return std::filesystem::path(filePath).extension() == EXTENSION;
+}
\ No newline at end of file
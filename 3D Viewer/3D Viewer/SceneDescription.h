@@ -0,0 +1,22 @@
+#pragma once
+
+#include "utils.h"
+
+struct SceneEntry
+{
+	std::string filePath;
+	glm::mat4 modelMatrix;
+};
+
+// Reader for .scene files, one object per line:
+//	model <path> [position x y z] [rotation x y z] [scale s | scale x y z]
+// Paths are relative to the scene file, rotations are in degrees and '#' starts a comment.
+class SceneDescription
+{
+public:
+	static std::vector<SceneEntry> Read(const std::string& filePath);
+	static bool HasSceneExtension(const std::string& filePath);
+
+public:
+	static const std::string EXTENSION;
+};
\ No newline at end of file
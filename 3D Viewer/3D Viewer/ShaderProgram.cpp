@@ -1,5 +1,54 @@
 #include "ShaderProgram.h"
 
+#include "UniformBuffers.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+const uint32_t ShaderProgram::NO_UNIFORM = std::numeric_limits<uint32_t>::max();
+
+// how many 4-byte words a value of the type takes
+static size_t GetValueWords(GLenum type)
+{
+	switch (type)
+	{
+	case GL_FLOAT_VEC2:
+	case GL_INT_VEC2:
+		return 2;
+	case GL_FLOAT_VEC3:
+	case GL_INT_VEC3:
+		return 3;
+	case GL_FLOAT_VEC4:
+	case GL_INT_VEC4:
+	case GL_FLOAT_MAT2:
+		return 4;
+	case GL_FLOAT_MAT3:
+		return 9;
+	case GL_FLOAT_MAT4:
+		return 16;
+	default:
+		// scalars, booleans and samplers
+		return 1;
+	}
+}
+
+UniformName UniformName::FromString(std::string_view name)
+{
+	return UniformName(Hash(name));
+}
+
+uint32_t UniformName::GetHash() const
+{
+	return hash;
+}
+
+bool UniformHandle::IsValid() const
+{
+	return index != ShaderProgram::NO_UNIFORM;
+}
+
 ShaderProgram::ShaderProgram(const std::string& vertexPath, const std::string& fragmentPath)
 {
 	Init(vertexPath, fragmentPath);
@@ -7,12 +56,12 @@ ShaderProgram::ShaderProgram(const std::string& vertexPath, const std::string& f
 
 ShaderProgram::~ShaderProgram()
 {
-	GLCall(glDeleteProgram(ID));
+	GLState::DeleteProgram(ID);
 }
 
 void ShaderProgram::Use() const
 {
-	GLCall(glUseProgram(ID));
+	GLState::UseProgram(ID);
 }
 
 GLuint ShaderProgram::GetID() const
@@ -20,24 +69,71 @@ GLuint ShaderProgram::GetID() const
 	return ID;
 }
 
-void ShaderProgram::SetInt(const std::string& locationName, int value) const
+UniformHandle ShaderProgram::GetUniform(UniformName name) const
+{
+	auto uniform = std::lower_bound(uniforms.begin(), uniforms.end(), name.GetHash(),
+		[](const Uniform& uniform, uint32_t hash) { return uniform.nameHash < hash; });
+	if (uniform == uniforms.end() || uniform->nameHash != name.GetHash())
+		return { NO_UNIFORM };
+
+	return { static_cast<uint32_t>(uniform - uniforms.begin()) };
+}
+
+size_t ShaderProgram::GetUniformCount() const
+{
+	return uniforms.size();
+}
+
+void ShaderProgram::SetInt(UniformHandle uniform, int value) const
+{
+	if (UpdateValue(uniform, &value, 1))
+	{
+		GLCall(glUniform1i(uniforms[uniform.index].location, value));
+	}
+}
+
+void ShaderProgram::SetFloat(UniformHandle uniform, float value) const
+{
+	if (UpdateValue(uniform, &value, 1))
+	{
+		GLCall(glUniform1f(uniforms[uniform.index].location, value));
+	}
+}
+
+void ShaderProgram::SetVec3(UniformHandle uniform, const glm::vec3& value) const
 {
-	GLCall(glUniform1i(glGetUniformLocation(ID, locationName.c_str()), value));
+	if (UpdateValue(uniform, &value[0], 3))
+	{
+		GLCall(glUniform3fv(uniforms[uniform.index].location, 1, &value[0]));
+	}
 }
 
-void ShaderProgram::SetFloat(const std::string& locationName, float value) const
+void ShaderProgram::SetMat4(UniformHandle uniform, const glm::mat4& mat) const
 {
-	GLCall(glUniform1f(glGetUniformLocation(ID, locationName.c_str()), value));
+	if (UpdateValue(uniform, &mat[0][0], 16))
+	{
+		GLCall(glUniformMatrix4fv(uniforms[uniform.index].location, 1, GL_FALSE, &mat[0][0]));
+	}
 }
 
-void ShaderProgram::SetVec3(const std::string& locationName, const glm::vec3& value) const
+void ShaderProgram::SetInt(UniformName name, int value) const
 {
-	GLCall(glUniform3fv(glGetUniformLocation(ID, locationName.c_str()), 1, &value[0]));
+	SetInt(GetUniform(name), value);
 }
 
-void ShaderProgram::SetMat4(const std::string& locationName, const glm::mat4& mat) const
+void ShaderProgram::SetFloat(UniformName name, float value) const
 {
-	GLCall(glUniformMatrix4fv(glGetUniformLocation(ID, locationName.c_str()), 1, GL_FALSE, &mat[0][0]));
+	SetFloat(GetUniform(name), value);
+}
+
+void ShaderProgram::SetVec3(UniformName name, const glm::vec3& value) const
+{
+	SetVec3(GetUniform(name), value);
+}
+
+void ShaderProgram::SetMat4(UniformName name, const glm::mat4& mat) const
+{
+	SetMat4(GetUniform(name), mat);
 }
 
 void ShaderProgram::Init(const std::string& vertexPath, const std::string& fragmentPath)
@@ -89,6 +185,8 @@ void ShaderProgram::Init(const std::string& vertexPath, const std::string& fragm
 	GLCall(glAttachShader(ID, fragment));
 	GLCall(glLinkProgram(ID));
 	CheckCompileErrors(ID, "PROGRAM");
+	UniformBuffers::BindBlocks(ID);
+	ReflectUniforms();
 
 	GLCall(glDeleteShader(vertex));
 	GLCall(glDeleteShader(fragment));
@@ -121,4 +219,59 @@ void ShaderProgram::CheckCompileErrors(GLuint shaderStencilTesting, const std::s
 				<< std::endl;
 		}
 	}
+}
+
+void ShaderProgram::ReflectUniforms()
+{
+	GLint count = 0, maxLength = 0;
+	GLCall(glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count));
+	GLCall(glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength));
+
+	std::vector<GLchar> name(std::max(maxLength, 1));
+	uint32_t valueWords = 0;
+	for (GLint index = 0; index < count; index++)
+	{
+		GLsizei length;
+		GLint size;
+		GLenum type;
+		GLCall(glGetActiveUniform(ID, index, (GLsizei)name.size(), &length, &size, &type, name.data()));
+
+		// members of uniform blocks have no location, they are set through UniformBuffers
+		const GLint location = glGetUniformLocation(ID, name.data());
+		if (location < 0)
+			continue;
+
+		// arrays are reported by their first element; only that one is cached
+		std::string_view uniformName(name.data(), length);
+		if (uniformName.ends_with("[0]"))
+			uniformName.remove_suffix(3);
+
+		uniforms.push_back({ UniformName::FromString(uniformName).GetHash(), location, type, valueWords });
+		valueWords += static_cast<uint32_t>(GetValueWords(type));
+	}
+
+	std::sort(uniforms.begin(), uniforms.end(), [](const Uniform& first, const Uniform& second) { return first.nameHash < second.nameHash; });
+	auto collision = std::adjacent_find(uniforms.begin(), uniforms.end(), [](const Uniform& first, const Uniform& second) { return first.nameHash == second.nameHash; });
+	if (collision != uniforms.end())
+		throw std::runtime_error(std::format("Two uniforms of program {} have the same name hash {:x}", ID, collision->nameHash).data());
+
+	cachedValues.assign(valueWords, 0);
+	hasValue.assign(uniforms.size(), false);
+}
+
+bool ShaderProgram::UpdateValue(UniformHandle uniform, const void* value, size_t words) const
+{
+	if (!uniform.IsValid())
+		return false;
+	// a value of the wrong type is left for GL to report
+	if (words > GetValueWords(uniforms[uniform.index].type))
+		return true;
+
+	uint32_t* cached = cachedValues.data() + uniforms[uniform.index].valueOffset;
+	if (hasValue[uniform.index] && std::memcmp(cached, value, words * sizeof(uint32_t)) == 0)
+		return false;
+
+	std::memcpy(cached, value, words * sizeof(uint32_t));
+	hasValue[uniform.index] = true;
+	return true;
 }
\ No newline at end of file
@@ -2,6 +2,53 @@
 
 #include "utils.h"
 
+#include <string_view>
+
+// A uniform name hashed at compile time (FNV-1a), so setting a uniform by name never touches a string
+class UniformName
+{
+public:
+	consteval UniformName(const char* name)
+		: hash(Hash(name))
+	{
+		// empty
+	}
+
+	// for names only known at run time
+	static UniformName FromString(std::string_view name);
+	uint32_t GetHash() const;
+
+	static constexpr uint32_t Hash(std::string_view name)
+	{
+		uint32_t hash = 0x811C9DC5u;
+		for (char character : name)
+			hash = (hash ^ static_cast<uint8_t>(character)) * 0x01000193u;
+		return hash;
+	}
+
+private:
+	explicit constexpr UniformName(uint32_t hash)
+		: hash(hash)
+	{
+		// empty
+	}
+
+private:
+	uint32_t hash;
+};
+
+// An index into the uniforms a program reflected after linking
+struct UniformHandle
+{
+	uint32_t index;
+
+	bool IsValid() const;
+};
+
+// The active uniforms are reflected after linking into a table sorted by name hash; the setters
+// take a handle from GetUniform(), or a name that is looked up with a binary search. The last
+// value of every uniform is kept, so setting it again to the same value issues no GL call.
+// The setters need the program in use. Uniforms the program doesn't have are ignored.
 class ShaderProgram
 {
 public:
@@ -13,19 +60,42 @@ public:
 
 	GLuint GetID() const;
 
-	void SetInt(const std::string& locationName, int value) const;
-	void SetFloat(const std::string& locationName, float value) const;
-	void SetVec3(const std::string& locationName, const glm::vec3& value) const;
-	void SetMat4(const std::string& locationName, const glm::mat4& mat) const;
+	UniformHandle GetUniform(UniformName name) const;
+	size_t GetUniformCount() const;
+
+	void SetInt(UniformHandle uniform, int value) const;
+	void SetFloat(UniformHandle uniform, float value) const;
+	void SetVec3(UniformHandle uniform, const glm::vec3& value) const;
+	void SetMat4(UniformHandle uniform, const glm::mat4& mat) const;
+
+	void SetInt(UniformName name, int value) const;
+	void SetFloat(UniformName name, float value) const;
+	void SetVec3(UniformName name, const glm::vec3& value) const;
+	void SetMat4(UniformName name, const glm::mat4& mat) const;
 
 private:
+	struct Uniform
+	{
+		uint32_t nameHash;
+		GLint location;
+		GLenum type;
+		// where its last value starts in cachedValues, in 4-byte words
+		uint32_t valueOffset;
+	};
+
 	void Init(const std::string& vertexPath, const std::string& fragmentPath);
 	void CheckCompileErrors(GLuint shaderStencilTesting, const std::string& type);
+	void ReflectUniforms();
+	// remembers the value; returns false when the uniform doesn't exist or already has it
+	bool UpdateValue(UniformHandle uniform, const void* value, size_t words) const;
 
 private:
 	GLuint ID;
 
-	GLuint modelMatrixLocation;
-	GLuint viewMatrixLocation;
-	GLuint projectionMatrixLocation;
+	std::vector<Uniform> uniforms;
+	mutable std::vector<uint32_t> cachedValues;
+	mutable std::vector<bool> hasValue;
+
+public:
+	static const uint32_t NO_UNIFORM;
 };
\ No newline at end of file
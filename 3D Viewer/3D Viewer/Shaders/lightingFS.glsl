@@ -6,14 +6,20 @@ in vec3 MidNormal;
 
 out vec4 OutFragmentColor;
 
-uniform vec3 LightColor;
-uniform vec3 LightPosition;
-uniform vec3 ViewPosition;
-
-uniform float AmbientStrength;
-uniform float DiffuseStrength;
-uniform float SpecularStrength;
-uniform int SpecularExponent;
+// shared with every program, see UniformBuffers
+layout (std140) uniform FrameUniforms
+{
+	mat4 ViewMatrix;
+	mat4 ProjectionMatrix;
+	mat4 ViewProjectionMatrix;
+	vec3 ViewPosition;
+	float AmbientStrength;
+	vec3 LightPosition;
+	float DiffuseStrength;
+	vec3 LightColor;
+	float SpecularStrength;
+	int SpecularExponent;
+};
 
 void main()
 {
@@ -8,15 +8,53 @@ out vec3 MidFragmentPosition;
 out vec3 MidColor;
 out vec3 MidNormal;
 
-uniform mat4 ModelMatrix;
-uniform mat4 ViewMatrix;
-uniform mat4 ProjectionMatrix;
+// shared with every program, see UniformBuffers
+layout (std140) uniform FrameUniforms
+{
+	mat4 ViewMatrix;
+	mat4 ProjectionMatrix;
+	mat4 ViewProjectionMatrix;
+	vec3 ViewPosition;
+	float AmbientStrength;
+	vec3 LightPosition;
+	float DiffuseStrength;
+	vec3 LightColor;
+	float SpecularStrength;
+	int SpecularExponent;
+};
+
+// quantized vertices come in as normalized integers: positions in [0, 1] inside the mesh bounds
+// and normals as octahedral codes in [-1, 1]
+layout (std140) uniform ObjectUniforms
+{
+	mat4 ModelMatrix;
+	mat4 NormalMatrix;
+	vec3 PositionOffset;
+	bool QuantizedVertices;
+	vec3 PositionScale;
+};
+
+vec3 DecodeOctahedral(vec2 code)
+{
+	vec3 normal = vec3(code, 1.0 - abs(code.x) - abs(code.y));
+	if (normal.z < 0.0)
+		normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(normal);
+}
 
 void main()
 {
-	MidFragmentPosition = vec3(ModelMatrix * vec4(InPosition, 1.0f));
-	MidNormal = mat3(transpose(inverse(ModelMatrix))) * InNormal;
+	vec3 position = InPosition;
+	vec3 normal = InNormal;
+	if (QuantizedVertices)
+	{
+		position = PositionOffset + InPosition * PositionScale;
+		normal = DecodeOctahedral(InNormal.xy);
+	}
+
+	MidFragmentPosition = vec3(ModelMatrix * vec4(position, 1.0f));
+	MidNormal = mat3(NormalMatrix) * normal;
 
-	gl_Position = ProjectionMatrix * ViewMatrix * vec4(MidFragmentPosition, 1.0);
+	gl_Position = ViewProjectionMatrix * vec4(MidFragmentPosition, 1.0);
 	MidColor = InColor;
 }
\ No newline at end of file
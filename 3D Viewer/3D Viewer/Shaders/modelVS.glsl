@@ -6,12 +6,34 @@ layout (location = 2) in vec3 InColor;
 
 out vec3 MidColor;
 
-uniform mat4 ProjectionMatrix;
-uniform mat4 ViewMatrix;
-uniform mat4 ModelMatrix;
+// shared with every program, see UniformBuffers
+layout (std140) uniform FrameUniforms
+{
+	mat4 ViewMatrix;
+	mat4 ProjectionMatrix;
+	mat4 ViewProjectionMatrix;
+	vec3 ViewPosition;
+	float AmbientStrength;
+	vec3 LightPosition;
+	float DiffuseStrength;
+	vec3 LightColor;
+	float SpecularStrength;
+	int SpecularExponent;
+};
+
+// quantized positions come in as [0, 1] inside the mesh bounds
+layout (std140) uniform ObjectUniforms
+{
+	mat4 ModelMatrix;
+	mat4 NormalMatrix;
+	vec3 PositionOffset;
+	bool QuantizedVertices;
+	vec3 PositionScale;
+};
 
 void main()
 {
-    gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * vec4(InPosition, 1.0f);
+    vec3 position = QuantizedVertices ? PositionOffset + InPosition * PositionScale : InPosition;
+    gl_Position = ViewProjectionMatrix * ModelMatrix * vec4(position, 1.0f);
     MidColor = InColor;
 }
\ No newline at end of file
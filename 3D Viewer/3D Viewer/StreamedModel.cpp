@@ -0,0 +1,324 @@
+#include "StreamedModel.h"
+
+#include "GLState.h"
+
+#include <algorithm>
+
+const uint64_t StreamedModel::DEFAULT_CPU_BUDGET = 2048ull * 1024 * 1024;
+const uint64_t StreamedModel::DEFAULT_GPU_BUDGET = 1024ull * 1024 * 1024;
+const uint64_t StreamedModel::UPLOAD_BYTES_PER_FRAME = 16 * 1024 * 1024;
+const float StreamedModel::PREFETCH_SECONDS = 1.5f;
+
+StreamedModel::StreamedModel(const std::string& filePath, uint64_t cpuBudget, uint64_t gpuBudget, float loadDistance)
+	: mesh(filePath), modelMatrix(glm::mat4(1.0f)), cpuBudget(cpuBudget), gpuBudget(gpuBudget), loadDistance(loadDistance)
+{
+	chunks.resize(mesh.GetChunkCount());
+	lastCameraPosition = (mesh.GetBoundsMin() + mesh.GetBoundsMax()) / 2.0f;
+
+	worker = std::thread(&StreamedModel::WorkerLoop, this);
+}
+
+StreamedModel::~StreamedModel()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	worker.join();
+
+	for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+		DestroyBuffers(chunk);
+}
+
+void StreamedModel::Update(const Camera& camera, float deltaTime)
+{
+	frame++;
+	ReceiveLoadedChunks();
+
+	// distances are measured in model space, where the chunk bounds are
+	const glm::vec3 position = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(camera.GetPosition(), 1.0f));
+	if (deltaTime > 0.0f)
+		cameraVelocity = glm::mix(cameraVelocity, (position - lastCameraPosition) / deltaTime, 0.2f);
+	lastCameraPosition = position;
+	const glm::vec3 predictedPosition = position + cameraVelocity * PREFETCH_SECONDS;
+
+	std::vector<std::pair<float, size_t>> wanted;
+	for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+	{
+		const ChunkInfo& info = mesh.GetChunk(chunk);
+		float distance = std::min(info.GetDistance(position), info.GetDistance(predictedPosition));
+		if (distance <= loadDistance)
+			wanted.emplace_back(distance, chunk);
+	}
+	std::sort(wanted.begin(), wanted.end());
+
+	// only the nearest chunks that fit in each budget are kept, the rest are treated as not wanted
+	std::vector<size_t> cpuWanted, gpuWanted;
+	uint64_t cpuWantedBytes = 0, gpuWantedBytes = 0;
+	for (const auto& [distance, chunk] : wanted)
+	{
+		uint64_t size = mesh.GetChunk(chunk).GetByteSize();
+		if (cpuWantedBytes + size > cpuBudget)
+			break;
+
+		cpuWanted.push_back(chunk);
+		cpuWantedBytes += size;
+		chunks[chunk].lastWantedFrame = frame;
+
+		if (gpuWantedBytes + size <= gpuBudget)
+		{
+			gpuWanted.push_back(chunk);
+			gpuWantedBytes += size;
+			chunks[chunk].lastGpuWantedFrame = frame;
+		}
+	}
+
+	{
+		// requests the worker didn't get to are superseded by this frame's order
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t chunk : pendingChunks)
+		{
+			chunks[chunk].loading = false;
+			cpuBytes -= mesh.GetChunk(chunk).GetByteSize();
+		}
+		pendingChunks.clear();
+	}
+
+	EvictCpu(cpuWanted);
+
+	std::deque<size_t> requests;
+	for (size_t chunk : cpuWanted)
+	{
+		Chunk& state = chunks[chunk];
+		uint64_t size = mesh.GetChunk(chunk).GetByteSize();
+		if (state.cpuResident || state.loading || state.failed || cpuBytes + size > cpuBudget)
+			continue;
+
+		state.loading = true;
+		cpuBytes += size;
+		requests.push_back(chunk);
+	}
+
+	if (!requests.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pendingChunks = std::move(requests);
+		}
+		condition.notify_one();
+	}
+
+	EvictGpu(gpuWanted);
+
+	uint64_t uploadBudget = UPLOAD_BYTES_PER_FRAME;
+	for (size_t chunk : gpuWanted)
+	{
+		Chunk& state = chunks[chunk];
+		uint64_t size = mesh.GetChunk(chunk).GetByteSize();
+		if (state.VAO != 0 || !state.cpuResident || gpuBytes + size > gpuBudget)
+			continue;
+		if (size > uploadBudget)
+			break;
+
+		Upload(chunk);
+		uploadBudget -= size;
+	}
+}
+
+void StreamedModel::Render() const
+{
+	for (const Chunk& chunk : chunks)
+	{
+		if (chunk.VAO == 0 || chunk.lastWantedFrame != frame)
+			continue;
+
+		GLState::BindVertexArray(chunk.VAO);
+		const GLenum indexType = GetIndexType(chunk.data.GetPackedIndexSize());
+		for (const IndexRange& range : chunk.data.indexRanges)
+		{
+			GLCall(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)range.indexCount, indexType, (void*)range.byteOffset, (GLint)range.baseVertex));
+		}
+	}
+}
+
+glm::mat4 StreamedModel::GetModelMatrix() const
+{
+	return modelMatrix;
+}
+
+void StreamedModel::SetModelMatrix(const glm::mat4& modelMatrix)
+{
+	this->modelMatrix = modelMatrix;
+}
+
+uint64_t StreamedModel::GetCpuBytes() const
+{
+	return cpuBytes;
+}
+
+uint64_t StreamedModel::GetGpuBytes() const
+{
+	return gpuBytes;
+}
+
+void StreamedModel::WorkerLoop()
+{
+	while (true)
+	{
+		size_t chunk;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !pendingChunks.empty(); });
+			if (stopping)
+				return;
+
+			chunk = pendingChunks.front();
+			pendingChunks.pop_front();
+		}
+
+		LoadedChunk loaded;
+		loaded.chunk = chunk;
+
+		try
+		{
+			mesh.ReadChunk(chunk, loaded.data.vertices, loaded.data.indices);
+			loaded.data.PackIndices();
+		}
+		catch (const std::exception& e)
+		{
+			loaded.error = e.what();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		loadedChunks.push_back(std::move(loaded));
+	}
+}
+
+void StreamedModel::ReceiveLoadedChunks()
+{
+	std::vector<LoadedChunk> received;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		received.swap(loadedChunks);
+	}
+
+	for (LoadedChunk& loaded : received)
+	{
+		Chunk& state = chunks[loaded.chunk];
+		state.loading = false;
+
+		if (!loaded.error.empty())
+		{
+			std::cout << loaded.error << std::endl;
+			state.failed = true;
+			cpuBytes -= mesh.GetChunk(loaded.chunk).GetByteSize();
+			continue;
+		}
+
+		state.cpuResident = true;
+		state.data = std::move(loaded.data);
+	}
+}
+
+void StreamedModel::EvictCpu(const std::vector<size_t>& wanted)
+{
+	uint64_t missingBytes = 0;
+	for (size_t chunk : wanted)
+	{
+		if (!chunks[chunk].cpuResident && !chunks[chunk].loading)
+			missingBytes += mesh.GetChunk(chunk).GetByteSize();
+	}
+
+	std::vector<size_t> candidates;
+	for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+	{
+		if (chunks[chunk].cpuResident && chunks[chunk].lastWantedFrame != frame)
+			candidates.push_back(chunk);
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) { return chunks[a].lastWantedFrame < chunks[b].lastWantedFrame; });
+
+	for (size_t chunk : candidates)
+	{
+		if (cpuBytes + missingBytes <= cpuBudget)
+			break;
+
+		// the GPU copy is built from the CPU one, so both go together
+		DestroyBuffers(chunk);
+
+		Chunk& state = chunks[chunk];
+		state.cpuResident = false;
+		state.data = MeshData();
+		cpuBytes -= mesh.GetChunk(chunk).GetByteSize();
+	}
+}
+
+void StreamedModel::EvictGpu(const std::vector<size_t>& wanted)
+{
+	uint64_t missingBytes = 0;
+	for (size_t chunk : wanted)
+	{
+		if (chunks[chunk].VAO == 0)
+			missingBytes += mesh.GetChunk(chunk).GetByteSize();
+	}
+
+	std::vector<size_t> candidates;
+	for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+	{
+		if (chunks[chunk].VAO != 0 && chunks[chunk].lastGpuWantedFrame != frame)
+			candidates.push_back(chunk);
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) { return chunks[a].lastWantedFrame < chunks[b].lastWantedFrame; });
+
+	for (size_t chunk : candidates)
+	{
+		if (gpuBytes + missingBytes <= gpuBudget)
+			break;
+
+		DestroyBuffers(chunk);
+	}
+}
+
+void StreamedModel::Upload(size_t chunk)
+{
+	Chunk& state = chunks[chunk];
+
+	GLCall(glGenVertexArrays(1, &state.VAO));
+	GLState::BindVertexArray(state.VAO);
+
+	GLCall(glGenBuffers(1, &state.VBO));
+	GLState::BindBuffer(GL_ARRAY_BUFFER, state.VBO);
+	GLCall(glBufferData(GL_ARRAY_BUFFER, state.data.GetVertexCount() * sizeof(Vertex), state.data.GetVertexData(), GL_STATIC_DRAW));
+
+	GLCall(glGenBuffers(1, &state.EBO));
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, state.EBO);
+	GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, state.data.GetPackedIndexBytes(), state.data.GetPackedIndexData(), GL_STATIC_DRAW));
+
+	// same layout as Model, the element buffer stays bound to the VAO
+	GLCall(glEnableVertexAttribArray(0));
+	GLCall(glVertexAttribPointer(0, dimof(Vertex::position), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position)));
+	GLCall(glEnableVertexAttribArray(1));
+	GLCall(glVertexAttribPointer(1, dimof(Vertex::normal), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal)));
+	GLCall(glEnableVertexAttribArray(2));
+	GLCall(glVertexAttribPointer(2, dimof(Vertex::color), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color)));
+
+	GLState::BindVertexArray(0);
+
+	gpuBytes += mesh.GetChunk(chunk).GetByteSize();
+}
+
+void StreamedModel::DestroyBuffers(size_t chunk)
+{
+	Chunk& state = chunks[chunk];
+	if (state.VAO == 0)
+		return;
+
+	GLState::DeleteVertexArray(state.VAO);
+	GLState::DeleteBuffer(state.VBO);
+	GLState::DeleteBuffer(state.EBO);
+
+	state.VAO = 0;
+	state.VBO = 0;
+	state.EBO = 0;
+	gpuBytes -= mesh.GetChunk(chunk).GetByteSize();
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "utils.h"
+#include "Camera.h"
+#include "ChunkedMesh.h"
+#include "MeshData.h"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+// Renders a .cmesh file while keeping only the chunks near the camera in memory.
+// Every frame the chunks within loadDistance of the camera, or of where the camera will be
+// PREFETCH_SECONDS from now at its current speed, are requested in order of distance.
+// A worker thread reads them into CPU memory and Update() uploads them to the GPU;
+// the least recently wanted chunks are dropped once either budget is exceeded.
+class StreamedModel
+{
+public:
+	StreamedModel(const std::string& filePath, uint64_t cpuBudget = DEFAULT_CPU_BUDGET, uint64_t gpuBudget = DEFAULT_GPU_BUDGET, float loadDistance = Camera::Z_FAR);
+	StreamedModel(const StreamedModel&) = delete;
+	StreamedModel& operator=(const StreamedModel&) = delete;
+	~StreamedModel();
+
+	// must be called once per frame from the thread that owns the GL context
+	void Update(const Camera& camera, float deltaTime);
+	void Render() const;
+
+	glm::mat4 GetModelMatrix() const;
+	void SetModelMatrix(const glm::mat4& modelMatrix);
+
+	uint64_t GetCpuBytes() const;
+	uint64_t GetGpuBytes() const;
+
+private:
+	struct Chunk
+	{
+		bool loading = false;
+		bool cpuResident = false;
+		// not requested again after a read error
+		bool failed = false;
+		// indices already packed, see MeshData::PackIndices()
+		MeshData data;
+
+		GLuint VAO = 0, VBO = 0, EBO = 0;
+		uint64_t lastWantedFrame = 0;
+		// the GPU budget keeps only a part of the wanted chunks
+		uint64_t lastGpuWantedFrame = 0;
+	};
+
+	struct LoadedChunk
+	{
+		size_t chunk;
+		MeshData data;
+		std::string error;
+	};
+
+	void WorkerLoop();
+
+	void ReceiveLoadedChunks();
+	void EvictCpu(const std::vector<size_t>& candidates);
+	void EvictGpu(const std::vector<size_t>& candidates);
+
+	void Upload(size_t chunk);
+	void DestroyBuffers(size_t chunk);
+
+private:
+	ChunkedMesh mesh;
+	std::vector<Chunk> chunks;
+	glm::mat4 modelMatrix;
+
+	uint64_t cpuBudget, gpuBudget;
+	// bytes resident plus bytes being read
+	uint64_t cpuBytes = 0;
+	uint64_t gpuBytes = 0;
+	float loadDistance;
+
+	uint64_t frame = 0;
+	glm::vec3 lastCameraPosition;
+	glm::vec3 cameraVelocity = glm::vec3(0.0f);
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+	// replaced every frame, nearest chunk first
+	std::deque<size_t> pendingChunks;
+	std::vector<LoadedChunk> loadedChunks;
+
+public:
+	static const uint64_t DEFAULT_CPU_BUDGET;
+	static const uint64_t DEFAULT_GPU_BUDGET;
+	static const uint64_t UPLOAD_BYTES_PER_FRAME;
+	static const float PREFETCH_SECONDS;
+};
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "TextModelReader.h"
+
+#include "Parallel.h"
+#include "TextParsing.h"
+
+const size_t TextModelReader::CHUNK_SIZE = 4 * 1024 * 1024;
+
+struct TextChunk
+{
+	const char* begin;
+	const char* end;
+	size_t firstToken;
+	size_t tokenCount;
+};
+
+static std::vector<TextChunk> SplitIntoChunks(const std::string& text)
+{
+	std::vector<TextChunk> chunks;
+
+	const char* begin = text.data();
+	const char* end = begin + text.size();
+	while (begin < end)
+	{
+		const char* chunkEnd = begin + std::min<size_t>(TextModelReader::CHUNK_SIZE, end - begin);
+		chunkEnd = std::find(chunkEnd, end, '\n');
+		if (chunkEnd != end)
+			chunkEnd++;
+
+		chunks.push_back({ begin, chunkEnd, 0, 0 });
+		begin = chunkEnd;
+	}
+
+	return chunks;
+}
+
+static size_t CountTokens(const char* current, const char* end)
+{
+	size_t count = 0;
+	bool inToken = false;
+	for (; current < end; current++)
+	{
+		bool space = IsSpace(*current);
+		count += !space && !inToken;
+		inToken = !space;
+	}
+	return count;
+}
+
+void TextModelReader::Read(const std::string& filePath, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	std::ifstream fin(filePath, std::ios::binary);
+	if (!fin)
+	{
+		throw std::runtime_error(std::format("Could not open model file {}", filePath).data());
+	}
+
+	std::string text(static_cast<size_t>(std::filesystem::file_size(filePath)), '\0');
+	fin.read(text.data(), text.size());
+
+	std::vector<TextChunk> chunks = SplitIntoChunks(text);
+
+	ParallelFor(chunks.size(), [&](size_t i)
+	{
+		chunks[i].tokenCount = CountTokens(chunks[i].begin, chunks[i].end);
+	});
+
+	size_t tokenCount = 0;
+	for (auto& chunk : chunks)
+	{
+		chunk.firstToken = tokenCount;
+		tokenCount += chunk.tokenCount;
+	}
+
+	auto tokenAt = [&](size_t tokenIndex)
+	{
+		if (tokenIndex >= tokenCount)
+			throw std::runtime_error(std::format("Unexpected end of model file {}", filePath).data());
+
+		auto chunk = std::upper_bound(chunks.begin(), chunks.end(), tokenIndex,
+			[](size_t index, const TextChunk& chunk) { return index < chunk.firstToken; }) - 1;
+
+		const char* current = chunk->begin;
+		std::string_view token;
+		for (size_t i = chunk->firstToken; i <= tokenIndex; i++)
+			token = NextToken(current, chunk->end);
+		return token;
+	};
+
+	auto readCount = [&](size_t tokenIndex)
+	{
+		std::string_view token = tokenAt(tokenIndex);
+		long long count;
+		if (!ParseValue(token, count) || count < 0)
+			throw std::runtime_error(std::format("Invalid element count '{}' in model file {}", token, filePath).data());
+		return static_cast<size_t>(count);
+	};
+
+	// token layout: V, 3V positions, C, 3C colors, T, 3T indices
+	const size_t vertexCount = readCount(0);
+	const size_t positionsBegin = 1;
+	const size_t colorCountToken = positionsBegin + 3 * vertexCount;
+
+	const size_t colorCount = readCount(colorCountToken);
+	if (colorCount > vertexCount)
+	{
+		throw std::runtime_error(std::format("More colors than vertices in model file {}: {} > {}", filePath, colorCount, vertexCount).data());
+	}
+	const size_t colorsBegin = colorCountToken + 1;
+	const size_t triangleCountToken = colorsBegin + 3 * colorCount;
+
+	const size_t triangleCount = readCount(triangleCountToken);
+	const size_t indicesBegin = triangleCountToken + 1;
+	const size_t indicesEnd = indicesBegin + 3 * triangleCount;
+
+	if (tokenCount < indicesEnd)
+	{
+		throw std::runtime_error(std::format("Unexpected end of model file {}", filePath).data());
+	}
+
+	vertices.assign(vertexCount, Vertex());
+	indices.resize(3 * triangleCount);
+
+	ParallelFor(chunks.size(), [&](size_t i)
+	{
+		const TextChunk& chunk = chunks[i];
+		const char* current = chunk.begin;
+
+		for (size_t token = chunk.firstToken; token < chunk.firstToken + chunk.tokenCount && token < indicesEnd; token++)
+		{
+			std::string_view text = NextToken(current, chunk.end);
+
+			bool parsed = true;
+			if (token >= indicesBegin)
+				parsed = ParseValue(text, indices[token - indicesBegin]);
+			else if (token >= colorsBegin && token < triangleCountToken)
+				parsed = ParseValue(text, vertices[(token - colorsBegin) / 3].color[static_cast<int>((token - colorsBegin) % 3)]);
+			else if (token >= positionsBegin && token < colorCountToken)
+				parsed = ParseValue(text, vertices[(token - positionsBegin) / 3].position[static_cast<int>((token - positionsBegin) % 3)]);
+
+			if (!parsed)
+				throw std::runtime_error(std::format("Invalid value '{}' in model file {}", text, filePath).data());
+		}
+	});
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "utils.h"
+#include "Vertex.h"
+
+// Reader for the plain text model layout:
+// vertex count, positions, color count, colors, triangle count, triangle indices.
+// The whole file is read into one buffer, split into newline-aligned chunks and parsed in parallel.
+class TextModelReader
+{
+public:
+	static void Read(const std::string& filePath, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+public:
+	static const size_t CHUNK_SIZE;
+};
\ No newline at end of file
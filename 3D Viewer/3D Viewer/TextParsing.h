@@ -0,0 +1,35 @@
+#pragma once
+
+#include <charconv>
+#include <string_view>
+
+// treats every control character as a separator, which covers all the whitespace istream skips
+inline bool IsSpace(char c)
+{
+	return static_cast<unsigned char>(c) <= ' ';
+}
+
+inline std::string_view NextToken(const char*& current, const char* end)
+{
+	while (current < end && IsSpace(*current))
+		current++;
+
+	const char* tokenBegin = current;
+	while (current < end && !IsSpace(*current))
+		current++;
+
+	return std::string_view(tokenBegin, current - tokenBegin);
+}
+
+// istream extraction accepts a leading '+', from_chars doesn't
+template<typename T>
+inline bool ParseValue(std::string_view token, T& value)
+{
+	const char* begin = token.data();
+	const char* end = begin + token.size();
+	if (begin != end && *begin == '+')
+		begin++;
+
+	auto result = std::from_chars(begin, end, value);
+	return result.ec == std::errc() && result.ptr == end;
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "UniformBuffers.h"
+
+#include "GLState.h"
+
+#include <cstring>
+
+static_assert(sizeof(FrameUniforms) == 256 && offsetof(FrameUniforms, specularExponent) == 240, "FrameUniforms must match the std140 block");
+static_assert(sizeof(ObjectUniforms) == 160 && offsetof(ObjectUniforms, positionScale) == 144, "ObjectUniforms must match the std140 block");
+
+const GLuint UniformBuffers::FRAME_BINDING = 0;
+const GLuint UniformBuffers::OBJECT_BINDING = 1;
+const size_t UniformBuffers::FRAMES_IN_FLIGHT = 3;
+const size_t UniformBuffers::DEFAULT_OBJECTS_PER_FRAME = 1024;
+const GLuint64 UniformBuffers::FENCE_TIMEOUT = 1000000000;
+
+static size_t AlignUp(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+ObjectUniforms::ObjectUniforms(const glm::mat4& modelMatrix)
+	: modelMatrix(modelMatrix), normalMatrix(glm::transpose(glm::inverse(glm::mat3(modelMatrix)))),
+	positionOffset(0.0f), quantizedVertices(0), positionScale(1.0f), padding(0.0f)
+{
+	// empty
+}
+
+UniformBuffers::UniformBuffers(size_t objectsPerFrame)
+{
+	GLint alignment;
+	GLCall(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+	frameStride = AlignUp(sizeof(FrameUniforms), alignment);
+	objectStride = AlignUp(sizeof(ObjectUniforms), alignment);
+
+	CreateRing(objectsPerFrame);
+}
+
+UniformBuffers::~UniformBuffers()
+{
+	DestroyRing();
+}
+
+void UniformBuffers::BeginFrame(const FrameUniforms& uniforms)
+{
+	region = (region + 1) % FRAMES_IN_FLIGHT;
+
+	// only waits when the GPU is FRAMES_IN_FLIGHT frames behind
+	GLsync& fence = regionFences[region];
+	if (fence != nullptr)
+	{
+		// the region must not be written while the GPU may still read it, however long that takes
+		GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+		while (status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(fence, 0, FENCE_TIMEOUT);
+
+		if (status == GL_WAIT_FAILED)
+		{
+			std::cout << "Waiting for the uniform buffer fence failed, waiting for all GPU work instead" << std::endl;
+			GLCall(glFinish());
+		}
+		GLCall(glDeleteSync(fence));
+		fence = nullptr;
+	}
+
+	frameUniforms = uniforms;
+	objectCount = 0;
+
+	Write(region * regionSize, &frameUniforms, sizeof(FrameUniforms));
+	GLState::BindBufferRange(GL_UNIFORM_BUFFER, FRAME_BINDING, buffer, region * regionSize, sizeof(FrameUniforms));
+}
+
+void UniformBuffers::SetObject(const ObjectUniforms& uniforms)
+{
+	if (objectCount == objectsPerFrame)
+	{
+		// the draws already issued keep the old ring alive until the GPU is done with it
+		CreateRing(objectsPerFrame * 2);
+		objectCount = 0;
+
+		Write(region * regionSize, &frameUniforms, sizeof(FrameUniforms));
+		GLState::BindBufferRange(GL_UNIFORM_BUFFER, FRAME_BINDING, buffer, region * regionSize, sizeof(FrameUniforms));
+	}
+
+	const size_t offset = region * regionSize + frameStride + objectCount * objectStride;
+	objectCount++;
+
+	Write(offset, &uniforms, sizeof(ObjectUniforms));
+	GLState::BindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BINDING, buffer, offset, sizeof(ObjectUniforms));
+}
+
+void UniformBuffers::EndFrame()
+{
+	regionFences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UniformBuffers::BindBlocks(GLuint program)
+{
+	// programs without one of the blocks simply don't use it
+	const GLuint frameBlock = glGetUniformBlockIndex(program, "FrameUniforms");
+	if (frameBlock != GL_INVALID_INDEX)
+	{
+		GLCall(glUniformBlockBinding(program, frameBlock, FRAME_BINDING));
+	}
+
+	const GLuint objectBlock = glGetUniformBlockIndex(program, "ObjectUniforms");
+	if (objectBlock != GL_INVALID_INDEX)
+	{
+		GLCall(glUniformBlockBinding(program, objectBlock, OBJECT_BINDING));
+	}
+}
+
+void UniformBuffers::CreateRing(size_t objectsPerFrame)
+{
+	DestroyRing();
+
+	this->objectsPerFrame = objectsPerFrame;
+	regionSize = frameStride + objectsPerFrame * objectStride;
+	regionFences.assign(FRAMES_IN_FLIGHT, nullptr);
+
+	// stays bound to the generic binding point, which nothing else uses
+	GLCall(glGenBuffers(1, &buffer));
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	if (GLEW_ARB_buffer_storage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		// dynamic storage keeps glBufferSubData usable should the mapping fail
+		GLCall(glBufferStorage(GL_UNIFORM_BUFFER, regionSize * FRAMES_IN_FLIGHT, nullptr, flags | GL_DYNAMIC_STORAGE_BIT));
+		memory = static_cast<uint8_t*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, regionSize * FRAMES_IN_FLIGHT, flags));
+	}
+	else
+	{
+		GLCall(glBufferData(GL_UNIFORM_BUFFER, regionSize * FRAMES_IN_FLIGHT, nullptr, GL_STREAM_DRAW));
+	}
+}
+
+void UniformBuffers::DestroyRing()
+{
+	for (auto& fence : regionFences)
+	{
+		if (fence != nullptr)
+		{
+			GLCall(glDeleteSync(fence));
+		}
+		fence = nullptr;
+	}
+
+	if (buffer != 0)
+	{
+		GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+		if (memory != nullptr)
+		{
+			GLCall(glUnmapBuffer(GL_UNIFORM_BUFFER));
+		}
+		GLState::DeleteBuffer(buffer);
+	}
+
+	buffer = 0;
+	memory = nullptr;
+}
+
+void UniformBuffers::Write(size_t offset, const void* data, size_t size)
+{
+	if (memory != nullptr)
+	{
+		std::memcpy(memory + offset, data, size);
+	}
+	else
+	{
+		GLCall(glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data));
+	}
+}
\ No newline at end of file
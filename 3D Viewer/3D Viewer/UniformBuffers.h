@@ -0,0 +1,81 @@
+#pragma once
+
+#include "utils.h"
+
+// The std140 layout of the FrameUniforms block; the vec3s are packed with the float after them
+struct FrameUniforms
+{
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+	glm::mat4 viewProjectionMatrix;
+	glm::vec3 viewPosition;
+	float ambientStrength;
+	glm::vec3 lightPosition;
+	float diffuseStrength;
+	glm::vec3 lightColor;
+	float specularStrength;
+	int specularExponent;
+	int padding[3];
+};
+
+// The std140 layout of the ObjectUniforms block
+struct ObjectUniforms
+{
+	glm::mat4 modelMatrix;
+	// the inverse transpose of the model matrix, only its upper 3x3 is used
+	glm::mat4 normalMatrix;
+	// how QuantizedVertex positions map back into model space
+	glm::vec3 positionOffset;
+	uint32_t quantizedVertices;
+	glm::vec3 positionScale;
+	float padding;
+
+	// full precision vertices
+	ObjectUniforms(const glm::mat4& modelMatrix = glm::mat4(1.0f));
+};
+
+// The uniform blocks shared by every ShaderProgram. FrameUniforms is written once per frame and
+// ObjectUniforms once per draw, both into a ring of FRAMES_IN_FLIGHT regions that is persistently
+// mapped (or written with glBufferSubData when ARB_buffer_storage is missing); a draw only costs
+// the copy and one glBindBufferRange. A region is fenced and reused once the GPU is done with it.
+class UniformBuffers
+{
+public:
+	UniformBuffers(size_t objectsPerFrame = DEFAULT_OBJECTS_PER_FRAME);
+	UniformBuffers(const UniformBuffers&) = delete;
+	UniformBuffers& operator=(const UniformBuffers&) = delete;
+	~UniformBuffers();
+
+	// the uniforms of every object go between BeginFrame() and EndFrame()
+	void BeginFrame(const FrameUniforms& uniforms);
+	// bound for the draws that follow; the ring doubles when a frame outgrows it
+	void SetObject(const ObjectUniforms& uniforms);
+	void EndFrame();
+
+	// points the blocks of a linked program at their binding points
+	static void BindBlocks(GLuint program);
+
+private:
+	void CreateRing(size_t objectsPerFrame);
+	void DestroyRing();
+	void Write(size_t offset, const void* data, size_t size);
+
+private:
+	GLuint buffer = 0;
+	uint8_t* memory = nullptr;
+	size_t frameStride, objectStride;
+	size_t objectsPerFrame, regionSize;
+
+	std::vector<GLsync> regionFences;
+	size_t region = 0;
+	size_t objectCount = 0;
+	FrameUniforms frameUniforms;
+
+public:
+	static const GLuint FRAME_BINDING;
+	static const GLuint OBJECT_BINDING;
+	static const size_t FRAMES_IN_FLIGHT;
+	static const size_t DEFAULT_OBJECTS_PER_FRAME;
+	// how long BeginFrame() waits for the GPU to release a region, in nanoseconds
+	static const GLuint64 FENCE_TIMEOUT;
+};
\ No newline at end of file
@@ -37,3 +37,9 @@ bool GLLogCall(const char* function, const char* file, int line)
 	}
 	return ret;
 }
+
+
+GLenum GetIndexType(size_t indexSize)
+{
+	return indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
\ No newline at end of file
@@ -11,17 +11,19 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <stdexcept>
 #include <vector>
 #include <filesystem>
 #include <format>
 
+#include "GLDiagnostics.h"
+
 #define dimof(vec) (sizeof(vec) / sizeof(vec[0]))
 #define ASSERT(cond) if (!(cond)) __debugbreak();
 
-#define DEBUG
-
-#ifdef DEBUG
-	#define GLCall(func) GLClearError(); func; ASSERT(GLLogCall(#func, __FILE__, __LINE__));
+// the mode is picked at run time, see GLDiagnostics; NO_GL_DIAGNOSTICS drops even the call sites
+#ifndef NO_GL_DIAGNOSTICS
+	#define GLCall(func) GLDiagnostics::BeginCall(#func, __FILE__, __LINE__); func; ASSERT(GLDiagnostics::EndCall());
 #else
 	#define GLCall(func) func;
 #endif
@@ -68,3 +70,4 @@ std::ostream& operator<<(std::ostream& os, const glm::vec3& vector);
 std::ostream& operator<<(std::ostream& os, const glm::mat4& mat);
 void GLClearError();
 bool GLLogCall(const char* function, const char* file, int line);
+GLenum GetIndexType(size_t indexSize);
@@ -0,0 +1,82 @@
+#include "VertexAdjacency.h"
+#include "Parallel.h"
+
+struct Corner
+{
+	unsigned int vertex;
+	unsigned int face;
+};
+
+// Two stable passes instead of atomics: the corners are first partitioned into buckets of
+// consecutive vertices, block by block in face order, then every bucket builds its own part
+// of the lists with plain counters. The face lists come out sorted without sorting them.
+VertexAdjacency VertexAdjacency::Build(const unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	const size_t cornerCount = indexCount / 3 * 3;
+	const size_t blockCount = std::max<size_t>(1, std::min<size_t>(GetWorkerCount() * 4, cornerCount / 4096));
+	const size_t blockSize = (cornerCount + blockCount - 1) / blockCount;
+	const size_t bucketCount = std::max<size_t>(1, std::min<size_t>(GetWorkerCount() * 8, vertexCount / 1024));
+	const size_t verticesPerBucket = (vertexCount + bucketCount - 1) / std::max<size_t>(bucketCount, 1);
+
+	auto bucketOf = [&](unsigned int vertex) { return vertex / verticesPerBucket; };
+
+	std::vector<size_t> blockCounts(blockCount * bucketCount, 0);
+	ParallelFor(blockCount, [&](size_t block)
+	{
+		size_t* counts = &blockCounts[block * bucketCount];
+		for (size_t i = block * blockSize; i < std::min(cornerCount, (block + 1) * blockSize); i++)
+			counts[bucketOf(indices[i])]++;
+	});
+
+	// turn the counts into write positions, bucket major so every bucket is contiguous
+	std::vector<size_t> bucketStarts(bucketCount + 1, 0);
+	size_t position = 0;
+	for (size_t bucket = 0; bucket < bucketCount; bucket++)
+	{
+		bucketStarts[bucket] = position;
+		for (size_t block = 0; block < blockCount; block++)
+		{
+			size_t count = blockCounts[block * bucketCount + bucket];
+			blockCounts[block * bucketCount + bucket] = position;
+			position += count;
+		}
+	}
+	bucketStarts[bucketCount] = position;
+
+	std::vector<Corner> corners(cornerCount);
+	ParallelFor(blockCount, [&](size_t block)
+	{
+		size_t* positions = &blockCounts[block * bucketCount];
+		for (size_t i = block * blockSize; i < std::min(cornerCount, (block + 1) * blockSize); i++)
+			corners[positions[bucketOf(indices[i])]++] = { indices[i], static_cast<unsigned int>(i / 3) };
+	});
+
+	VertexAdjacency adjacency;
+	adjacency.offsets.resize(vertexCount + 1);
+	adjacency.faces.resize(cornerCount);
+	adjacency.offsets[vertexCount] = cornerCount;
+
+	ParallelFor(bucketCount, [&](size_t bucket)
+	{
+		const size_t firstVertex = std::min(vertexCount, bucket * verticesPerBucket);
+		const size_t lastVertex = std::min(vertexCount, firstVertex + verticesPerBucket);
+
+		std::vector<size_t> cursors(lastVertex - firstVertex, 0);
+		for (size_t i = bucketStarts[bucket]; i < bucketStarts[bucket + 1]; i++)
+			cursors[corners[i].vertex - firstVertex]++;
+
+		size_t offset = bucketStarts[bucket];
+		for (size_t vertex = firstVertex; vertex < lastVertex; vertex++)
+		{
+			size_t count = cursors[vertex - firstVertex];
+			adjacency.offsets[vertex] = offset;
+			cursors[vertex - firstVertex] = offset;
+			offset += count;
+		}
+
+		for (size_t i = bucketStarts[bucket]; i < bucketStarts[bucket + 1]; i++)
+			adjacency.faces[cursors[corners[i].vertex - firstVertex]++] = corners[i].face;
+	});
+
+	return adjacency;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "utils.h"
+
+// Faces around every vertex in compressed sparse row form: the faces using vertex v are
+// faces[offsets[v]] .. faces[offsets[v + 1] - 1], in increasing order. Lets per-vertex passes
+// gather from their faces in parallel instead of scattering into shared vertices.
+struct VertexAdjacency
+{
+	std::vector<size_t> offsets;
+	std::vector<unsigned int> faces;
+
+	static VertexAdjacency Build(const unsigned int* indices, size_t indexCount, size_t vertexCount);
+};
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include "VertexQuantizer.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+const float VertexQuantizer::POSITION_STEPS = 65535.0f;
+const float VertexQuantizer::NORMAL_STEPS = 32767.0f;
+const float VertexQuantizer::COLOR_STEPS = 255.0f;
+
+static const size_t GRAIN_SIZE = 1 << 14;
+
+VertexQuantizer::VertexQuantizer()
+	: offset(0.0f), scale(1.0f), inverseScale(1.0f)
+{
+	// empty
+}
+
+VertexQuantizer::VertexQuantizer(const glm::vec3& min, const glm::vec3& max)
+	: offset(min), scale(glm::max(max - min, glm::vec3(0.0f)))
+{
+	for (int axis = 0; axis < 3; axis++)
+		inverseScale[axis] = scale[axis] > 0.0f ? 1.0f / scale[axis] : 0.0f;
+}
+
+QuantizedVertex VertexQuantizer::Quantize(const Vertex& vertex) const
+{
+	QuantizedVertex quantized;
+
+	const glm::vec3 position = glm::clamp((vertex.position - offset) * inverseScale, 0.0f, 1.0f) * POSITION_STEPS + 0.5f;
+	for (int axis = 0; axis < 3; axis++)
+		quantized.position[axis] = static_cast<uint16_t>(position[axis]);
+	quantized.position[3] = 0;
+
+	// plain rounding of the code is off by up to twice as much as the best neighbour
+	quantized.normal[0] = 0;
+	quantized.normal[1] = 0;
+	const float length = glm::length(vertex.normal);
+	if (length > 0.0f)
+	{
+		const glm::vec3 normal = vertex.normal / length;
+		const glm::vec2 code = EncodeOctahedral(normal);
+
+		float bestCosine = -2.0f;
+		for (int corner = 0; corner < 4; corner++)
+		{
+			const int16_t x = QuantizeNormalComponent(code.x, corner & 1);
+			const int16_t y = QuantizeNormalComponent(code.y, corner & 2);
+			const float cosine = glm::dot(DecodeOctahedral(glm::vec2(x, y) / NORMAL_STEPS), normal);
+			if (cosine > bestCosine)
+			{
+				bestCosine = cosine;
+				quantized.normal[0] = x;
+				quantized.normal[1] = y;
+			}
+		}
+	}
+
+	const glm::vec3 color = glm::clamp(vertex.color, 0.0f, 1.0f) * COLOR_STEPS + 0.5f;
+	for (int channel = 0; channel < 3; channel++)
+		quantized.color[channel] = static_cast<uint8_t>(color[channel]);
+	quantized.color[3] = static_cast<uint8_t>(COLOR_STEPS);
+
+	return quantized;
+}
+
+Vertex VertexQuantizer::Dequantize(const QuantizedVertex& vertex) const
+{
+	const glm::vec3 position = glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]) / POSITION_STEPS;
+	const glm::vec2 code = glm::vec2(vertex.normal[0], vertex.normal[1]) / NORMAL_STEPS;
+	const glm::vec3 color = glm::vec3(vertex.color[0], vertex.color[1], vertex.color[2]) / COLOR_STEPS;
+
+	return Vertex(offset + position * scale, DecodeOctahedral(code), color);
+}
+
+void VertexQuantizer::Quantize(const Vertex* source, QuantizedVertex* destination, size_t count) const
+{
+	ParallelForRange(count, GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			destination[i] = Quantize(source[i]);
+	});
+}
+
+QuantizationError VertexQuantizer::Measure(const Vertex* vertices, size_t count) const
+{
+	std::vector<QuantizationError> blockErrors((count + GRAIN_SIZE - 1) / GRAIN_SIZE, QuantizationError());
+
+	ParallelForRange(count, GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		QuantizationError& error = blockErrors[begin / GRAIN_SIZE];
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vertex& vertex = vertices[i];
+			const Vertex restored = Dequantize(Quantize(vertex));
+
+			const glm::vec3 positionError = glm::abs(restored.position - vertex.position);
+			error.position = std::max({ error.position, positionError.x, positionError.y, positionError.z });
+
+			const glm::vec3 colorError = glm::abs(restored.color - glm::clamp(vertex.color, 0.0f, 1.0f));
+			error.color = std::max({ error.color, colorError.x, colorError.y, colorError.z });
+
+			// atan2 keeps its precision for the tiny angles, acos of the cosine would not
+			const float length = glm::length(vertex.normal);
+			if (length > 0.0f)
+			{
+				const glm::vec3 normal = vertex.normal / length;
+				const float angle = std::atan2(glm::length(glm::cross(normal, restored.normal)), glm::dot(normal, restored.normal));
+				error.normalDegrees = std::max(error.normalDegrees, glm::degrees(angle));
+			}
+		}
+	});
+
+	QuantizationError error = {};
+	for (const QuantizationError& blockError : blockErrors)
+	{
+		error.position = std::max(error.position, blockError.position);
+		error.normalDegrees = std::max(error.normalDegrees, blockError.normalDegrees);
+		error.color = std::max(error.color, blockError.color);
+	}
+	return error;
+}
+
+glm::vec3 VertexQuantizer::GetPositionErrorBound() const
+{
+	return scale / POSITION_STEPS * 0.5f;
+}
+
+const glm::vec3& VertexQuantizer::GetOffset() const
+{
+	return offset;
+}
+
+const glm::vec3& VertexQuantizer::GetScale() const
+{
+	return scale;
+}
+
+glm::vec2 VertexQuantizer::EncodeOctahedral(const glm::vec3& normal)
+{
+	const float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (l1 == 0.0f)
+		return glm::vec2(0.0f);
+
+	glm::vec2 code = glm::vec2(normal) / l1;
+	// the lower half folds over the diagonals
+	if (normal.z < 0.0f)
+	{
+		const glm::vec2 sign = glm::vec2(code.x >= 0.0f ? 1.0f : -1.0f, code.y >= 0.0f ? 1.0f : -1.0f);
+		code = (1.0f - glm::abs(glm::vec2(code.y, code.x))) * sign;
+	}
+	return code;
+}
+
+glm::vec3 VertexQuantizer::DecodeOctahedral(const glm::vec2& code)
+{
+	glm::vec3 normal = glm::vec3(code, 1.0f - std::abs(code.x) - std::abs(code.y));
+	if (normal.z < 0.0f)
+	{
+		const glm::vec2 sign = glm::vec2(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+		const glm::vec2 unfolded = (1.0f - glm::abs(glm::vec2(normal.y, normal.x))) * sign;
+		normal.x = unfolded.x;
+		normal.y = unfolded.y;
+	}
+	return glm::normalize(normal);
+}
+
+int16_t VertexQuantizer::QuantizeNormalComponent(float value, bool roundUp)
+{
+	const float scaled = value * NORMAL_STEPS;
+	const float rounded = roundUp ? std::ceil(scaled) : std::floor(scaled);
+	return static_cast<int16_t>(std::clamp(rounded, -NORMAL_STEPS, NORMAL_STEPS));
+}
\ No newline at end of file
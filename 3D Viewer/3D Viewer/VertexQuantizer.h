@@ -0,0 +1,67 @@
+#pragma once
+
+#include "utils.h"
+#include "Vertex.h"
+
+// A Vertex packed into 16 bytes instead of 36, for the GPU only; the attributes are read back
+// as normalized integers and the vertex shaders undo the position mapping and the normal encoding
+struct QuantizedVertex
+{
+	// unsigned normalized, relative to the bounds of the mesh; the fourth component only pads the
+	// normals to a 4-byte offset
+	uint16_t position[4];
+	// signed normalized octahedral encoding
+	int16_t normal[2];
+	// unsigned normalized RGBA, alpha is always opaque
+	uint8_t color[4];
+};
+
+// The largest differences between vertices and their quantized versions
+struct QuantizationError
+{
+	// in model units
+	float position;
+	float normalDegrees;
+	float color;
+};
+
+// Maps vertices to QuantizedVertex and back. Positions are stored as offsets into the box
+// [offset, offset + scale], so the error of a component is half a step of its axis, plus the
+// float rounding of the dequantization.
+// Normals are rounded to whichever of the four neighbouring octahedral codes decodes closest.
+class VertexQuantizer
+{
+public:
+	// the identity mapping
+	VertexQuantizer();
+	VertexQuantizer(const glm::vec3& min, const glm::vec3& max);
+
+	QuantizedVertex Quantize(const Vertex& vertex) const;
+	Vertex Dequantize(const QuantizedVertex& vertex) const;
+	void Quantize(const Vertex* source, QuantizedVertex* destination, size_t count) const;
+	// the error the vertices actually get, zero normals are skipped
+	QuantizationError Measure(const Vertex* vertices, size_t count) const;
+
+	// half a step per axis, in model units
+	glm::vec3 GetPositionErrorBound() const;
+	const glm::vec3& GetOffset() const;
+	const glm::vec3& GetScale() const;
+
+	// unit normal to the octahedron unfolded over [-1, 1]^2 and back
+	static glm::vec2 EncodeOctahedral(const glm::vec3& normal);
+	static glm::vec3 DecodeOctahedral(const glm::vec2& code);
+
+private:
+	static int16_t QuantizeNormalComponent(float value, bool roundUp);
+
+private:
+	glm::vec3 offset;
+	glm::vec3 scale;
+	// zero on flat axes, so they all map to the lower bound
+	glm::vec3 inverseScale;
+
+public:
+	static const float POSITION_STEPS;
+	static const float NORMAL_STEPS;
+	static const float COLOR_STEPS;
+};
\ No newline at end of file
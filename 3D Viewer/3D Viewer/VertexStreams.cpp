@@ -0,0 +1,413 @@
+#include "VertexStreams.h"
+
+#include "Parallel.h"
+
+#include <cmath>
+#include <limits>
+
+// SSE2 is part of x64, AVX2 is only used after the CPU reported it
+#if defined(_M_X64) || defined(__x86_64__)
+	#define VERTEX_STREAMS_SIMD
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define AVX2_TARGET
+	#else
+		#define AVX2_TARGET __attribute__((target("avx2,fma")))
+	#endif
+#endif
+
+const size_t VertexStreams::GRAIN_SIZE = 1 << 16;
+
+// every kernel works on [begin, end); the SIMD versions leave the remainder to the scalar one.
+// The affine kernels take the matrix as three rows of (x, y, z, translation).
+
+static double SumScalar(const float* values, size_t begin, size_t end)
+{
+	double sum = 0.0;
+	for (size_t i = begin; i < end; i++)
+		sum += values[i];
+	return sum;
+}
+
+static void BoundsScalar(const float* values, size_t begin, size_t end, float& min, float& max)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		min = std::min(min, values[i]);
+		max = std::max(max, values[i]);
+	}
+}
+
+static void TransformScalar(float* x, float* y, float* z, size_t begin, size_t end, const float* rows)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		float px = x[i], py = y[i], pz = z[i];
+		x[i] = rows[0] * px + rows[1] * py + rows[2] * pz + rows[3];
+		y[i] = rows[4] * px + rows[5] * py + rows[6] * pz + rows[7];
+		z[i] = rows[8] * px + rows[9] * py + rows[10] * pz + rows[11];
+	}
+}
+
+static void NormalizeScalar(float* x, float* y, float* z, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		float lengthSquared = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+		if (lengthSquared <= 0.0f)
+			continue;
+
+		float inverseLength = 1.0f / std::sqrt(lengthSquared);
+		x[i] *= inverseLength;
+		y[i] *= inverseLength;
+		z[i] *= inverseLength;
+	}
+}
+
+#ifdef VERTEX_STREAMS_SIMD
+
+static double SumSse(const float* values, size_t begin, size_t end)
+{
+	// widened to double before adding, so the lanes don't lose precision over long blocks
+	__m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 value = _mm_loadu_ps(values + i);
+		low = _mm_add_pd(low, _mm_cvtps_pd(value));
+		high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(value, value)));
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(low, high));
+	return lanes[0] + lanes[1] + SumScalar(values, i, end);
+}
+
+static void BoundsSse(const float* values, size_t begin, size_t end, float& min, float& max)
+{
+	__m128 low = _mm_set1_ps(min), high = _mm_set1_ps(max);
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 value = _mm_loadu_ps(values + i);
+		low = _mm_min_ps(low, value);
+		high = _mm_max_ps(high, value);
+	}
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, low);
+	min = std::min({ lanes[0], lanes[1], lanes[2], lanes[3] });
+	_mm_storeu_ps(lanes, high);
+	max = std::max({ lanes[0], lanes[1], lanes[2], lanes[3] });
+	BoundsScalar(values, i, end, min, max);
+}
+
+static void TransformSse(float* x, float* y, float* z, size_t begin, size_t end, const float* rows)
+{
+	__m128 m[12];
+	for (int j = 0; j < 12; j++)
+		m[j] = _mm_set1_ps(rows[j]);
+
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		_mm_storeu_ps(x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], px), _mm_mul_ps(m[1], py)), _mm_add_ps(_mm_mul_ps(m[2], pz), m[3])));
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], px), _mm_mul_ps(m[5], py)), _mm_add_ps(_mm_mul_ps(m[6], pz), m[7])));
+		_mm_storeu_ps(z + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], px), _mm_mul_ps(m[9], py)), _mm_add_ps(_mm_mul_ps(m[10], pz), m[11])));
+	}
+	TransformScalar(x, y, z, i, end, rows);
+}
+
+static void NormalizeSse(float* x, float* y, float* z, size_t begin, size_t end)
+{
+	const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 nx = _mm_loadu_ps(x + i), ny = _mm_loadu_ps(y + i), nz = _mm_loadu_ps(z + i);
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+		// a full division instead of rsqrt keeps the result equal to the scalar path
+		__m128 nonZero = _mm_cmpgt_ps(lengthSquared, zero);
+		__m128 scale = _mm_div_ps(one, _mm_sqrt_ps(_mm_or_ps(lengthSquared, _mm_andnot_ps(nonZero, one))));
+		_mm_storeu_ps(x + i, _mm_mul_ps(nx, scale));
+		_mm_storeu_ps(y + i, _mm_mul_ps(ny, scale));
+		_mm_storeu_ps(z + i, _mm_mul_ps(nz, scale));
+	}
+	NormalizeScalar(x, y, z, i, end);
+}
+
+AVX2_TARGET static double SumAvx2(const float* values, size_t begin, size_t end)
+{
+	__m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 value = _mm256_loadu_ps(values + i);
+		low = _mm256_add_pd(low, _mm256_cvtps_pd(_mm256_castps256_ps128(value)));
+		high = _mm256_add_pd(high, _mm256_cvtps_pd(_mm256_extractf128_ps(value, 1)));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(low, high));
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + SumScalar(values, i, end);
+}
+
+AVX2_TARGET static void BoundsAvx2(const float* values, size_t begin, size_t end, float& min, float& max)
+{
+	__m256 low = _mm256_set1_ps(min), high = _mm256_set1_ps(max);
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 value = _mm256_loadu_ps(values + i);
+		low = _mm256_min_ps(low, value);
+		high = _mm256_max_ps(high, value);
+	}
+
+	float lanes[8];
+	_mm256_storeu_ps(lanes, low);
+	for (float lane : lanes)
+		min = lane < min ? lane : min;
+	_mm256_storeu_ps(lanes, high);
+	for (float lane : lanes)
+		max = lane > max ? lane : max;
+	BoundsScalar(values, i, end, min, max);
+}
+
+AVX2_TARGET static void TransformAvx2(float* x, float* y, float* z, size_t begin, size_t end, const float* rows)
+{
+	__m256 m[12];
+	for (int j = 0; j < 12; j++)
+		m[j] = _mm256_set1_ps(rows[j]);
+
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+		_mm256_storeu_ps(x + i, _mm256_fmadd_ps(m[0], px, _mm256_fmadd_ps(m[1], py, _mm256_fmadd_ps(m[2], pz, m[3]))));
+		_mm256_storeu_ps(y + i, _mm256_fmadd_ps(m[4], px, _mm256_fmadd_ps(m[5], py, _mm256_fmadd_ps(m[6], pz, m[7]))));
+		_mm256_storeu_ps(z + i, _mm256_fmadd_ps(m[8], px, _mm256_fmadd_ps(m[9], py, _mm256_fmadd_ps(m[10], pz, m[11]))));
+	}
+	TransformScalar(x, y, z, i, end, rows);
+}
+
+AVX2_TARGET static void NormalizeAvx2(float* x, float* y, float* z, size_t begin, size_t end)
+{
+	const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 nx = _mm256_loadu_ps(x + i), ny = _mm256_loadu_ps(y + i), nz = _mm256_loadu_ps(z + i);
+		__m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz));
+		__m256 nonZero = _mm256_cmp_ps(lengthSquared, zero, _CMP_GT_OQ);
+		__m256 scale = _mm256_blendv_ps(one, _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared)), nonZero);
+		_mm256_storeu_ps(x + i, _mm256_mul_ps(nx, scale));
+		_mm256_storeu_ps(y + i, _mm256_mul_ps(ny, scale));
+		_mm256_storeu_ps(z + i, _mm256_mul_ps(nz, scale));
+	}
+	NormalizeScalar(x, y, z, i, end);
+}
+
+#endif
+
+static double Sum(const float* values, size_t begin, size_t end)
+{
+#ifdef VERTEX_STREAMS_SIMD
+	return VertexStreams::HasAvx2() ? SumAvx2(values, begin, end) : SumSse(values, begin, end);
+#else
+	return SumScalar(values, begin, end);
+#endif
+}
+
+static void Bounds(const float* values, size_t begin, size_t end, float& min, float& max)
+{
+#ifdef VERTEX_STREAMS_SIMD
+	if (VertexStreams::HasAvx2())
+		BoundsAvx2(values, begin, end, min, max);
+	else
+		BoundsSse(values, begin, end, min, max);
+#else
+	BoundsScalar(values, begin, end, min, max);
+#endif
+}
+
+static void Transform(float* x, float* y, float* z, size_t begin, size_t end, const float* rows)
+{
+#ifdef VERTEX_STREAMS_SIMD
+	if (VertexStreams::HasAvx2())
+		TransformAvx2(x, y, z, begin, end, rows);
+	else
+		TransformSse(x, y, z, begin, end, rows);
+#else
+	TransformScalar(x, y, z, begin, end, rows);
+#endif
+}
+
+static void Normalize(float* x, float* y, float* z, size_t begin, size_t end)
+{
+#ifdef VERTEX_STREAMS_SIMD
+	if (VertexStreams::HasAvx2())
+		NormalizeAvx2(x, y, z, begin, end);
+	else
+		NormalizeSse(x, y, z, begin, end);
+#else
+	NormalizeScalar(x, y, z, begin, end);
+#endif
+}
+
+size_t VertexStreams::GetCount() const
+{
+	return positions[0].size();
+}
+
+void VertexStreams::Resize(size_t count)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		positions[axis].resize(count);
+		normals[axis].resize(count);
+		colors[axis].resize(count);
+	}
+}
+
+VertexStreams VertexStreams::FromVertices(const Vertex* vertices, size_t count)
+{
+	VertexStreams streams;
+	streams.Resize(count);
+
+	ParallelForRange(count, GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				streams.positions[axis][i] = vertices[i].position[axis];
+				streams.normals[axis][i] = vertices[i].normal[axis];
+				streams.colors[axis][i] = vertices[i].color[axis];
+			}
+		}
+	});
+
+	return streams;
+}
+
+void VertexStreams::Interleave(Vertex* destination, size_t first, size_t count) const
+{
+	ParallelForRange(count, GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			// written whole, mapped GPU memory is usually write-combined
+			destination[i] = Vertex(GetPosition(first + i), GetNormal(first + i),
+				glm::vec3(colors[0][first + i], colors[1][first + i], colors[2][first + i]));
+		}
+	});
+}
+
+glm::vec3 VertexStreams::GetPosition(size_t vertex) const
+{
+	return glm::vec3(positions[0][vertex], positions[1][vertex], positions[2][vertex]);
+}
+
+glm::vec3 VertexStreams::GetNormal(size_t vertex) const
+{
+	return glm::vec3(normals[0][vertex], normals[1][vertex], normals[2][vertex]);
+}
+
+void VertexStreams::SetNormal(size_t vertex, const glm::vec3& normal)
+{
+	normals[0][vertex] = normal.x;
+	normals[1][vertex] = normal.y;
+	normals[2][vertex] = normal.z;
+}
+
+glm::vec3 VertexStreams::ComputeCentroid() const
+{
+	const size_t count = GetCount();
+	if (count == 0)
+		return glm::vec3(0.0f);
+
+	const size_t blockCount = (count + GRAIN_SIZE - 1) / GRAIN_SIZE;
+	std::vector<glm::dvec3> blockSums(blockCount);
+
+	ParallelForRange(count, GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (int axis = 0; axis < 3; axis++)
+			blockSums[begin / GRAIN_SIZE][axis] = Sum(positions[axis].data(), begin, end);
+	});
+
+	glm::dvec3 sum(0.0);
+	for (const glm::dvec3& blockSum : blockSums)
+		sum += blockSum;
+	return glm::vec3(sum / static_cast<double>(count));
+}
+
+void VertexStreams::ComputeBounds(glm::vec3& min, glm::vec3& max) const
+{
+	const size_t count = GetCount();
+	const size_t blockCount = (count + GRAIN_SIZE - 1) / GRAIN_SIZE;
+	std::vector<glm::vec3> blockMin(blockCount, glm::vec3(std::numeric_limits<float>::max()));
+	std::vector<glm::vec3> blockMax(blockCount, glm::vec3(std::numeric_limits<float>::lowest()));
+
+	ParallelForRange(count, GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		for (int axis = 0; axis < 3; axis++)
+			Bounds(positions[axis].data(), begin, end, blockMin[begin / GRAIN_SIZE][axis], blockMax[begin / GRAIN_SIZE][axis]);
+	});
+
+	min = glm::vec3(std::numeric_limits<float>::max());
+	max = glm::vec3(std::numeric_limits<float>::lowest());
+	for (size_t block = 0; block < blockCount; block++)
+	{
+		min = glm::min(min, blockMin[block]);
+		max = glm::max(max, blockMax[block]);
+	}
+}
+
+void VertexStreams::Translate(const glm::vec3& offset)
+{
+	const float rows[12] = { 1.0f, 0.0f, 0.0f, offset.x, 0.0f, 1.0f, 0.0f, offset.y, 0.0f, 0.0f, 1.0f, offset.z };
+
+	ParallelForRange(GetCount(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		::Transform(positions[0].data(), positions[1].data(), positions[2].data(), begin, end, rows);
+	});
+}
+
+void VertexStreams::NormalizeNormals()
+{
+	ParallelForRange(GetCount(), GRAIN_SIZE, [&](size_t begin, size_t end)
+	{
+		Normalize(normals[0].data(), normals[1].data(), normals[2].data(), begin, end);
+	});
+}
+
+bool VertexStreams::HasAvx2()
+{
+#ifdef VERTEX_STREAMS_SIMD
+	static const bool supported = []()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		// the OS must also save the upper halves of the ymm registers
+		if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}();
+	return supported;
+#else
+	return false;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "utils.h"
+#include "Vertex.h"
+
+// Vertex attributes stored as one array per component (structure of arrays) instead of
+// interleaved Vertex records. Whole-mesh passes then read only the components they need,
+// with full SIMD lanes, and the interleaved layout is only produced when uploading.
+// The kernels use AVX2 when the CPU has it, SSE2 otherwise, and plain loops elsewhere.
+struct VertexStreams
+{
+	std::vector<float> positions[3];
+	std::vector<float> normals[3];
+	std::vector<float> colors[3];
+
+	size_t GetCount() const;
+	void Resize(size_t count);
+
+	static VertexStreams FromVertices(const Vertex* vertices, size_t count);
+	// writes count interleaved vertices, starting at vertex first, to destination
+	void Interleave(Vertex* destination, size_t first, size_t count) const;
+
+	glm::vec3 GetPosition(size_t vertex) const;
+	glm::vec3 GetNormal(size_t vertex) const;
+	void SetNormal(size_t vertex, const glm::vec3& normal);
+
+	// the centroid is summed in double precision per block, so large meshes don't drift
+	glm::vec3 ComputeCentroid() const;
+	void ComputeBounds(glm::vec3& min, glm::vec3& max) const;
+	void Translate(const glm::vec3& offset);
+	// zero length normals are left as they are
+	void NormalizeNormals();
+
+	static bool HasAvx2();
+
+	// elements per parallel block
+	static const size_t GRAIN_SIZE;
+};
\ No newline at end of file
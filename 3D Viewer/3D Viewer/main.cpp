@@ -8,19 +8,38 @@
 #include "ShaderProgram.h"
 #include "Model.h"
 #include "LightSource.h"
+#include "ModelLoader.h"
+#include "StreamedModel.h"
+#include "Scene.h"
+#include "SceneDescription.h"
+#include "UniformBuffers.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
 
 namespace fs = std::filesystem;
 
 constexpr unsigned int SCREEN_WIDTH = 800;
 constexpr unsigned int SCREEN_HEIGHT = 600;
+// the side of the square of pixels a right click selects, one ray per pixel
+constexpr int AREA_SELECTION_SIZE = 64;
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 ShaderProgram* modelShaders, * lightingShaders, * noTransformShaders;
 Camera* camera;
-Model* model;
-LightSource* lightSource;
+Model* model = nullptr;
+StreamedModel* streamedModel = nullptr;
+Scene* scene = nullptr;
+LightSource* lightSource = nullptr;
+UniformBuffers* uniformBuffers;
+ModelLoader* modelLoader;
+MeshCache* meshCache;
+// the last picked point, in model space
+std::optional<glm::vec3> measureStart;
 
 void DisplayFPS(double currentTime)
 {
@@ -31,7 +50,8 @@ void DisplayFPS(double currentTime)
 
 	if (currentTime - lastPrint >= 1)
 	{
-		std::cout << "FPS: " << frameCounter << std::endl;
+		const GLState::Counters counters = GLState::GetFrameCounters();
+		std::cout << "FPS: " << frameCounter << ", state changes last frame: " << counters.issued << " issued, " << counters.elided << " elided" << std::endl;
 		frameCounter = 0;
 		lastPrint = currentTime;
 	}
@@ -63,6 +83,15 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
+	// G cycles through the GL diagnostics modes
+	if (key == GLFW_KEY_G && action == GLFW_PRESS)
+	{
+		const int next = (static_cast<int>(GLDiagnostics::GetMode()) + 1) % (static_cast<int>(GLDiagnostics::Mode::PerCall) + 1);
+		GLDiagnostics::SetMode(static_cast<GLDiagnostics::Mode>(next));
+		std::cout << "GL diagnostics: " << GLDiagnostics::GetModeName(GLDiagnostics::GetMode()) << std::endl;
+		return;
+	}
+
 	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
 	{
 		int width, height;
@@ -70,6 +99,8 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 		camera->Set(width, height);
 	}
 
+	else if (lightSource == nullptr)
+		return;
 	else if (key == GLFW_KEY_Z && action == GLFW_PRESS)
 		lightSource->SetAmbientStrength(lightSource->GetAmbientStrength() + 0.1f);
 	else if (key == GLFW_KEY_X && action == GLFW_PRESS)
@@ -103,13 +134,72 @@ void ScrollCallback(GLFWwindow* window, double xoffset, double yOffset)
 	camera->HandleMouseScroll(static_cast<float>(yOffset));
 }
 
+// The camera captures the cursor, so rays go through the middle of the window.
+// A left click measures from the previous pick, a right click selects the triangles in a square around the middle.
+void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+	if (model == nullptr || action != GLFW_PRESS)
+		return;
+	if (model->GetMesh().bvh == nullptr)
+	{
+		std::cout << "Load the model with --picking to pick it" << std::endl;
+		return;
+	}
+
+	const glm::vec2 viewportSize(static_cast<float>(camera->GetWidth()), static_cast<float>(camera->GetHeight()));
+	const glm::mat4 viewMatrix = camera->GetViewMatrix();
+	const glm::mat4 projectionMatrix = camera->GetProjectionMatrix();
+
+	if (button == GLFW_MOUSE_BUTTON_LEFT)
+	{
+		const RayHit hit = model->Pick(RayCaster::FromCursor(viewportSize * 0.5f, viewportSize, viewMatrix, projectionMatrix));
+		if (!hit.IsHit())
+		{
+			std::cout << "Nothing picked" << std::endl;
+			return;
+		}
+
+		// the model keeps rotating, so points are measured in model space
+		const glm::vec3 point = glm::vec3(glm::inverse(model->GetModelMatrix()) * glm::vec4(hit.position, 1.0f));
+		std::cout << std::format("Picked triangle {} at ({:.4f}, {:.4f}, {:.4f}), {:.4f} away", hit.triangle, point.x, point.y, point.z, hit.distance) << std::endl;
+		if (measureStart.has_value())
+			std::cout << std::format("Distance from the previous pick: {:.4f}", glm::distance(*measureStart, point)) << std::endl;
+		measureStart = point;
+	}
+	else if (button == GLFW_MOUSE_BUTTON_RIGHT)
+	{
+		const glm::vec2 corner = viewportSize * 0.5f - glm::vec2(AREA_SELECTION_SIZE * 0.5f);
+		std::vector<Ray> rays;
+		rays.reserve(AREA_SELECTION_SIZE * AREA_SELECTION_SIZE);
+		for (int y = 0; y < AREA_SELECTION_SIZE; y++)
+		{
+			for (int x = 0; x < AREA_SELECTION_SIZE; x++)
+				rays.push_back(RayCaster::FromCursor(corner + glm::vec2(x + 0.5f, y + 0.5f), viewportSize, viewMatrix, projectionMatrix));
+		}
+
+		std::vector<RayHit> hits(rays.size());
+		const double start = glfwGetTime();
+		model->Pick(rays.data(), rays.size(), hits.data());
+		const double milliseconds = (glfwGetTime() - start) * 1000.0;
+
+		std::vector<uint32_t> triangles;
+		for (const RayHit& hit : hits)
+		{
+			if (hit.IsHit())
+				triangles.push_back(hit.triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+		std::cout << std::format("Selected {} triangles with {} rays in {:.3f} ms", triangles.size(), rays.size(), milliseconds) << std::endl;
+	}
+}
+
 void InitializeGraphics()
 {
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_COLOR_MATERIAL);
-	glDisable(GL_LIGHTING);
+	GLState::Enable(GL_CULL_FACE);
+	GLState::Enable(GL_DEPTH_TEST);
 
 	glFrontFace(GL_CCW);
 	glCullFace(GL_BACK);
@@ -121,6 +211,8 @@ GLFWwindow* InitializeWindow()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (GLDiagnostics::NeedsDebugContext())
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 
 	// glfw window creation
 	GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "3D Model Viewer", NULL, NULL);
@@ -136,6 +228,7 @@ GLFWwindow* InitializeWindow()
 	glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
 	glfwSetCursorPosCallback(window, MouseCallback);
 	glfwSetScrollCallback(window, ScrollCallback);
+	glfwSetMouseButtonCallback(window, MouseButtonCallback);
 
 	// tell GLFW to capture our mouse
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -143,6 +236,7 @@ GLFWwindow* InitializeWindow()
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GLFW_TRUE);
 
 	glewInit();
+	GLDiagnostics::Init();
 	return window;
 }
 
@@ -150,46 +244,134 @@ void Clean()
 {
 	delete modelShaders, lightingShaders, noTransformShaders;
 	delete camera;
+	delete modelLoader;
 	delete model;
+	delete streamedModel;
+	delete scene;
 	delete lightSource;
+	delete uniformBuffers;
+
+	meshCache->PrintStatistics();
+	delete meshCache;
 
 	glfwTerminate();
 }
 
-void RenderFrame()
+// every model draws the coarsest level of detail that stays within LodSelector::DEFAULT_PIXEL_ERROR of the full mesh,
+// and only the meshlets of it that can be seen
+void SelectLods(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	const float viewportHeight = static_cast<float>(camera->GetHeight());
 
+	if (model != nullptr)
+	{
+		model->SelectLod(viewMatrix, projectionMatrix, viewportHeight);
+		model->CullMeshlets(viewMatrix, projectionMatrix);
+	}
+	if (scene != nullptr)
+		scene->SelectLods(viewMatrix, projectionMatrix, viewportHeight);
+}
+
+// the camera matrices are computed once a frame and reach every program through the frame uniforms
+FrameUniforms GetFrameUniforms()
+{
+	FrameUniforms uniforms = {};
+	uniforms.viewMatrix = camera->GetViewMatrix();
+	uniforms.projectionMatrix = camera->GetProjectionMatrix();
+	uniforms.viewProjectionMatrix = uniforms.projectionMatrix * uniforms.viewMatrix;
+	uniforms.viewPosition = camera->GetPosition();
+
+	uniforms.lightPosition = lightSource->model.GetPosition();
+	uniforms.lightColor = lightSource->GetColor();
+	uniforms.ambientStrength = lightSource->GetAmbientStrength();
+	uniforms.diffuseStrength = lightSource->GetDiffuseStrength();
+	uniforms.specularStrength = lightSource->GetSpecularStrength();
+	uniforms.specularExponent = lightSource->GetSpecularExponent();
+	return uniforms;
+}
+
+void RenderModel()
+{
 	lightingShaders->Use();
 
-	lightingShaders->SetVec3("LightColor", lightSource->GetColor());
-	lightingShaders->SetVec3("LightPosition", lightSource->model.GetPosition());
-	lightingShaders->SetVec3("ViewPosition", camera->GetPosition());
+	if (model != nullptr)
+	{
+		uniformBuffers->SetObject(model->GetObjectUniforms());
+		model->Render();
+	}
+
+	// the streamed model and the scene always have full precision vertices
+	if (streamedModel != nullptr)
+	{
+		uniformBuffers->SetObject(ObjectUniforms(streamedModel->GetModelMatrix()));
+		streamedModel->Render();
+	}
 
-	lightingShaders->SetFloat("AmbientStrength", lightSource->GetAmbientStrength());
-	lightingShaders->SetFloat("DiffuseStrength", lightSource->GetDiffuseStrength());
-	lightingShaders->SetFloat("SpecularStrength", lightSource->GetSpecularStrength());
-	lightingShaders->SetInt("SpecularExponent", lightSource->GetSpecularExponent());
+	if (scene != nullptr)
+		scene->Render(*uniformBuffers);
+}
 
-	lightingShaders->SetMat4("ModelMatrix", model->GetModelMatrix());
-	lightingShaders->SetMat4("ViewMatrix", camera->GetViewMatrix());
-	lightingShaders->SetMat4("ProjectionMatrix", camera->GetProjectionMatrix());
+void RenderFrame()
+{
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	model->Render();
+	// models show up as soon as the loader hands them over
+	if (lightSource == nullptr)
+		return;
 
-	modelShaders->Use();
+	const FrameUniforms frameUniforms = GetFrameUniforms();
+	uniformBuffers->BeginFrame(frameUniforms);
 
-	modelShaders->SetMat4("ModelMatrix", lightSource->model.GetModelMatrix());
-	modelShaders->SetMat4("ViewMatrix", camera->GetViewMatrix());
-	modelShaders->SetMat4("ProjectionMatrix", camera->GetProjectionMatrix());
+	if (model != nullptr || streamedModel != nullptr || scene != nullptr)
+	{
+		SelectLods(frameUniforms.viewMatrix, frameUniforms.projectionMatrix);
+		RenderModel();
+	}
+
+	modelShaders->Use();
 
+	uniformBuffers->SetObject(lightSource->model.GetObjectUniforms());
 	lightSource->model.Render();
+
+	uniformBuffers->EndFrame();
 }
 
 int main(int argc, const char* argv[])
 {
 	const fs::path execDirPath = fs::canonical(argv[0]).remove_filename();
 
+	if (argc >= 4 && std::string(argv[1]) == "--convert")
+	{
+		try
+		{
+			std::cout << "Converting model \n\t" << argv[2] << "\nto binary mesh \n\t" << argv[3] << std::endl;
+			MeshData::ConvertToBinary(argv[2], argv[3]);
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << e.what() << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+
+	if (argc >= 4 && std::string(argv[1]) == "--chunk")
+	{
+		try
+		{
+			std::cout << "Splitting model \n\t" << argv[2] << "\ninto chunked mesh \n\t" << argv[3] << std::endl;
+			if (!BinaryMesh::HasBinaryExtension(argv[2]))
+				std::cout << "The model is read into memory whole; convert it with --convert first if it doesn't fit" << std::endl;
+			ChunkedMesh::Build(argv[2], argv[3]);
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << e.what() << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+
 	fs::path modelPath;
 	if (argc < 2)
 	{
@@ -209,6 +391,34 @@ int main(int argc, const char* argv[])
 		}
 	}
 
+	// --streams keeps the vertices as separate component arrays until they are uploaded,
+	// --quantize uploads them packed into 16 bytes each, --meshlets culls the model in clusters,
+	// --picking builds a BVH so the model can be picked and measured with the mouse,
+	// --lods <count> simplifies that many levels of detail, which are picked by screen size,
+	// --gl-diagnostics off|frame|debug-output|synchronous|per-call picks how GL errors are found
+	LoadOptions loadOptions;
+	for (int i = 2; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--streams")
+			loadOptions.vertexStreams = true;
+		else if (std::string(argv[i]) == "--quantize")
+			loadOptions.quantizeVertices = true;
+		else if (std::string(argv[i]) == "--meshlets")
+			loadOptions.buildMeshlets = true;
+		else if (std::string(argv[i]) == "--picking")
+			loadOptions.buildBvh = true;
+		else if (std::string(argv[i]) == "--lods" && i + 1 < argc)
+			loadOptions.lodCount = std::strtoul(argv[++i], nullptr, 10);
+		else if (std::string(argv[i]) == "--gl-diagnostics" && i + 1 < argc)
+		{
+			GLDiagnostics::Mode mode;
+			if (GLDiagnostics::ParseMode(argv[++i], mode))
+				GLDiagnostics::SetMode(mode);
+			else
+				std::cout << "Unknown GL diagnostics mode " << argv[i] << ", using " << GLDiagnostics::GetModeName(GLDiagnostics::GetMode()) << std::endl;
+		}
+	}
+
 	if (!fs::exists(modelPath))
 	{
 		std::cout << "There is no model file at \n\t" << modelPath << std::endl;
@@ -247,15 +457,60 @@ int main(int argc, const char* argv[])
 	noTransformShaders = new ShaderProgram(noTransformVSPath.string(), noTransformFSPath.string());
 
 	camera = new Camera(SCREEN_WIDTH, SCREEN_HEIGHT);
+	uniformBuffers = new UniformBuffers();
 
-	std::cout << "Loading model from \n\t" << modelPath << std::endl;
-	model = new Model(modelPath.string());
+	meshCache = new MeshCache((execDirPath / "MeshCache").string());
+	modelLoader = new ModelLoader(meshCache, loadOptions);
 
 	std::cout << "Loading light source model from \n\t" << lightModelPath << std::endl;
-	lightSource = new LightSource(std::move(Model(lightModelPath.string())));
+	modelLoader->Load(lightModelPath.string(), [](Model&& loaded)
+	{
+		lightSource = new LightSource(std::move(loaded));
 
-	lightSource->model.SetPosition(camera->GetPosition() + glm::vec3(0.0f, 1.0f, 0.0f));
-	lightSource->model.Scale(glm::vec3(0.2f));
+		lightSource->model.SetPosition(camera->GetPosition() + glm::vec3(0.0f, 1.0f, 0.0f));
+		lightSource->model.Scale(glm::vec3(0.2f));
+	});
+
+	std::cout << "Loading model from \n\t" << modelPath << std::endl;
+	if (ChunkedMesh::HasChunkedExtension(modelPath.string()))
+	{
+		// chunked meshes stream in by themselves around the camera
+		try
+		{
+			streamedModel = new StreamedModel(modelPath.string());
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << e.what() << std::endl;
+		}
+	}
+	else if (SceneDescription::HasSceneExtension(modelPath.string()))
+	{
+		// every part is added to the shared buffers once it is uploaded, in the same per-frame slices as models
+		try
+		{
+			scene = new Scene();
+			for (const SceneEntry& entry : SceneDescription::Read(modelPath.string()))
+			{
+				modelLoader->LoadMesh(entry.filePath, scene->GetArena(), [modelMatrix = entry.modelMatrix](MeshData&& loaded, const BufferArena::Allocation& allocation)
+				{
+					scene->Add(loaded, allocation, modelMatrix);
+				});
+			}
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << e.what() << std::endl;
+		}
+	}
+	else
+	{
+		modelLoader->Load(modelPath.string(), [](Model&& loaded)
+		{
+			model = new Model(std::move(loaded));
+			std::cout << "Model loaded" << std::endl;
+		});
+	}
 
 	std::cout << std::endl;
 
@@ -265,14 +520,22 @@ int main(int argc, const char* argv[])
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
-		model->Rotate(glm::vec3(0.0f, deltaTime, 0.0f));
-		lightSource->model.Rotate(glm::vec3(0.0f, deltaTime, 0.0f));
+		modelLoader->Update();
+		if (streamedModel != nullptr)
+			streamedModel->Update(*camera, deltaTime);
+
+		if (model != nullptr)
+			model->Rotate(glm::vec3(0.0f, deltaTime, 0.0f));
+		if (lightSource != nullptr)
+			lightSource->model.Rotate(glm::vec3(0.0f, deltaTime, 0.0f));
 
 		DisplayFPS(currentFrame);
 		PerformKeysActions(window);
 		RenderFrame();
+		GLState::EndFrame();
 
 		glfwSwapBuffers(window);
+		GLDiagnostics::EndFrame();
 		glfwPollEvents();
 	}
 
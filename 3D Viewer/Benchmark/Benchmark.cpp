@@ -0,0 +1,356 @@
+// Headless loader and preprocessing benchmark.
+// For every size and format a synthetic mesh is written to disk, then these stages are timed one by one:
+//	- parsing,
+//	- WeldVertices, OptimizeOrder, ToStreams (with --streams), bounds, CenterModel and CalculateNormals,
+//	  all skipped for .bmesh files, which are written already processed,
+//	- the Mesh connectivity, capped by --connectivity-budget megabytes of sort buffers,
+//	- building, widening and refitting a BVH, and casting rays through it,
+//	- simplifying a chain of LODs at --lod-ratios of the triangle count,
+//	- packing the upload buffer, building meshlets and quantizing the vertices.
+// Metrics are recorded along the way: vertex cache ACMR / ATVR and headless overdraw around OptimizeOrder,
+// the triangles of every LOD and the quantization error. The results are printed (or written with
+// --output) as JSON:
+//
+//	MeshBenchmark [--sizes 10000,100000,...] [--formats txt,obj,ply,bmesh] [--streams] [--connectivity-budget 1024]
+//		[--lod-ratios 0.5,0.25,0.125] [--dir path] [--output file.json] [--keep]
+
+#include "utils.h"
+#include "Bvh.h"
+#include "MeshData.h"
+#include "Mesh.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "RayCaster.h"
+#include "SyntheticMesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <windows.h>
+	#include <psapi.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// rays cast through the BVH of every mesh
+static const size_t RAY_COUNT = 1 << 16;
+
+struct StageResult
+{
+	std::string name;
+	double seconds;
+	uint64_t bytes;
+	uint64_t peakRss;
+};
+
+struct RunResult
+{
+	size_t triangles;
+	std::string format;
+	std::string layout;
+	uint64_t fileBytes;
+	std::vector<StageResult> stages;
+	std::vector<std::pair<std::string, double>> metrics;
+};
+
+// on Linux the high-water mark can be reset, so every stage reports its own peak;
+// elsewhere the value is the peak of the whole process so far
+static void ResetPeakRss()
+{
+#ifdef __linux__
+	std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+static uint64_t GetPeakRss()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+#elif defined(__linux__)
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.rfind("VmHWM:", 0) == 0)
+			return std::stoull(line.substr(6)) * 1024;
+	}
+#endif
+	return 0;
+}
+
+template<typename Function>
+static StageResult TimeStage(const std::string& name, uint64_t bytes, Function&& stage)
+{
+	ResetPeakRss();
+	auto start = std::chrono::steady_clock::now();
+	stage();
+	auto end = std::chrono::steady_clock::now();
+
+	return { name, std::chrono::duration<double>(end - start).count(), bytes, GetPeakRss() };
+}
+
+static std::vector<std::string> Split(const std::string& text)
+{
+	std::vector<std::string> parts;
+	std::stringstream stream(text);
+	std::string part;
+	while (std::getline(stream, part, ','))
+	{
+		if (!part.empty())
+			parts.push_back(part);
+	}
+	return parts;
+}
+
+static void WriteSource(const MeshData& mesh, const std::string& format, const std::string& filePath)
+{
+	if (format == "txt")
+		SyntheticMesh::WriteText(mesh, filePath);
+	else if (format == "obj")
+		SyntheticMesh::WriteObj(mesh, filePath);
+	else if (format == "ply")
+		SyntheticMesh::WritePly(mesh, filePath);
+	else if (format == "bmesh")
+	{
+		// preprocessed with the default options, like --convert does
+		MeshData processed = mesh;
+		processed.Preprocess(LoadOptions(), false);
+		processed.WriteBinary(filePath);
+	}
+	else
+		throw std::runtime_error(std::format("Unknown benchmark format {}", format).data());
+}
+
+static RunResult Run(const MeshData& source, const std::string& format, bool streams, size_t connectivityBudget, const std::vector<float>& lodRatios,
+	const fs::path& directory, bool keepFiles)
+{
+	const std::string filePath = (directory / std::format("synthetic_{}.{}", source.GetIndexCount() / 3, format)).string();
+	WriteSource(source, format, filePath);
+
+	RunResult result;
+	result.triangles = source.GetIndexCount() / 3;
+	result.format = format;
+	result.layout = streams ? "streams" : "interleaved";
+	result.fileBytes = fs::file_size(filePath);
+
+	MeshData mesh;
+	result.stages.push_back(TimeStage("parse", result.fileBytes, [&]()
+	{
+		if (format == "bmesh")
+			mesh = MeshData::LoadBinary(filePath);
+		else
+			MeshData::ReadSource(filePath, mesh);
+	}));
+
+	const uint64_t vertexBytes = mesh.GetVertexCount() * sizeof(Vertex);
+	const uint64_t indexBytes = mesh.GetIndexCount() * sizeof(unsigned int);
+
+	// binary meshes are mapped read-only and stored already processed
+	if (format != "bmesh")
+	{
+		result.stages.push_back(TimeStage("weldVertices", vertexBytes + indexBytes, [&]() { mesh.WeldVertices(LoadOptions().weldEpsilon); }));
+
+		auto addOrderMetrics = [&](const std::string& suffix)
+		{
+			MeshOptimizer::CacheStatistics cache = MeshOptimizer::AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+			result.metrics.push_back({ "acmr" + suffix, cache.acmr });
+			result.metrics.push_back({ "atvr" + suffix, cache.atvr });
+			result.metrics.push_back({ "overdraw" + suffix, MeshOptimizer::AnalyzeOverdraw(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size()) });
+		};
+		addOrderMetrics("Before");
+		result.stages.push_back(TimeStage("optimizeOrder", vertexBytes + indexBytes, [&]() { mesh.OptimizeOrder(); }));
+		addOrderMetrics("After");
+		if (streams)
+			result.stages.push_back(TimeStage("toStreams", vertexBytes, [&]() { mesh.ToStreams(); }));
+		result.stages.push_back(TimeStage("bounds", vertexBytes, [&]()
+		{
+			glm::vec3 min, max;
+			mesh.GetBounds(min, max);
+		}));
+		result.stages.push_back(TimeStage("centerModel", vertexBytes, [&]() { mesh.CenterModel(); }));
+		result.stages.push_back(TimeStage("calculateNormals", vertexBytes + indexBytes, [&]() { mesh.CalculateNormals(); }));
+	}
+
+	result.stages.push_back(TimeStage("buildConnectivity", indexBytes, [&]() { Mesh connectivity(mesh, connectivityBudget); }));
+
+	// the BVH over the full level, then its 4-wide form and a refit of the same tree
+	Bvh bvh;
+	result.stages.push_back(TimeStage("buildBvh", vertexBytes + indexBytes, [&]() { bvh = Bvh(mesh); }));
+	result.metrics.push_back({ "bvhBuildMtrisPerSecond", mesh.GetLod(0).indexCount / 3 / result.stages.back().seconds / 1e6 });
+	result.metrics.push_back({ "bvhSahCost", bvh.GetSahCost() });
+	result.stages.push_back(TimeStage("buildWideBvh", bvh.GetNodes().size() * sizeof(Bvh::Node), [&]() { bvh.BuildWideNodes(); }));
+	result.stages.push_back(TimeStage("refitBvh", vertexBytes + indexBytes, [&]() { bvh.Refit(mesh); }));
+
+	// a batch of rays from around the mesh at random points inside its bounds
+	{
+		glm::vec3 min, max;
+		mesh.GetBounds(min, max);
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = max - min;
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+		std::vector<Ray> rays(RAY_COUNT);
+		for (Ray& ray : rays)
+		{
+			const glm::vec3 direction = glm::vec3(distribution(random), distribution(random), distribution(random)) + glm::vec3(1e-3f);
+			ray.origin = center + glm::normalize(direction) * glm::length(extent);
+			ray.direction = center + glm::vec3(distribution(random), distribution(random), distribution(random)) * extent - ray.origin;
+		}
+
+		std::vector<RayHit> hits(RAY_COUNT);
+		const RayCaster caster(mesh, bvh);
+		result.stages.push_back(TimeStage("castRays", RAY_COUNT * sizeof(Ray), [&]() { caster.Intersect(rays.data(), rays.size(), hits.data()); }));
+		result.metrics.push_back({ "rayMraysPerSecond", RAY_COUNT / result.stages.back().seconds / 1e6 });
+		result.metrics.push_back({ "rayHitRatio", std::count_if(hits.begin(), hits.end(), [](const RayHit& hit) { return hit.IsHit(); }) / static_cast<double>(RAY_COUNT) });
+	}
+	bvh = Bvh();
+
+	if (!lodRatios.empty())
+	{
+		std::vector<MeshData> lods;
+		result.stages.push_back(TimeStage("buildLodChain", vertexBytes + indexBytes, [&]() { lods = MeshSimplifier::BuildLodChain(mesh, lodRatios); }));
+		for (size_t level = 0; level < lods.size(); level++)
+			result.metrics.push_back({ std::format("lod{}Triangles", level + 1), static_cast<double>(lods[level].GetIndexCount() / 3) });
+	}
+
+	// the copy into one contiguous upload buffer, as the GPU upload does it; vertex streams are interleaved here
+	std::vector<uint8_t> packed;
+	result.stages.push_back(TimeStage("pack", vertexBytes + indexBytes, [&]()
+	{
+		packed.resize(vertexBytes + indexBytes);
+		mesh.CopyVertices(reinterpret_cast<Vertex*>(packed.data()), 0, mesh.GetVertexCount());
+		std::memcpy(packed.data() + vertexBytes, mesh.GetIndexData(), indexBytes);
+	}));
+
+	// meshlets follow the packed index runs
+	std::vector<Meshlet> meshlets;
+	result.stages.push_back(TimeStage("buildMeshlets", vertexBytes + indexBytes, [&]()
+	{
+		mesh.PackIndices();
+		meshlets = MeshletBuilder::Build(mesh);
+	}));
+	result.metrics.push_back({ "meshlets", static_cast<double>(meshlets.size()) });
+
+	// the same copy with the vertices quantized, and the error that costs
+	QuantizationError quantizationError;
+	const uint64_t quantizedBytes = mesh.GetVertexCount() * sizeof(QuantizedVertex);
+	result.stages.push_back(TimeStage("quantize", vertexBytes, [&]()
+	{
+		quantizationError = mesh.Quantize();
+		mesh.CopyUploadVertices(packed.data(), 0, mesh.GetVertexCount());
+	}));
+	result.metrics.push_back({ "quantizedVertexBytes", static_cast<double>(quantizedBytes) });
+	result.metrics.push_back({ "quantizedPositionError", quantizationError.position });
+	result.metrics.push_back({ "quantizedNormalDegrees", quantizationError.normalDegrees });
+	result.metrics.push_back({ "quantizedColorError", quantizationError.color });
+
+	mesh = MeshData();
+	if (!keepFiles)
+		fs::remove(filePath);
+
+	return result;
+}
+
+static std::string ToJson(const std::vector<RunResult>& results)
+{
+	std::string json = "{\n\t\"runs\": [";
+	for (size_t run = 0; run < results.size(); run++)
+	{
+		const RunResult& result = results[run];
+		json += std::format("{}\n\t\t{{\n\t\t\t\"format\": \"{}\",\n\t\t\t\"layout\": \"{}\",\n\t\t\t\"triangles\": {},\n\t\t\t\"fileBytes\": {},\n\t\t\t\"stages\": [",
+			run == 0 ? "" : ",", result.format, result.layout, result.triangles, result.fileBytes);
+
+		for (size_t stage = 0; stage < result.stages.size(); stage++)
+		{
+			const StageResult& timing = result.stages[stage];
+			double seconds = std::max(timing.seconds, 1e-9);
+			json += std::format("{}\n\t\t\t\t{{ \"name\": \"{}\", \"seconds\": {:.6f}, \"megabytesPerSecond\": {:.2f}, \"trianglesPerSecond\": {:.0f}, \"peakRssBytes\": {} }}",
+				stage == 0 ? "" : ",", timing.name, timing.seconds, timing.bytes / seconds / (1024.0 * 1024.0), result.triangles / seconds, timing.peakRss);
+		}
+		json += "\n\t\t\t],\n\t\t\t\"metrics\": {";
+		for (size_t metric = 0; metric < result.metrics.size(); metric++)
+			json += std::format("{} \"{}\": {:.4f}", metric == 0 ? "" : ",", result.metrics[metric].first, result.metrics[metric].second);
+		json += " }\n\t\t}";
+	}
+	json += "\n\t]\n}\n";
+	return json;
+}
+
+int main(int argc, const char* argv[])
+{
+	std::vector<size_t> sizes = { 10'000, 100'000, 1'000'000, 10'000'000 };
+	std::vector<std::string> formats = { "txt", "obj", "ply", "bmesh" };
+	fs::path directory = fs::temp_directory_path();
+	std::string outputPath;
+	bool keepFiles = false;
+	bool streams = false;
+	size_t connectivityBudget = Mesh::DEFAULT_BUILD_BUDGET;
+	std::vector<float> lodRatios = { 0.5f, 0.25f, 0.125f };
+
+	try
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string argument = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (argument == "--sizes" && hasValue)
+			{
+				sizes.clear();
+				for (const std::string& size : Split(argv[++i]))
+					sizes.push_back(std::stoull(size));
+			}
+			else if (argument == "--formats" && hasValue)
+				formats = Split(argv[++i]);
+			else if (argument == "--dir" && hasValue)
+				directory = argv[++i];
+			else if (argument == "--output" && hasValue)
+				outputPath = argv[++i];
+			else if (argument == "--connectivity-budget" && hasValue)
+				connectivityBudget = std::stoull(argv[++i]) * 1024 * 1024;
+			else if (argument == "--lod-ratios" && hasValue)
+			{
+				lodRatios.clear();
+				for (const std::string& ratio : Split(argv[++i]))
+					lodRatios.push_back(std::stof(ratio));
+			}
+			else if (argument == "--streams")
+				streams = true;
+			else if (argument == "--keep")
+				keepFiles = true;
+			else
+				throw std::runtime_error(std::format("Unknown argument {}", argument).data());
+		}
+
+		std::vector<RunResult> results;
+		for (size_t size : sizes)
+		{
+			MeshData source = SyntheticMesh::Generate(size);
+			for (const std::string& format : formats)
+			{
+				std::cerr << "Benchmarking " << format << " with " << source.GetIndexCount() / 3 << " triangles" << std::endl;
+				results.push_back(Run(source, format, streams, connectivityBudget, lodRatios, directory, keepFiles));
+			}
+		}
+
+		std::string json = ToJson(results);
+		if (outputPath.empty())
+			std::cout << json;
+		else
+			std::ofstream(outputPath) << json;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
\ No newline at end of file
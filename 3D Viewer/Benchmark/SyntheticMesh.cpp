@@ -0,0 +1,212 @@
+#include "SyntheticMesh.h"
+#include "Parallel.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+const size_t SyntheticMesh::RECORDS_PER_BLOCK = 64 * 1024;
+
+static void AppendValue(std::string& text, float value)
+{
+	char buffer[32];
+	auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	text.append(buffer, result.ptr);
+}
+
+static void AppendValue(std::string& text, size_t value)
+{
+	char buffer[32];
+	auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	text.append(buffer, result.ptr);
+}
+
+template<typename T>
+static void AppendBytes(std::string& data, const T& value)
+{
+	data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// formats record(i, block) for i in [0, count) in parallel blocks and writes the blocks in order
+template<typename Function>
+static void WriteRecords(std::ofstream& file, size_t count, Function&& record)
+{
+	const size_t blocksPerBatch = GetWorkerCount() * 4;
+	std::vector<std::string> blocks(blocksPerBatch);
+
+	for (size_t batchBegin = 0; batchBegin < count; batchBegin += blocksPerBatch * SyntheticMesh::RECORDS_PER_BLOCK)
+	{
+		size_t batchEnd = std::min(count, batchBegin + blocksPerBatch * SyntheticMesh::RECORDS_PER_BLOCK);
+
+		ParallelForRange(batchEnd - batchBegin, SyntheticMesh::RECORDS_PER_BLOCK, [&](size_t begin, size_t end)
+		{
+			std::string& block = blocks[begin / SyntheticMesh::RECORDS_PER_BLOCK];
+			block.clear();
+			for (size_t i = batchBegin + begin; i < batchBegin + end; i++)
+				record(i, block);
+		});
+
+		for (size_t block = 0; block * SyntheticMesh::RECORDS_PER_BLOCK < batchEnd - batchBegin; block++)
+			file.write(blocks[block].data(), blocks[block].size());
+	}
+}
+
+static std::ofstream OpenOutput(const std::string& filePath)
+{
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error(std::format("Could not create benchmark file {}", filePath).data());
+	return file;
+}
+
+MeshData SyntheticMesh::Generate(size_t triangleCount)
+{
+	// a grid of columns x rows quads, two triangles each
+	const size_t quadCount = std::max<size_t>((triangleCount + 1) / 2, 1);
+	const size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(quadCount))));
+	const size_t rows = (quadCount + columns - 1) / columns;
+
+	MeshData mesh;
+	mesh.vertices.resize((columns + 1) * (rows + 1));
+	mesh.indices.resize(columns * rows * 6);
+
+	ParallelForRange(rows + 1, 256, [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; row++)
+		{
+			for (size_t column = 0; column <= columns; column++)
+			{
+				float x = static_cast<float>(column) / columns * 100.0f;
+				float z = static_cast<float>(row) / rows * 100.0f;
+				float height = std::sin(x * 0.3f) * std::cos(z * 0.2f) * 5.0f;
+
+				Vertex& vertex = mesh.vertices[row * (columns + 1) + column];
+				vertex.position = glm::vec3(x, height, z);
+				vertex.normal = glm::vec3(0.0f);
+				vertex.color = glm::vec3(0.5f + height / 10.0f, x / 100.0f, z / 100.0f);
+			}
+		}
+	});
+
+	ParallelForRange(rows, 256, [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; row++)
+		{
+			for (size_t column = 0; column < columns; column++)
+			{
+				unsigned int corner = static_cast<unsigned int>(row * (columns + 1) + column);
+				unsigned int below = corner + static_cast<unsigned int>(columns + 1);
+				unsigned int* quad = &mesh.indices[(row * columns + column) * 6];
+
+				quad[0] = corner;
+				quad[1] = below;
+				quad[2] = corner + 1;
+				quad[3] = corner + 1;
+				quad[4] = below;
+				quad[5] = below + 1;
+			}
+		}
+	});
+
+	return mesh;
+}
+
+void SyntheticMesh::WriteText(const MeshData& mesh, const std::string& filePath)
+{
+	std::ofstream file = OpenOutput(filePath);
+	const size_t vertexCount = mesh.GetVertexCount();
+	const size_t triangleCount = mesh.GetIndexCount() / 3;
+
+	auto writeVectors = [&](auto member)
+	{
+		file << vertexCount << "\n";
+		WriteRecords(file, vertexCount, [&](size_t i, std::string& block)
+		{
+			const glm::vec3& value = mesh.vertices[i].*member;
+			AppendValue(block, value.x);
+			block += ' ';
+			AppendValue(block, value.y);
+			block += ' ';
+			AppendValue(block, value.z);
+			block += '\n';
+		});
+		file << "\n";
+	};
+
+	writeVectors(&Vertex::position);
+	writeVectors(&Vertex::color);
+
+	file << triangleCount << "\n";
+	WriteRecords(file, triangleCount, [&](size_t i, std::string& block)
+	{
+		AppendValue(block, static_cast<size_t>(mesh.indices[i * 3]));
+		block += ' ';
+		AppendValue(block, static_cast<size_t>(mesh.indices[i * 3 + 1]));
+		block += ' ';
+		AppendValue(block, static_cast<size_t>(mesh.indices[i * 3 + 2]));
+		block += '\n';
+	});
+}
+
+void SyntheticMesh::WriteObj(const MeshData& mesh, const std::string& filePath)
+{
+	std::ofstream file = OpenOutput(filePath);
+
+	WriteRecords(file, mesh.GetVertexCount(), [&](size_t i, std::string& block)
+	{
+		const Vertex& vertex = mesh.vertices[i];
+		block += "v";
+		for (int axis = 0; axis < 3; axis++)
+		{
+			block += ' ';
+			AppendValue(block, vertex.position[axis]);
+		}
+		for (int channel = 0; channel < 3; channel++)
+		{
+			block += ' ';
+			AppendValue(block, vertex.color[channel]);
+		}
+		block += '\n';
+	});
+
+	WriteRecords(file, mesh.GetIndexCount() / 3, [&](size_t i, std::string& block)
+	{
+		block += "f";
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			block += ' ';
+			AppendValue(block, static_cast<size_t>(mesh.indices[i * 3 + corner]) + 1);
+		}
+		block += '\n';
+	});
+}
+
+void SyntheticMesh::WritePly(const MeshData& mesh, const std::string& filePath)
+{
+	std::ofstream file = OpenOutput(filePath);
+
+	file << "ply\n"
+		<< "format binary_little_endian 1.0\n"
+		<< "element vertex " << mesh.GetVertexCount() << "\n"
+		<< "property float x\nproperty float y\nproperty float z\n"
+		<< "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+		<< "element face " << mesh.GetIndexCount() / 3 << "\n"
+		<< "property list uchar int vertex_indices\n"
+		<< "end_header\n";
+
+	WriteRecords(file, mesh.GetVertexCount(), [&](size_t i, std::string& block)
+	{
+		const Vertex& vertex = mesh.vertices[i];
+		for (int axis = 0; axis < 3; axis++)
+			AppendBytes(block, vertex.position[axis]);
+		for (int channel = 0; channel < 3; channel++)
+			AppendBytes(block, static_cast<uint8_t>(glm::clamp(vertex.color[channel], 0.0f, 1.0f) * 255.0f + 0.5f));
+	});
+
+	WriteRecords(file, mesh.GetIndexCount() / 3, [&](size_t i, std::string& block)
+	{
+		AppendBytes(block, static_cast<uint8_t>(3));
+		for (size_t corner = 0; corner < 3; corner++)
+			AppendBytes(block, static_cast<int32_t>(mesh.indices[i * 3 + corner]));
+	});
+}
\ No newline at end of file
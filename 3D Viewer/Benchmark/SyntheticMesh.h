@@ -0,0 +1,20 @@
+#pragma once
+
+#include "utils.h"
+#include "MeshData.h"
+
+// Procedural meshes for the benchmark: a wavy, colored height field with roughly the
+// requested number of triangles, plus writers for every source format the viewer reads.
+// The writers format blocks of records in parallel, so generating 100M triangle files stays cheap.
+class SyntheticMesh
+{
+public:
+	static MeshData Generate(size_t triangleCount);
+
+	static void WriteText(const MeshData& mesh, const std::string& filePath);
+	static void WriteObj(const MeshData& mesh, const std::string& filePath);
+	static void WritePly(const MeshData& mesh, const std::string& filePath);
+
+public:
+	static const size_t RECORDS_PER_BLOCK;
+};
\ No newline at end of file